@@ -1,8 +1,12 @@
 #pragma once
 
 #include <cstdint>
-#include <set>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 
@@ -28,11 +32,14 @@ namespace sung {
 
         auto begin() const { return nodes_.begin(); }
         auto end() const { return nodes_.end(); }
+        size_t size() const { return nodes_.size(); }
 
+        // First node pushed with `node_id`
         const WorkflowNodes::Node* find_node_by_id(int node_id) const;
 
     private:
         std::vector<const Node*> nodes_;
+        std::unordered_map<int, const Node*> by_id_;
     };
 
 
@@ -47,13 +54,20 @@ namespace sung {
             int to_field_;
         };
 
-        void push_back(const Link* link) { links_.push_back(link); }
+        void push_back(const Link* link);
 
         auto begin() const { return links_.begin(); }
         auto end() const { return links_.end(); }
+        size_t size() const { return links_.size(); }
+
+        // Links into `node_id`, in the order they were pushed
+        std::span<const Link* const> links_to(int node_id) const;
+        size_t count_from(int node_id) const;
 
     private:
         std::vector<const Link*> links_;
+        std::unordered_map<int, std::vector<const Link*>> incoming_;
+        std::unordered_map<int, size_t> from_counts_;
     };
 
 
@@ -63,12 +77,28 @@ namespace sung {
         WorkflowNodes::Node& new_node();
         WorkflowLinks::Link& new_link();
 
+        const std::vector<WorkflowNodes::Node>& nodes() const { return nodes_; }
+        const std::vector<WorkflowLinks::Link>& links() const { return links_; }
+
         WorkflowNodes get_nodes() const;
         WorkflowLinks get_links() const;
 
-    public:
+        // Result of `find_active_nodes`, computed on first use and kept
+        // until `new_node` or `new_link` changes the graph. Safe to call
+        // from several threads at once.
+        WorkflowNodes get_active_nodes() const;
+
+    private:
+        // Indices into `nodes_`. Copies share it, since they hold the same
+        // graph until one of them changes and gets a fresh cache.
+        struct ActiveCache {
+            std::once_flag once_;
+            std::vector<size_t> indices_;
+        };
+
         std::vector<WorkflowNodes::Node> nodes_;
         std::vector<WorkflowLinks::Link> links_;
+        std::shared_ptr<ActiveCache> active_ = std::make_shared<ActiveCache>();
     };
 
 
@@ -84,6 +114,12 @@ namespace sung {
         const WorkflowLinks& links
     );
 
+    // Active nodes of every terminal node, one terminal after another. A
+    // node shared by two terminals is listed for each of them.
+    WorkflowNodes find_active_nodes(
+        const WorkflowNodes& nodes, const WorkflowLinks& links
+    );
+
 
     std::vector<std::string> find_prompt(
         const WorkflowNodes& nodes, const WorkflowLinks& links
@@ -93,4 +129,23 @@ namespace sung {
         const WorkflowNodes& nodes, const WorkflowLinks& links
     );
 
+    // Same, reusing the active nodes cached in `workflow`
+    std::vector<std::string> find_prompt(const WorkflowData& workflow);
+    std::string find_model(const WorkflowData& workflow);
+
+
+    struct WorkflowSummary {
+        std::string model_;
+        std::vector<std::string> prompts_;
+    };
+
+    // Same model and prompts as `find_model` and `find_prompt` give for
+    // `parse_comfyui_workflow`, without building the JSON DOM or the node
+    // list. The JSON is streamed, keeping only id and mode of each node plus
+    // the first widget of Text and Checkpoint nodes, and the active nodes
+    // are walked once for both.
+    std::expected<WorkflowSummary, std::string> summarize_comfyui_workflow(
+        const uint8_t* data, size_t size
+    );
+
 }  // namespace sung
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <expected>
 #include <system_error>
 #include <vector>
 
@@ -20,6 +21,14 @@ namespace sung {
         const Path& path, const void* data, size_t size, std::error_code& error
     );
 
+    // Replaces `destination` with a copy of `source` the same way
+    // `write_file_atomically` does. The copy is a reflink (shared extents)
+    // on filesystems that support it, such as Btrfs, XFS and APFS, and a
+    // plain byte copy elsewhere.
+    bool copy_file_atomically(
+        const Path& source, const Path& destination, std::error_code& error
+    );
+
     // Captured by `read_file_timestamps`, applied by `set_file_timestamps`.
     // Treat the contents as opaque; the fields differ per platform.
     struct FileTimestamps {
@@ -41,6 +50,42 @@ namespace sung {
         const Path& source, const Path& destination
     );
 
+    // Read-only file for positioned reads, so parsers can fetch just the
+    // byte ranges they need instead of streaming through the whole file.
+    // Reads do not move a shared cursor and are safe from several threads.
+    class RandomAccessFile {
+
+    public:
+        RandomAccessFile() = default;
+        ~RandomAccessFile();
+
+        RandomAccessFile(RandomAccessFile&& other) noexcept;
+        RandomAccessFile& operator=(RandomAccessFile&& other) noexcept;
+        RandomAccessFile(const RandomAccessFile&) = delete;
+        RandomAccessFile& operator=(const RandomAccessFile&) = delete;
+
+        std::error_code open(const Path& path);
+        void close();
+
+        bool is_open() const;
+        // Size at the time of `open`
+        uint64_t size() const { return size_; }
+
+        // Reads up to `size` bytes at `offset`. Returns fewer only when the
+        // end of the file is reached.
+        std::expected<size_t, std::error_code> read_at(
+            uint64_t offset, void* dst, size_t size
+        ) const;
+
+    private:
+#ifdef _WIN32
+        void* handle_ = nullptr;
+#else
+        int fd_ = -1;
+#endif
+        uint64_t size_ = 0;
+    };
+
     template <typename TContainer>
     bool write_file(const Path& path, const TContainer& data) {
         return write_file(
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <expected>
 #include <map>
 #include <mutex>
@@ -32,6 +33,8 @@ namespace sung {
         struct AvifOptions {
             AvifPixelFormat pix_format_;
             double quality_;
+            // Perceptual target in (0, 1); 0 uses `quality_` directly
+            double target_ssim_;
             int speed_;
             bool gen_;
             bool gen_remove_src_;
@@ -40,6 +43,7 @@ namespace sung {
         struct AvifOverrides {
             std::optional<AvifPixelFormat> pix_format_;
             std::optional<double> quality_;
+            std::optional<double> target_ssim_;
             std::optional<int> speed_;
             std::optional<bool> gen_;
             std::optional<bool> gen_remove_src_;
@@ -80,6 +84,7 @@ namespace sung {
         // AVIF encoding settings
         AvifPixelFormat avif_pix_format_;
         double avif_quality_;
+        double avif_target_ssim_;
         int avif_speed_;
         bool avif_gen_;
         bool avif_gen_remove_src_;
@@ -89,7 +94,14 @@ namespace sung {
         std::string tagger_host_;
         int tagger_port_;
         int tagger_batch_size_;
+        int tagger_max_in_flight_;
         double tagger_poll_interval_seconds_;
+
+        // SQLite settings of the image index cache, read when it opens
+        int64_t index_mmap_size_mb_;
+        int64_t index_cache_size_mb_;
+        bool index_temp_store_memory_;
+        int index_page_size_;
     };
 
 
@@ -1,37 +1,390 @@
 #include "sung/auxiliary/comfyui_workflow.hpp"
 
+#include <algorithm>
+#include <optional>
 #include <print>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <nlohmann/json.hpp>
 
 
 namespace {
 
+    // Pre-order walk up the incoming links, skipping muted and bypassed
+    // nodes. An explicit stack keeps deep graphs off the call stack, and
+    // the visited set stops cycles.
     void visit_active_nodes_from_terminal(
         const int node_id,
-        std::set<int>& visited,
         sung::WorkflowNodes& active_nodes,
         const sung::WorkflowNodes& nodes,
         const sung::WorkflowLinks& links
     ) {
-        const auto node = nodes.find_node_by_id(node_id);
-        if (!node)
-            return;
-        if (node->mode_ != 0)
-            return;
-
-        if (!visited.contains(node->id_)) {
-            visited.insert(node->id_);
+        std::unordered_set<int> visited;
+        std::vector<int> stack{ node_id };
+        while (!stack.empty()) {
+            const auto node = nodes.find_node_by_id(stack.back());
+            stack.pop_back();
+            if (!node)
+                continue;
+            if (node->mode_ != 0)
+                continue;
+            if (!visited.insert(node->id_).second)
+                continue;
+
             active_nodes.push_back(node);
+
+            // Reversed so the first link is visited first
+            const auto incoming = links.links_to(node->id_);
+            for (auto it = incoming.rbegin(); it != incoming.rend(); ++it)
+                stack.push_back((*it)->from_node_);
+        }
+    }
+
+    std::vector<std::string> collect_prompts(
+        const sung::WorkflowNodes& active_nodes
+    ) {
+        std::vector<std::string> output;
+        for (auto active_node : active_nodes) {
+            if (1 != active_node->widgets_values_.size())
+                continue;
+            if (active_node->type_.find("Text") == std::string::npos)
+                continue;
+            output.push_back(active_node->widgets_values_[0]);
+        }
+        return output;
+    }
+
+    std::string collect_model(const sung::WorkflowNodes& active_nodes) {
+        std::string output;
+        for (auto active_node : active_nodes) {
+            if (active_node->type_.contains("Checkpoint")) {
+                if (active_node->widgets_values_.empty())
+                    continue;
+                if (!output.empty())
+                    output += ", ";
+                output += active_node->widgets_values_[0];
+            }
+        }
+
+        if (output.ends_with(".safetensors"))
+            output = output.substr(0, output.size() - 12);
+
+        return output;
+    }
+
+    // Node fields the summary needs. Nodes that are neither prompt nor model
+    // candidates only keep what the traversal needs.
+    struct SummaryNode {
+        std::string first_widget_;
+        std::string type_;
+        size_t widget_count_ = 0;
+        int id_ = 0;
+        int mode_ = 0;
+        bool has_id_ = false;
+        bool is_prompt_ = false;
+        bool is_model_ = false;
+    };
+
+    struct SummaryLink {
+        int from_node_ = 0;
+        int to_node_ = 0;
+    };
+
+    // SAX handler that picks the nodes and links out of the top level
+    // object. Nesting depth tells apart the workflow's own "nodes" from the
+    // ones in subgraph definitions, which `parse_comfyui_workflow` ignores
+    // too.
+    class WorkflowSax {
+
+    public:
+        using json = nlohmann::json;
+
+        bool null() { return this->scalar(json(nullptr)); }
+        bool boolean(bool value) { return this->scalar(json(value)); }
+        bool number_integer(json::number_integer_t value) {
+            return this->scalar(json(value));
+        }
+        bool number_unsigned(json::number_unsigned_t value) {
+            return this->scalar(json(value));
+        }
+        bool number_float(json::number_float_t value, const json::string_t&) {
+            return this->scalar(json(value));
+        }
+        bool string(json::string_t& value) {
+            return this->scalar(json(std::move(value)));
+        }
+        bool binary(json::binary_t&) { return true; }
+
+        bool start_object(size_t) {
+            this->open_container(json::value_t::object);
+            if (depth_ == 3 && section_ == Section::nodes) {
+                nodes_.emplace_back();
+                in_node_ = true;
+                field_ = Field::other;
+            }
+            return true;
+        }
+
+        bool end_object() {
+            if (depth_ == 3 && in_node_) {
+                this->finish_node();
+                in_node_ = false;
+            }
+            this->close_container();
+            return true;
+        }
+
+        bool start_array(size_t) {
+            this->open_container(json::value_t::array);
+            if (depth_ == 3 && section_ == Section::links) {
+                link_ = {};
+                link_index_ = 0;
+                in_link_ = true;
+            }
+            return true;
+        }
+
+        bool end_array() {
+            if (depth_ == 3 && in_link_) {
+                // Both ends are needed, as `parse_comfyui_workflow` reads
+                // all five fields
+                if (link_index_ >= 5)
+                    links_.push_back(link_);
+                in_link_ = false;
+            }
+            this->close_container();
+            return true;
+        }
+
+        bool key(json::string_t& value) {
+            if (capture_depth_) {
+                capture_key_ = std::move(value);
+            } else if (depth_ == 1) {
+                if (value == "nodes")
+                    section_ = Section::nodes;
+                else if (value == "links")
+                    section_ = Section::links;
+                else
+                    section_ = Section::other;
+            } else if (depth_ == 3 && in_node_) {
+                if (value == "id")
+                    field_ = Field::id;
+                else if (value == "type")
+                    field_ = Field::type;
+                else if (value == "mode")
+                    field_ = Field::mode;
+                else if (value == "widgets_values")
+                    field_ = Field::widgets;
+                else
+                    field_ = Field::other;
+            }
+            return true;
+        }
+
+        bool parse_error(
+            size_t, const std::string&, const nlohmann::detail::exception& e
+        ) {
+            error_ = e.what();
+            return false;
+        }
+
+        std::vector<SummaryNode> nodes_;
+        std::vector<SummaryLink> links_;
+        std::string error_;
+
+    private:
+        enum class Section { other, nodes, links };
+        enum class Field { other, id, type, mode, widgets };
+
+        static std::optional<int> to_int(const json& value) {
+            if (!value.is_number())
+                return std::nullopt;
+            return value.get<int>();
+        }
+
+        // Widgets are kept the way `parse_comfyui_workflow` stores them
+        static std::string widget_str(const json& value) {
+            if (value.is_string())
+                return value.get<std::string>();
+            return value.dump();
+        }
+
+        bool in_widgets() const {
+            return in_node_ && field_ == Field::widgets && depth_ == 4;
+        }
+
+        void open_container(const json::value_t type) {
+            if (capture_depth_) {
+                this->add_captured(json(type));
+                ++capture_depth_;
+            } else if (this->in_widgets()) {
+                // A structured widget. Only the first one of a node is
+                // rebuilt, to be dumped like the DOM path does.
+                if (0 == nodes_.back().widget_count_++) {
+                    capture_ = json(type);
+                    capture_stack_.assign({ &capture_ });
+                    capture_depth_ = 1;
+                }
+            }
+            ++depth_;
+        }
+
+        void close_container() {
+            --depth_;
+            if (!capture_depth_)
+                return;
+
+            capture_stack_.pop_back();
+            if (0 == --capture_depth_)
+                nodes_.back().first_widget_ = capture_.dump();
+        }
+
+        void add_captured(json value) {
+            auto& parent = *capture_stack_.back();
+            json* added = nullptr;
+            if (parent.is_array()) {
+                parent.push_back(std::move(value));
+                added = &parent.back();
+            } else {
+                added = &(parent[capture_key_] = std::move(value));
+            }
+            if (added->is_structured())
+                capture_stack_.push_back(added);
+        }
+
+        bool scalar(json value) {
+            if (capture_depth_) {
+                this->add_captured(std::move(value));
+                return true;
+            }
+
+            if (this->in_widgets()) {
+                auto& node = nodes_.back();
+                if (0 == node.widget_count_++)
+                    node.first_widget_ = widget_str(value);
+            } else if (depth_ == 3 && in_node_) {
+                auto& node = nodes_.back();
+                if (field_ == Field::id) {
+                    const auto id = to_int(value);
+                    node.has_id_ = id.has_value();
+                    node.id_ = id.value_or(0);
+                } else if (field_ == Field::mode) {
+                    node.mode_ = to_int(value).value_or(0);
+                } else if (field_ == Field::type && value.is_string()) {
+                    node.type_ = value.get<std::string>();
+                }
+            } else if (depth_ == 3 && in_link_) {
+                const auto index = link_index_++;
+                if (index == 1 || index == 3) {
+                    const auto id = to_int(value);
+                    if (!id)
+                        link_index_ = 0;  // Drops the link
+                    else if (index == 1)
+                        link_.from_node_ = *id;
+                    else
+                        link_.to_node_ = *id;
+                }
+            }
+            return true;
+        }
+
+        void finish_node() {
+            auto& node = nodes_.back();
+            if (!node.has_id_) {
+                // Nothing can link to it
+                nodes_.pop_back();
+                return;
+            }
+
+            // Same filters as `find_prompt` and `find_model`
+            node.is_prompt_ = node.widget_count_ == 1 &&
+                              node.type_.find("Text") != std::string::npos;
+            node.is_model_ = node.widget_count_ > 0 &&
+                             node.type_.contains("Checkpoint");
+            if (!node.is_prompt_ && !node.is_model_)
+                node.first_widget_ = {};
+            node.type_ = {};
         }
 
+        std::vector<json*> capture_stack_;
+        json capture_;
+        std::string capture_key_;
+        SummaryLink link_;
+        size_t capture_depth_ = 0;
+        size_t depth_ = 0;
+        size_t link_index_ = 0;
+        Section section_ = Section::other;
+        Field field_ = Field::other;
+        bool in_node_ = false;
+        bool in_link_ = false;
+    };
+
+    // Visits the active nodes of every terminal node in the order
+    // `find_active_nodes_from_terminal` lists them. Each terminal gets a
+    // fresh visited set, so nodes shared by two outputs count for both, as
+    // they do in `find_prompt` and `find_model`.
+    sung::WorkflowSummary summarize_graph(
+        const std::vector<SummaryNode>& nodes,
+        const std::vector<SummaryLink>& links
+    ) {
+        // `find_node_by_id` returns the first node with an id
+        std::unordered_map<int, size_t> index_of;
+        index_of.reserve(nodes.size());
+        for (size_t i = 0; i < nodes.size(); ++i)
+            index_of.try_emplace(nodes[i].id_, i);
+
+        std::vector<std::vector<int>> incoming(nodes.size());
+        std::unordered_map<int, size_t> from_counts;
+        std::unordered_map<int, size_t> to_counts;
         for (const auto& link : links) {
-            if (link->to_node_ == node->id_) {
-                visit_active_nodes_from_terminal(
-                    link->from_node_, visited, active_nodes, nodes, links
-                );
+            from_counts[link.from_node_]++;
+            to_counts[link.to_node_]++;
+            const auto it = index_of.find(link.to_node_);
+            if (it != index_of.end())
+                incoming[it->second].push_back(link.from_node_);
+        }
+
+        sung::WorkflowSummary output;
+        std::vector<char> visited(nodes.size());
+        std::vector<int> stack;
+        for (const auto& terminal : nodes) {
+            if (from_counts.contains(terminal.id_) ||
+                !to_counts.contains(terminal.id_))
+                continue;
+
+            // Iterative pre-order matching the recursion's visiting order
+            std::fill(visited.begin(), visited.end(), 0);
+            stack.assign({ terminal.id_ });
+            while (!stack.empty()) {
+                const auto it = index_of.find(stack.back());
+                stack.pop_back();
+                if (it == index_of.end())
+                    continue;
+
+                const auto index = it->second;
+                const auto& node = nodes[index];
+                if (node.mode_ != 0 || visited[index])
+                    continue;
+                visited[index] = 1;
+
+                if (node.is_prompt_)
+                    output.prompts_.push_back(node.first_widget_);
+                if (node.is_model_) {
+                    if (!output.model_.empty())
+                        output.model_ += ", ";
+                    output.model_ += node.first_widget_;
+                }
+
+                const auto& sources = incoming[index];
+                stack.insert(stack.end(), sources.rbegin(), sources.rend());
             }
         }
+
+        if (output.model_.ends_with(".safetensors"))
+            output.model_.resize(output.model_.size() - 12);
+
+        return output;
     }
 
 }  // namespace
@@ -42,16 +395,40 @@ namespace sung {
 
     void WorkflowNodes::push_back(const WorkflowNodes::Node* node) {
         nodes_.push_back(node);
+        by_id_.try_emplace(node->id_, node);
     }
 
     const WorkflowNodes::Node* WorkflowNodes::find_node_by_id(
         const int node_id
     ) const {
-        for (const auto& node : nodes_) {
-            if (node->id_ == node_id)
-                return node;
-        }
-        return nullptr;
+        const auto it = by_id_.find(node_id);
+        return it != by_id_.end() ? it->second : nullptr;
+    }
+
+}  // namespace sung
+
+
+// WorkflowLinks
+namespace sung {
+
+    void WorkflowLinks::push_back(const Link* link) {
+        links_.push_back(link);
+        incoming_[link->to_node_].push_back(link);
+        from_counts_[link->from_node_]++;
+    }
+
+    std::span<const WorkflowLinks::Link* const> WorkflowLinks::links_to(
+        const int node_id
+    ) const {
+        const auto it = incoming_.find(node_id);
+        if (it == incoming_.end())
+            return {};
+        return it->second;
+    }
+
+    size_t WorkflowLinks::count_from(const int node_id) const {
+        const auto it = from_counts_.find(node_id);
+        return it != from_counts_.end() ? it->second : 0;
     }
 
 }  // namespace sung
@@ -61,11 +438,13 @@ namespace sung {
 namespace sung {
 
     WorkflowNodes::Node& WorkflowData::new_node() {
+        active_ = std::make_shared<ActiveCache>();
         nodes_.emplace_back();
         return nodes_.back();
     }
 
     WorkflowLinks::Link& WorkflowData::new_link() {
+        active_ = std::make_shared<ActiveCache>();
         links_.emplace_back();
         return links_.back();
     }
@@ -86,6 +465,23 @@ namespace sung {
         return result;
     }
 
+    WorkflowNodes WorkflowData::get_active_nodes() const {
+        std::call_once(active_->once_, [this]() {
+            const auto active_nodes = sung::find_active_nodes(
+                this->get_nodes(), this->get_links()
+            );
+            active_->indices_.reserve(active_nodes.size());
+            for (const auto node : active_nodes)
+                active_->indices_.push_back(node - nodes_.data());
+        });
+
+        WorkflowNodes result;
+        for (const auto index : active_->indices_) {
+            result.push_back(&nodes_[index]);
+        }
+        return result;
+    }
+
 }  // namespace sung
 
 
@@ -167,26 +563,10 @@ namespace sung {
     WorkflowNodes find_terminal_nodes(
         const WorkflowNodes& nodes, const WorkflowLinks& links
     ) {
-        std::unordered_map<int, size_t> node_from_counts;
-        std::unordered_map<int, size_t> node_to_counts;
-
-        for (auto& link : links) {
-            node_from_counts[link->from_node_]++;
-            node_to_counts[link->to_node_]++;
-        }
-
         WorkflowNodes terminal_nodes;
         for (auto& node : nodes) {
-            const auto from_count = node_from_counts.find(node->id_);
-            const auto to_count = node_to_counts.find(node->id_);
-
-            const size_t from_n = (from_count != node_from_counts.end())
-                                      ? from_count->second
-                                      : 0;
-            const size_t to_n = (to_count != node_to_counts.end())
-                                    ? to_count->second
-                                    : 0;
-
+            const auto from_n = links.count_from(node->id_);
+            const auto to_n = links.links_to(node->id_).size();
             if (from_n == 0 && to_n > 0) {
                 terminal_nodes.push_back(node);
             }
@@ -201,61 +581,54 @@ namespace sung {
         const WorkflowLinks& links
     ) {
         WorkflowNodes active_nodes;
-        std::set<int> visited;
         ::visit_active_nodes_from_terminal(
-            node_id, visited, active_nodes, nodes, links
+            node_id, active_nodes, nodes, links
         );
         return active_nodes;
     }
 
-    std::vector<std::string> find_prompt(
+    WorkflowNodes find_active_nodes(
         const WorkflowNodes& nodes, const WorkflowLinks& links
     ) {
-        std::vector<std::string> output;
-
+        WorkflowNodes active_nodes;
         const auto terminal_nodes = sung::find_terminal_nodes(nodes, links);
         for (const auto node : terminal_nodes) {
-            const auto active_nodes = sung::find_active_nodes_from_terminal(
-                node->id_, nodes, links
+            ::visit_active_nodes_from_terminal(
+                node->id_, active_nodes, nodes, links
             );
-            for (auto active_node : active_nodes) {
-                if (1 != active_node->widgets_values_.size())
-                    continue;
-                if (active_node->type_.find("Text") == std::string::npos)
-                    continue;
-                output.push_back(active_node->widgets_values_[0]);
-            }
         }
+        return active_nodes;
+    }
 
-        return output;
+    std::vector<std::string> find_prompt(
+        const WorkflowNodes& nodes, const WorkflowLinks& links
+    ) {
+        return ::collect_prompts(sung::find_active_nodes(nodes, links));
     }
 
     std::string find_model(
         const WorkflowNodes& nodes, const WorkflowLinks& links
     ) {
-        std::string output;
-        const auto terminal_nodes = sung::find_terminal_nodes(nodes, links);
+        return ::collect_model(sung::find_active_nodes(nodes, links));
+    }
 
-        for (const auto node : terminal_nodes) {
-            const auto active_nodes = sung::find_active_nodes_from_terminal(
-                node->id_, nodes, links
-            );
+    std::vector<std::string> find_prompt(const WorkflowData& workflow) {
+        return ::collect_prompts(workflow.get_active_nodes());
+    }
 
-            for (auto active_node : active_nodes) {
-                if (active_node->type_.contains("Checkpoint")) {
-                    if (active_node->widgets_values_.empty())
-                        continue;
-                    if (!output.empty())
-                        output += ", ";
-                    output += active_node->widgets_values_[0];
-                }
-            }
-        }
+    std::string find_model(const WorkflowData& workflow) {
+        return ::collect_model(workflow.get_active_nodes());
+    }
 
-        if (output.ends_with(".safetensors"))
-            output = output.substr(0, output.size() - 12);
+    std::expected<WorkflowSummary, std::string> summarize_comfyui_workflow(
+        const uint8_t* data, size_t size
+    ) {
+        const auto begin = reinterpret_cast<const char*>(data);
+        ::WorkflowSax sax;
+        if (!nlohmann::json::sax_parse(begin, begin + size, &sax))
+            return std::unexpected(std::move(sax.error_));
 
-        return output;
+        return ::summarize_graph(sax.nodes_, sax.links_);
     }
 
 }  // namespace sung
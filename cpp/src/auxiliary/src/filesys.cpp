@@ -1,14 +1,27 @@
 #include "sung/auxiliary/filesys.hpp"
 
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
 #include <format>
 #include <fstream>
 #include <functional>
 #include <sstream>
 #include <thread>
+#include <utility>
 
 #ifdef _WIN32
     #include <Windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #if defined(__APPLE__)
+        #include <sys/clonefile.h>
+    #elif defined(__linux__)
+        #include <linux/fs.h>
+        #include <sys/ioctl.h>
+    #endif
 #endif
 
 
@@ -58,6 +71,85 @@ namespace {
     }
 #endif
 
+    sung::Path make_temp_path(const sung::Path& path) {
+        const auto nonce =
+            std::chrono::steady_clock::now().time_since_epoch().count();
+        return sung::path_concat(
+            path,
+            std::format(
+                ".tmp-{}-{}",
+                std::hash<std::thread::id>{}(std::this_thread::get_id()),
+                nonce
+            )
+        );
+    }
+
+    // Moves `temp_path` over `path`, removing the temp file on failure
+    bool replace_with_temp(
+        const sung::Path& temp_path,
+        const sung::Path& path,
+        std::error_code& error
+    ) {
+#ifdef _WIN32
+        if (!MoveFileExW(
+                temp_path.c_str(),
+                path.c_str(),
+                MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH
+            )) {
+            error = ::last_windows_error();
+            std::error_code cleanup_error;
+            sung::fs::remove(temp_path, cleanup_error);
+            return false;
+        }
+#else
+        sung::fs::rename(temp_path, path, error);
+        if (error) {
+            std::error_code cleanup_error;
+            sung::fs::remove(temp_path, cleanup_error);
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    // `destination` must not exist yet
+    bool clone_or_copy_file(
+        const sung::Path& source,
+        const sung::Path& destination,
+        std::error_code& error
+    ) {
+#if defined(__APPLE__)
+        if (0 == clonefile(source.c_str(), destination.c_str(), 0))
+            return true;
+#elif defined(__linux__)
+        {
+            const int src_fd = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+            if (src_fd >= 0) {
+                const int dst_fd = open(
+                    destination.c_str(),
+                    O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                    0644
+                );
+                const bool cloned = dst_fd >= 0 &&
+                                    0 == ioctl(dst_fd, FICLONE, src_fd);
+                if (dst_fd >= 0)
+                    close(dst_fd);
+                close(src_fd);
+                if (cloned)
+                    return true;
+
+                // Not a reflink-capable filesystem, or source and
+                // destination live on different ones
+                std::error_code cleanup_error;
+                sung::fs::remove(destination, cleanup_error);
+            }
+        }
+#endif
+        return sung::fs::copy_file(
+            source, destination, sung::fs::copy_options::none, error
+        );
+    }
+
 }  // namespace
 
 
@@ -115,41 +207,29 @@ namespace sung {
         std::error_code& error
     ) {
         error.clear();
-        const auto nonce =
-            std::chrono::steady_clock::now().time_since_epoch().count();
-        const auto temp_path = path_concat(
-            path,
-            std::format(
-                ".tmp-{}-{}",
-                std::hash<std::thread::id>{}(std::this_thread::get_id()),
-                nonce
-            )
-        );
+        const auto temp_path = ::make_temp_path(path);
         if (!write_file(temp_path, data, size)) {
             error = std::make_error_code(std::errc::io_error);
             return false;
         }
 
-#ifdef _WIN32
-        if (!MoveFileExW(
-                temp_path.c_str(),
-                path.c_str(),
-                MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH
-            )) {
-            error = ::last_windows_error();
-            std::error_code cleanup_error;
-            fs::remove(temp_path, cleanup_error);
-            return false;
-        }
-#else
-        fs::rename(temp_path, path, error);
-        if (error) {
+        return ::replace_with_temp(temp_path, path, error);
+    }
+
+    bool copy_file_atomically(
+        const Path& source, const Path& destination, std::error_code& error
+    ) {
+        error.clear();
+        const auto temp_path = ::make_temp_path(destination);
+        if (!::clone_or_copy_file(source, temp_path, error)) {
+            if (!error)
+                error = std::make_error_code(std::errc::io_error);
             std::error_code cleanup_error;
             fs::remove(temp_path, cleanup_error);
             return false;
         }
-#endif
-        return true;
+
+        return ::replace_with_temp(temp_path, destination, error);
     }
 
     std::error_code read_file_timestamps(
@@ -226,3 +306,142 @@ namespace sung {
     }
 
 }  // namespace sung
+
+
+// RandomAccessFile
+namespace sung {
+
+    RandomAccessFile::~RandomAccessFile() { this->close(); }
+
+    RandomAccessFile::RandomAccessFile(RandomAccessFile&& other) noexcept
+#ifdef _WIN32
+        : handle_(std::exchange(other.handle_, nullptr))
+#else
+        : fd_(std::exchange(other.fd_, -1))
+#endif
+        , size_(std::exchange(other.size_, 0)) {
+    }
+
+    RandomAccessFile& RandomAccessFile::operator=(
+        RandomAccessFile&& other
+    ) noexcept {
+        if (this != &other) {
+            this->close();
+#ifdef _WIN32
+            handle_ = std::exchange(other.handle_, nullptr);
+#else
+            fd_ = std::exchange(other.fd_, -1);
+#endif
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    std::error_code RandomAccessFile::open(const Path& path) {
+        this->close();
+
+#ifdef _WIN32
+        const auto handle = CreateFileW(
+            path.c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,
+            nullptr
+        );
+        if (handle == INVALID_HANDLE_VALUE)
+            return ::last_windows_error();
+
+        LARGE_INTEGER file_size{};
+        if (!GetFileSizeEx(handle, &file_size)) {
+            const auto error = ::last_windows_error();
+            CloseHandle(handle);
+            return error;
+        }
+
+        handle_ = handle;
+        size_ = static_cast<uint64_t>(file_size.QuadPart);
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return std::error_code(errno, std::generic_category());
+
+        struct stat attributes{};
+        if (fstat(fd, &attributes) != 0) {
+            const std::error_code error(errno, std::generic_category());
+            ::close(fd);
+            return error;
+        }
+
+        fd_ = fd;
+        size_ = static_cast<uint64_t>(attributes.st_size);
+#endif
+        return {};
+    }
+
+    void RandomAccessFile::close() {
+#ifdef _WIN32
+        if (handle_)
+            CloseHandle(std::exchange(handle_, nullptr));
+#else
+        if (fd_ >= 0)
+            ::close(std::exchange(fd_, -1));
+#endif
+        size_ = 0;
+    }
+
+    bool RandomAccessFile::is_open() const {
+#ifdef _WIN32
+        return handle_ != nullptr;
+#else
+        return fd_ >= 0;
+#endif
+    }
+
+    std::expected<size_t, std::error_code> RandomAccessFile::read_at(
+        const uint64_t offset, void* const dst, const size_t size
+    ) const {
+        if (!this->is_open())
+            return std::unexpected(
+                std::make_error_code(std::errc::bad_file_descriptor)
+            );
+
+        auto out = static_cast<uint8_t*>(dst);
+        size_t total = 0;
+        while (total < size) {
+            const auto position = offset + total;
+#ifdef _WIN32
+            OVERLAPPED overlapped{};
+            overlapped.Offset = static_cast<DWORD>(position);
+            overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+
+            const auto wanted = static_cast<DWORD>(
+                std::min<size_t>(size - total, 1 << 30)
+            );
+            DWORD read = 0;
+            if (!ReadFile(handle_, out + total, wanted, &read, &overlapped)) {
+                if (GetLastError() == ERROR_HANDLE_EOF)
+                    break;
+                return std::unexpected(::last_windows_error());
+            }
+#else
+            const auto read = pread(
+                fd_, out + total, size - total, static_cast<off_t>(position)
+            );
+            if (read < 0) {
+                if (errno == EINTR)
+                    continue;
+                return std::unexpected(
+                    std::error_code(errno, std::generic_category())
+                );
+            }
+#endif
+            if (read == 0)
+                break;
+            total += static_cast<size_t>(read);
+        }
+        return total;
+    }
+
+}  // namespace sung
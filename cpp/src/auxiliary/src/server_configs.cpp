@@ -13,6 +13,11 @@ namespace {
     constexpr int DEFAULT_PORT = 8787;
     const std::string DEFAULT_TAGGER_HOST = "127.0.0.1";
     constexpr int DEFAULT_TAGGER_PORT = 8790;
+    // Each request in flight holds a connection and a thread
+    constexpr int MAX_TAGGER_IN_FLIGHT = 8;
+    constexpr int64_t DEFAULT_INDEX_MMAP_SIZE_MB = 256;
+    constexpr int64_t DEFAULT_INDEX_CACHE_SIZE_MB = 64;
+    constexpr int DEFAULT_INDEX_PAGE_SIZE = 4096;
 
 
     const std::map<sung::ServerConfigs::AvifPixelFormat, std::string>
@@ -73,6 +78,21 @@ namespace {
         }
     }
 
+    // SSIM is 1 only for a lossless match; anything outside (0, 1) turns
+    // the target off.
+    double clamp_target_ssim(const double value) {
+        if (value <= 0 || value >= 1)
+            return 0;
+        return value;
+    }
+
+    // SQLite accepts powers of two from 512 to 65536
+    int sanitize_page_size(const int value) {
+        if (value < 512 || value > 65536 || (value & (value - 1)) != 0)
+            return DEFAULT_INDEX_PAGE_SIZE;
+        return value;
+    }
+
     sung::ErrStr load_or_create_new_server_configs(
         const sung::Path& path, sung::ServerConfigs& configs
     ) {
@@ -137,6 +157,7 @@ namespace sung {
 
         avif_pix_format_ = ServerConfigs::AvifPixelFormat::yuv444;
         avif_quality_ = 70.0;
+        avif_target_ssim_ = 0;
         avif_speed_ = 4;
         avif_gen_ = false;
         avif_gen_remove_src_ = false;
@@ -145,7 +166,13 @@ namespace sung {
         tagger_host_ = DEFAULT_TAGGER_HOST;
         tagger_port_ = DEFAULT_TAGGER_PORT;
         tagger_batch_size_ = 4;
+        tagger_max_in_flight_ = 2;
         tagger_poll_interval_seconds_ = 30;
+
+        index_mmap_size_mb_ = DEFAULT_INDEX_MMAP_SIZE_MB;
+        index_cache_size_mb_ = DEFAULT_INDEX_CACHE_SIZE_MB;
+        index_temp_store_memory_ = true;
+        index_page_size_ = DEFAULT_INDEX_PAGE_SIZE;
     }
 
     ServerConfigs::AvifOptions ServerConfigs::effective_avif_options(
@@ -156,6 +183,9 @@ namespace sung {
             avif_pix_format_
         );
         output.quality_ = binding.avif_.quality_.value_or(avif_quality_);
+        output.target_ssim_ = binding.avif_.target_ssim_.value_or(
+            avif_target_ssim_
+        );
         output.speed_ = binding.avif_.speed_.value_or(avif_speed_);
         output.gen_ = binding.avif_.gen_.value_or(avif_gen_);
         output.gen_remove_src_ = binding.avif_.gen_remove_src_.value_or(
@@ -246,6 +276,14 @@ namespace sung {
                 binding_info.avif_.quality_ = try_get_opt<double>(
                     json_binding, "avif_quality"
                 );
+                binding_info.avif_.target_ssim_ = try_get_opt<double>(
+                    json_binding, "avif_target_ssim"
+                );
+                if (binding_info.avif_.target_ssim_) {
+                    binding_info.avif_.target_ssim_ = ::clamp_target_ssim(
+                        *binding_info.avif_.target_ssim_
+                    );
+                }
                 binding_info.avif_.speed_ = try_get_opt<int>(
                     json_binding, "avif_speed"
                 );
@@ -274,6 +312,9 @@ namespace sung {
         }
 
         avif_quality_ = try_get(json_data, "avif_quality", 70.0);
+        avif_target_ssim_ = ::clamp_target_ssim(
+            try_get(json_data, "avif_target_ssim", 0.0)
+        );
         avif_speed_ = try_get(json_data, "avif_speed", 4);
         avif_gen_ = try_get(json_data, "avif_gen", false);
         avif_gen_remove_src_ = try_get(json_data, "avif_gen_remove_src", false);
@@ -286,9 +327,33 @@ namespace sung {
         tagger_batch_size_ = std::max(
             try_get(json_data, "tagger_batch_size", 4), 1
         );
+        tagger_max_in_flight_ = std::clamp(
+            try_get(json_data, "tagger_max_in_flight", 2),
+            1,
+            MAX_TAGGER_IN_FLIGHT
+        );
         tagger_poll_interval_seconds_ = std::max(
             try_get(json_data, "tagger_poll_interval_seconds", 30.0), 1.0
         );
+
+        index_mmap_size_mb_ = std::max<int64_t>(
+            try_get(
+                json_data, "index_mmap_size_mb", DEFAULT_INDEX_MMAP_SIZE_MB
+            ),
+            0
+        );
+        index_cache_size_mb_ = std::max<int64_t>(
+            try_get(
+                json_data, "index_cache_size_mb", DEFAULT_INDEX_CACHE_SIZE_MB
+            ),
+            0
+        );
+        index_temp_store_memory_ = try_get(
+            json_data, "index_temp_store_memory", true
+        );
+        index_page_size_ = ::sanitize_page_size(
+            try_get(json_data, "index_page_size", DEFAULT_INDEX_PAGE_SIZE)
+        );
     }
 
     nlohmann::json ServerConfigs::export_json() const {
@@ -316,6 +381,8 @@ namespace sung {
                 }
                 if (overrides.quality_)
                     json_binding["avif_quality"] = *overrides.quality_;
+                if (overrides.target_ssim_)
+                    json_binding["avif_target_ssim"] = *overrides.target_ssim_;
                 if (overrides.speed_)
                     json_binding["avif_speed"] = *overrides.speed_;
                 if (overrides.gen_)
@@ -338,6 +405,7 @@ namespace sung {
 
         output["avif_pix_format"] = ::tostr(avif_pix_format_);
         output["avif_quality"] = avif_quality_;
+        output["avif_target_ssim"] = avif_target_ssim_;
         output["avif_speed"] = avif_speed_;
         output["avif_gen"] = avif_gen_;
         output["avif_gen_remove_src"] = avif_gen_remove_src_;
@@ -346,8 +414,14 @@ namespace sung {
         output["tagger_host"] = tagger_host_;
         output["tagger_port"] = tagger_port_;
         output["tagger_batch_size"] = tagger_batch_size_;
+        output["tagger_max_in_flight"] = tagger_max_in_flight_;
         output["tagger_poll_interval_seconds"] = tagger_poll_interval_seconds_;
 
+        output["index_mmap_size_mb"] = index_mmap_size_mb_;
+        output["index_cache_size_mb"] = index_cache_size_mb_;
+        output["index_temp_store_memory"] = index_temp_store_memory_;
+        output["index_page_size"] = index_page_size_;
+
         return output;
     }
 
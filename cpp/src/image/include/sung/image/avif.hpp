@@ -1,10 +1,14 @@
 #pragma once
 
+#include <expected>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include <avif/avif.h>
 
+#include "sung/auxiliary/filesys.hpp"
+
 
 namespace sung {
 
@@ -19,17 +23,24 @@ namespace sung {
         int speed() const;
 
         // Map "quality [0, 100]" → AV1 quantizer [0, 63] (0 best, 63 worst)
+        // unless a quantizer was set explicitly
         int calc_quantizer() const;
 
         void set_xmp(const std::string& xmp);
+        void set_xmp(std::vector<uint8_t>&& xmp);
+        // Moves the blob out, for callers that keep it after encoding
+        std::vector<uint8_t> take_xmp();
         void set_yuv_format(avifPixelFormat f);
         // [0, 100]
         void set_quality(double q);
         // [0, 10]
         void set_speed(int s);
+        // [0, 63], overrides the quality mapping
+        void set_quantizer(std::optional<int> q);
 
     private:
         std::vector<uint8_t> xmp_blob_;
+        std::optional<int> quantizer_;
         avifPixelFormat yuv_format_;
         double quality_;
         int speed_;
@@ -40,8 +51,14 @@ namespace sung {
         std::vector<uint8_t> find_workflow_data() const;
 
         std::vector<uint8_t> xmp_data_;
+        uint32_t width_ = 0;
+        uint32_t height_ = 0;
     };
 
     AvifMeta read_avif_metadata_only(const uint8_t* data, size_t size);
+    // Reads only the container boxes, not the image payload
+    std::expected<AvifMeta, std::string> read_avif_metadata_only(
+        const RandomAccessFile& file
+    );
 
 }  // namespace sung
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <compare>
+#include <expected>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include <avif/avif.h>
+
+#include "sung/image/avif.hpp"
+
+
+namespace sung {
+
+    // Mean SSIM of two 8-bit planes of the same size over 8x8 windows.
+    // 1 means identical.
+    double calc_plane_ssim(
+        const uint8_t* a,
+        size_t a_row_bytes,
+        const uint8_t* b,
+        size_t b_row_bytes,
+        uint32_t width,
+        uint32_t height
+    );
+
+    // Binary-searches the coarsest quantizer whose encode still reaches
+    // `target_ssim`. Trials run on a downscaled luma-only copy of `image`
+    // at a fast speed, so the whole search costs a fraction of one real
+    // encode. `image` must be 8-bit with its planes allocated. Fails if not
+    // even the finest quantizer reaches the target.
+    std::expected<int, std::string> search_avif_quantizer(
+        const avifImage& image,
+        const AvifEncodeParams& params,
+        double target_ssim
+    );
+
+
+    // Quantizers found by `search_avif_quantizer`, shared between images that
+    // tend to compress alike, so most files skip the search entirely.
+    class AvifQuantizerCache {
+
+    public:
+        struct Key {
+            auto operator<=>(const Key&) const = default;
+
+            std::string model_;
+            int resolution_bucket_ = 0;
+            double target_ssim_ = 0;
+        };
+
+        // Pixel count in octaves, so 1024x1024 and 1216x832 share a bucket
+        static int resolution_bucket(uint32_t width, uint32_t height);
+
+        std::optional<int> find(const Key& key) const;
+        void store(const Key& key, int quantizer);
+
+    private:
+        mutable std::mutex mut_;
+        std::map<Key, int> entries_;
+    };
+
+}  // namespace sung
@@ -17,20 +17,19 @@ namespace sung {
     class ImageInfo {
 
     public:
+        enum class Format { unknown, png, avif, other };
+
         struct ComfyUiInfo {
 
         public:
             void set_workflow(const uint8_t* data, size_t size);
 
-            const WorkflowData& workflow() const { return workflow_; }
-            const sung::WorkflowNodes& nodes() const { return nodes_; }
-            const sung::WorkflowLinks& links() const { return links_; }
+            // Empty if the workflow is not valid JSON
+            const WorkflowSummary& summary() const { return summary_; }
             const std::string& workflow_src() const { return workflow_src_; }
 
         private:
-            WorkflowData workflow_;
-            sung::WorkflowNodes nodes_;
-            sung::WorkflowLinks links_;
+            WorkflowSummary summary_;
             std::string workflow_src_;
         };
 
@@ -57,9 +56,17 @@ namespace sung {
         bool parse_stable_diffusion_model();
         bool parse_stable_diffusion_prompt();
 
+        // Dimensions, format and the ComfyUI workflow from a single open that
+        // reads only the header and metadata ranges of PNG and AVIF files.
+        // Other formats have no workflow and fall back to `load_simple_info`.
+        // Does not fill `simple()`, `png()` or `avif()` for PNG and AVIF.
+        // Returns false if the file is not a readable image.
+        bool load_info_and_metadata();
+
         const refimg::SimpleImageInfo& simple() const { return simple_; }
-        int64_t width() const { return simple_.width_; }
-        int64_t height() const { return simple_.height_; }
+        int64_t width() const { return width_; }
+        int64_t height() const { return height_; }
+        Format format() const { return format_; }
 
         const StableDiffusionInfo& sd() const { return sd_; }
 
@@ -71,6 +78,9 @@ namespace sung {
         sung::Path file_path_;
         refimg::SimpleImageInfo simple_;
         StableDiffusionInfo sd_;
+        int64_t width_ = 0;
+        int64_t height_ = 0;
+        Format format_ = Format::unknown;
 
         std::optional<PngInfo> png_;
         std::optional<AvifInfo> avif_;
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <expected>
+#include <functional>
 #include <string>
 #include <vector>
 
 #include <png.h>
 
+#include "sung/auxiliary/err_str.hpp"
 #include "sung/auxiliary/path.hpp"
 
 
@@ -49,4 +51,24 @@ namespace sung {
 
     std::expected<PngData, std::string> read_png(const Path& path);
 
+    // Called once the header is parsed, before any pixel rows are decoded.
+    // The meta describes the RGBA8 rows that follow.
+    using PngHeaderFn = std::function<ErrStr(const PngMeta& meta)>;
+    // Receives `row_count` tightly packed RGBA8 rows starting at `first_row`.
+    // The buffer is reused for the next strip.
+    using PngStripFn = std::function<
+        ErrStr(const uint8_t* rows, int first_row, int row_count)>;
+
+    // Same conversion as `read_png`, but delivers pixels in strips of at most
+    // `strip_rows` rows so the full RGBA frame is never held in memory.
+    // Interlaced images can only be finalized after the last Adam7 pass, so
+    // they are decoded whole and then handed out strip by strip.
+    // An error returned from a callback aborts decoding and is passed through.
+    std::expected<PngMeta, std::string> read_png_strips(
+        const Path& path,
+        int strip_rows,
+        const PngHeaderFn& on_header,
+        const PngStripFn& on_strip
+    );
+
 }  // namespace sung
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "sung/auxiliary/filesys.hpp"
+#include "sung/auxiliary/path.hpp"
+
+
+namespace sung {
+
+    struct PngChunkText {
+        std::string_view key_;
+        std::string_view value_;
+    };
+
+    // IHDR fields and text chunks of a PNG, parsed straight from the chunk
+    // stream without libpng. Text views point either into the buffer given
+    // to `parse_png_chunks` or into storage owned by this object, which
+    // stays put when the object is moved. Copying is disabled because the
+    // copies would still point into the original's storage.
+    struct PngChunkMeta {
+        PngChunkMeta() = default;
+        PngChunkMeta(PngChunkMeta&&) = default;
+        PngChunkMeta& operator=(PngChunkMeta&&) = default;
+        PngChunkMeta(const PngChunkMeta&) = delete;
+        PngChunkMeta& operator=(const PngChunkMeta&) = delete;
+
+        // Value of the first text chunk with `key`
+        std::optional<std::string_view> find_text(std::string_view key) const;
+
+        int width_ = 0;
+        int height_ = 0;
+        int bit_depth_ = 0;
+        int color_type_ = 0;
+        bool interlaced_ = false;
+        std::vector<PngChunkText> text_;
+        // Backs the views of chunks read from a file or inflated from
+        // zTXt/iTXt
+        std::vector<std::vector<char>> storage_;
+    };
+
+    // Keys of the text chunks to keep. Empty keeps all of them.
+    using PngTextKeys = std::span<const std::string_view>;
+
+    // Walks the chunks of an in-memory PNG up to the first IDAT. Malformed
+    // text chunks are skipped. Unlike libpng, only the IHDR CRC is checked.
+    // `data` must outlive the result.
+    std::expected<PngChunkMeta, std::string> parse_png_chunks(
+        const uint8_t* data, size_t size, PngTextKeys keys = {}
+    );
+
+    // Same, reading the file with a few positioned reads. Chunks that are
+    // not kept are seeked over instead of read.
+    std::expected<PngChunkMeta, std::string> read_png_chunks(
+        const Path& path, PngTextKeys keys = {}
+    );
+    std::expected<PngChunkMeta, std::string> read_png_chunks(
+        const RandomAccessFile& file, PngTextKeys keys = {}
+    );
+
+}  // namespace sung
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 #include <nlohmann/json_fwd.hpp>
 
@@ -15,4 +17,11 @@ namespace sung {
         const PngMeta& src, const nlohmann::json& tag_analysis
     );
 
+    // Same bytes, built straight into the buffer `AvifEncodeParams` keeps
+    std::vector<uint8_t> make_xmp_blob(const PngMeta& src);
+
+    std::vector<uint8_t> make_xmp_blob(
+        const PngMeta& src, const nlohmann::json& tag_analysis
+    );
+
 }  // namespace sung
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <avif/avif.h>
+
+#include "sung/auxiliary/err_str.hpp"
+
+
+namespace sung {
+
+    enum class YuvConverter {
+        best,    // AVX2 where the CPU has it, scalar otherwise
+        scalar,  // Portable, what `best` falls back to
+        avx2,    // Fails on CPUs and builds without AVX2
+    };
+
+    bool has_avx2_yuv_converter();
+
+    // Converts `row_count` RGBA8 rows into `image` starting at its row
+    // `first_row`: the YUV planes, and the alpha plane if allocated. Rounds
+    // like libavif's own `avifImageRGBToYUV` without libyuv. `image` must be
+    // 8-bit with its planes allocated. 4:2:0 strips must start on an even
+    // row and have an even row count unless they end the image.
+    //
+    // Fails on settings it does not handle, such as the identity, YCgCo or
+    // chromaticity-derived matrices. Use `avifImageRGBToYUV` then.
+    ErrStr rgba_to_yuv(
+        avifImage& image,
+        const uint8_t* rgba,
+        size_t row_bytes,
+        uint32_t first_row,
+        uint32_t row_count,
+        YuvConverter converter = YuvConverter::best
+    );
+
+}  // namespace sung
@@ -5,13 +5,59 @@
 #include <functional>
 #include <print>
 #include <set>
+#include <utility>
 
 #include <avif/avif.h>
 #include <pugixml.hpp>
 
+#include "avif_boxes.hpp"
+#include "xmp_scan.hpp"
+#include "sung/auxiliary/filesys.hpp"
+
 
 namespace {
 
+    struct FileIO {
+        static void destroy(avifIO* io) {
+            delete static_cast<FileIO*>(io->data);
+        }
+
+        static avifResult read(
+            avifIO* io,
+            const uint32_t read_flags,
+            const uint64_t offset,
+            const size_t size,
+            avifROData* out
+        ) {
+            if (read_flags != 0)
+                return AVIF_RESULT_IO_ERROR;
+
+            auto& self = *static_cast<FileIO*>(io->data);
+            const auto file_size = self.file_->size();
+            if (offset > file_size)
+                return AVIF_RESULT_IO_ERROR;
+
+            const auto wanted = std::min<uint64_t>(size, file_size - offset);
+            self.buffer_.resize(static_cast<size_t>(wanted));
+            const auto read = self.file_->read_at(
+                offset, self.buffer_.data(), self.buffer_.size()
+            );
+            if (!read)
+                return AVIF_RESULT_IO_ERROR;
+
+            out->data = self.buffer_.data();
+            out->size = *read;
+            return AVIF_RESULT_OK;
+        }
+
+        avifIO io_{};
+        const sung::RandomAccessFile* file_ = nullptr;
+        // Holds the last read until the next one, as libavif expects of a
+        // non-persistent IO
+        std::vector<uint8_t> buffer_;
+    };
+
+
     class AvifDecoder {
 
     public:
@@ -30,8 +76,29 @@ namespace {
             return avifDecoderSetIOMemory(decoder_, data, size);
         }
 
+        // Only the boxes `parse` needs are read; pixel data is skipped
+        avifResult set_io_file(const sung::RandomAccessFile& file) {
+            if (!decoder_)
+                return AVIF_RESULT_OUT_OF_MEMORY;
+
+            auto io = new FileIO{};
+            io->io_.destroy = FileIO::destroy;
+            io->io_.read = FileIO::read;
+            io->io_.sizeHint = file.size();
+            io->io_.persistent = AVIF_FALSE;
+            io->io_.data = io;
+            io->file_ = &file;
+            // The decoder owns `io` from here on
+            avifDecoderSetIO(decoder_, &io->io_);
+            return AVIF_RESULT_OK;
+        }
+
         avifResult parse() { return avifDecoderParse(decoder_); }
 
+        const avifImage* image() const {
+            return decoder_ ? decoder_->image : nullptr;
+        }
+
         const avifRWData* xmp() const {
             if (!decoder_)
                 return nullptr;
@@ -64,6 +131,9 @@ namespace sung {
     int AvifEncodeParams::speed() const { return speed_; }
 
     int AvifEncodeParams::calc_quantizer() const {
+        if (quantizer_)
+            return *quantizer_;
+
         constexpr double gamma = 1.6;
 
         double q = (100.0 - quality_) / 100.0;  // 0..1 (0 = best)
@@ -77,6 +147,14 @@ namespace sung {
         xmp_blob_.assign(xmp.data(), xmp.data() + xmp.size());
     }
 
+    void AvifEncodeParams::set_xmp(std::vector<uint8_t>&& xmp) {
+        xmp_blob_ = std::move(xmp);
+    }
+
+    std::vector<uint8_t> AvifEncodeParams::take_xmp() {
+        return std::exchange(xmp_blob_, {});
+    }
+
     void AvifEncodeParams::set_yuv_format(avifPixelFormat f) {
         yuv_format_ = f;
     }
@@ -87,6 +165,12 @@ namespace sung {
 
     void AvifEncodeParams::set_speed(int s) { speed_ = std::clamp(s, 0, 10); }
 
+    void AvifEncodeParams::set_quantizer(std::optional<int> q) {
+        if (q)
+            q = std::clamp(*q, 0, 63);
+        quantizer_ = q;
+    }
+
 }  // namespace sung
 
 
@@ -129,10 +213,26 @@ namespace {
         return result;
     }
 
+    void fill_avif_meta(const AvifDecoder& decoder, sung::AvifMeta& meta) {
+        if (const auto image = decoder.image()) {
+            meta.width_ = image->width;
+            meta.height_ = image->height;
+        }
+        if (const auto xmp = decoder.xmp())
+            meta.xmp_data_.assign(xmp->data, xmp->data + xmp->size);
+    }
+
 }  // namespace
 namespace sung {
 
     std::vector<uint8_t> AvifMeta::find_workflow_data() const {
+        // Skips building a DOM of the whole packet, tag analysis included
+        auto scanned = detail::scan_xmp_workflow(
+            xmp_data_.data(), xmp_data_.size()
+        );
+        if (scanned)
+            return std::move(*scanned);
+
         pugi::xml_document xmp_doc;
         const auto parse_result = xmp_doc.load_buffer(
             xmp_data_.data(), xmp_data_.size()
@@ -172,10 +272,27 @@ namespace sung {
         if (AVIF_RESULT_OK != decoder.parse())
             return meta;
 
-        if (auto xmp = decoder.xmp()) {
-            meta.xmp_data_.assign(xmp->data, xmp->data + xmp->size);
-        }
+        ::fill_avif_meta(decoder, meta);
+        return meta;
+    }
+
+    std::expected<AvifMeta, std::string> read_avif_metadata_only(
+        const RandomAccessFile& file
+    ) {
+        if (auto meta = detail::read_avif_boxes(file))
+            return std::move(*meta);
 
+        // Unusual layouts are left to libavif
+        ::AvifDecoder decoder;
+
+        auto result = decoder.set_io_file(file);
+        if (AVIF_RESULT_OK == result)
+            result = decoder.parse();
+        if (AVIF_RESULT_OK != result)
+            return std::unexpected(avifResultToString(result));
+
+        AvifMeta meta;
+        ::fill_avif_meta(decoder, meta);
         return meta;
     }
 
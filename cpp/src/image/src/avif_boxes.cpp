@@ -0,0 +1,508 @@
+#include "avif_boxes.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace {
+
+    // A still image's `meta` box is a few hundred bytes; anything this big
+    // is not the layout this reader is for
+    constexpr uint64_t MAX_META_BYTES = 4 << 20;
+    constexpr uint64_t MAX_XMP_BYTES = 16 << 20;
+    // Top-level boxes visited while looking for `meta`
+    constexpr int MAX_TOP_LEVEL_BOXES = 64;
+    // First read, which usually covers `ftyp` and `meta` together
+    constexpr size_t HEAD_BYTES = 4096;
+
+    constexpr std::string_view XMP_CONTENT_TYPE = "application/rdf+xml";
+
+
+    // Big-endian reads that stop at the end of the buffer and remember that
+    // they did, so parsers can check once at the end
+    class ByteReader {
+
+    public:
+        ByteReader() = default;
+        ByteReader(const uint8_t* data, size_t size)
+            : data_(data), size_(size) {}
+
+        bool ok() const { return ok_; }
+        size_t remaining() const { return size_ - pos_; }
+        const uint8_t* here() const { return data_ + pos_; }
+
+        uint64_t uint(const size_t bytes) {
+            if (bytes > this->remaining()) {
+                this->fail();
+                return 0;
+            }
+
+            uint64_t output = 0;
+            for (size_t i = 0; i < bytes; ++i)
+                output = (output << 8) | data_[pos_ + i];
+            pos_ += bytes;
+            return output;
+        }
+
+        uint8_t u8() { return static_cast<uint8_t>(this->uint(1)); }
+        uint16_t u16() { return static_cast<uint16_t>(this->uint(2)); }
+        uint32_t u32() { return static_cast<uint32_t>(this->uint(4)); }
+        uint64_t u64() { return this->uint(8); }
+
+        std::string_view fourcc() {
+            if (4 > this->remaining()) {
+                this->fail();
+                return {};
+            }
+            const std::string_view output(
+                reinterpret_cast<const char*>(this->here()), 4
+            );
+            pos_ += 4;
+            return output;
+        }
+
+        // NUL-terminated string, without the NUL
+        std::string_view cstr() {
+            const auto begin = reinterpret_cast<const char*>(this->here());
+            const auto nul = static_cast<const char*>(
+                std::memchr(begin, 0, this->remaining())
+            );
+            if (!nul) {
+                this->fail();
+                return {};
+            }
+            pos_ += static_cast<size_t>(nul - begin) + 1;
+            return std::string_view(begin, nul);
+        }
+
+        void skip(const size_t bytes) {
+            if (bytes > this->remaining())
+                this->fail();
+            else
+                pos_ += bytes;
+        }
+
+        // Takes the next `bytes` as a reader of their own
+        ByteReader sub(const size_t bytes) {
+            if (bytes > this->remaining()) {
+                this->fail();
+                return {};
+            }
+            ByteReader output{ this->here(), bytes };
+            pos_ += bytes;
+            return output;
+        }
+
+    private:
+        void fail() {
+            ok_ = false;
+            pos_ = size_;
+        }
+
+        const uint8_t* data_ = nullptr;
+        size_t size_ = 0;
+        size_t pos_ = 0;
+        bool ok_ = true;
+    };
+
+
+    struct Box {
+        std::string_view type_;
+        ByteReader body_;
+    };
+
+    // Next child box of `parent`, or nothing at the end or on a bad header
+    std::optional<Box> next_box(ByteReader& parent) {
+        if (parent.remaining() == 0)
+            return std::nullopt;
+
+        const auto start = parent.remaining();
+        uint64_t size = parent.u32();
+        const auto type = parent.fourcc();
+        if (size == 1)
+            size = parent.u64();
+        else if (size == 0)
+            size = start;
+
+        const auto header = start - parent.remaining();
+        if (!parent.ok() || size < header || size - header > parent.remaining())
+            return std::nullopt;
+
+        return Box{ type, parent.sub(static_cast<size_t>(size - header)) };
+    }
+
+    struct FullBoxHeader {
+        uint8_t version_ = 0;
+        uint32_t flags_ = 0;
+    };
+
+    FullBoxHeader read_full_box_header(ByteReader& reader) {
+        const auto word = reader.u32();
+        return { static_cast<uint8_t>(word >> 24), word & 0xFFFFFF };
+    }
+
+
+    struct ItemLocation {
+        struct Extent {
+            uint64_t offset_ = 0;
+            uint64_t length_ = 0;
+        };
+
+        uint8_t construction_method_ = 0;
+        uint16_t data_reference_index_ = 0;
+        uint64_t base_offset_ = 0;
+        std::vector<Extent> extents_;
+    };
+
+    struct MetaBox {
+        std::optional<uint32_t> primary_item_;
+        std::vector<uint32_t> xmp_items_;
+        std::unordered_map<uint32_t, ItemLocation> locations_;
+        // `cdsc` references: metadata item to the items it describes
+        std::unordered_map<uint32_t, std::vector<uint32_t>> describes_;
+        // `ipco` entries in order, with the size if the entry is an `ispe`
+        std::vector<std::optional<std::pair<uint32_t, uint32_t>>> properties_;
+        // Item to 1-based `ipco` indices
+        std::unordered_map<uint32_t, std::vector<uint32_t>> associations_;
+        ByteReader idat_;
+        bool has_idat_ = false;
+    };
+
+    bool parse_iinf(ByteReader reader, MetaBox& meta) {
+        const auto header = ::read_full_box_header(reader);
+        reader.skip(header.version_ == 0 ? 2 : 4);
+
+        while (auto box = ::next_box(reader)) {
+            if (box->type_ != "infe")
+                continue;
+
+            auto& body = box->body_;
+            const auto infe = ::read_full_box_header(body);
+            // Versions 0 and 1 predate item types
+            if (infe.version_ < 2)
+                return false;
+
+            const auto id = infe.version_ == 2 ? body.u16() : body.u32();
+            body.skip(2);  // item_protection_index
+            const auto item_type = body.fourcc();
+            if (item_type != "mime")
+                continue;
+
+            body.cstr();  // item_name
+            const auto content_type = body.cstr();
+            if (!body.ok())
+                return false;
+            if (content_type == XMP_CONTENT_TYPE)
+                meta.xmp_items_.push_back(id);
+        }
+        return reader.ok();
+    }
+
+    bool parse_iloc(ByteReader reader, MetaBox& meta) {
+        const auto header = ::read_full_box_header(reader);
+        if (header.version_ > 2)
+            return false;
+
+        const auto sizes = reader.u8();
+        const auto offset_size = sizes >> 4;
+        const auto length_size = sizes & 0xF;
+        const auto more_sizes = reader.u8();
+        const auto base_offset_size = more_sizes >> 4;
+        const auto index_size = header.version_ > 0 ? more_sizes & 0xF : 0;
+
+        const auto item_count = header.version_ < 2 ? reader.u16()
+                                                    : reader.u32();
+        for (uint32_t i = 0; i < item_count && reader.ok(); ++i) {
+            const auto id = header.version_ < 2 ? reader.u16() : reader.u32();
+
+            ItemLocation location;
+            if (header.version_ > 0)
+                location.construction_method_ = reader.u16() & 0xF;
+            location.data_reference_index_ = reader.u16();
+            location.base_offset_ = reader.uint(base_offset_size);
+
+            const auto extent_count = reader.u16();
+            for (uint16_t j = 0; j < extent_count && reader.ok(); ++j) {
+                reader.skip(index_size);
+                auto& extent = location.extents_.emplace_back();
+                extent.offset_ = reader.uint(offset_size);
+                extent.length_ = reader.uint(length_size);
+            }
+            meta.locations_[id] = std::move(location);
+        }
+        return reader.ok();
+    }
+
+    bool parse_iref(ByteReader reader, MetaBox& meta) {
+        const auto header = ::read_full_box_header(reader);
+        const auto id_size = header.version_ == 0 ? 2 : 4;
+
+        while (auto box = ::next_box(reader)) {
+            if (box->type_ != "cdsc")
+                continue;
+
+            auto& body = box->body_;
+            const auto from = static_cast<uint32_t>(body.uint(id_size));
+            const auto count = body.u16();
+            auto& targets = meta.describes_[from];
+            for (uint16_t i = 0; i < count && body.ok(); ++i)
+                targets.push_back(static_cast<uint32_t>(body.uint(id_size)));
+            if (!body.ok())
+                return false;
+        }
+        return reader.ok();
+    }
+
+    bool parse_iprp(ByteReader reader, MetaBox& meta) {
+        while (auto box = ::next_box(reader)) {
+            auto& body = box->body_;
+            if (box->type_ == "ipco") {
+                while (auto property = ::next_box(body)) {
+                    auto& entry = meta.properties_.emplace_back();
+                    if (property->type_ != "ispe")
+                        continue;
+
+                    auto& ispe = property->body_;
+                    ::read_full_box_header(ispe);
+                    const auto width = ispe.u32();
+                    const auto height = ispe.u32();
+                    if (!ispe.ok())
+                        return false;
+                    entry.emplace(width, height);
+                }
+            } else if (box->type_ == "ipma") {
+                const auto header = ::read_full_box_header(body);
+                const auto entry_count = body.u32();
+                for (uint32_t i = 0; i < entry_count && body.ok(); ++i) {
+                    const auto id = header.version_ < 1 ? body.u16()
+                                                        : body.u32();
+                    const auto count = body.u8();
+                    auto& indices = meta.associations_[id];
+                    for (uint8_t j = 0; j < count && body.ok(); ++j) {
+                        // The top bit marks the property as essential
+                        if (header.flags_ & 1)
+                            indices.push_back(body.u16() & 0x7FFF);
+                        else
+                            indices.push_back(body.u8() & 0x7F);
+                    }
+                }
+                if (!body.ok())
+                    return false;
+            }
+        }
+        return reader.ok();
+    }
+
+    std::optional<MetaBox> parse_meta(ByteReader reader) {
+        ::read_full_box_header(reader);
+
+        MetaBox meta;
+        while (auto box = ::next_box(reader)) {
+            const auto& type = box->type_;
+            auto& body = box->body_;
+
+            bool ok = true;
+            if (type == "hdlr") {
+                ::read_full_box_header(body);
+                body.skip(4);  // pre_defined
+                ok = body.fourcc() == "pict";
+            } else if (type == "pitm") {
+                const auto header = ::read_full_box_header(body);
+                meta.primary_item_ = header.version_ == 0 ? body.u16()
+                                                          : body.u32();
+                ok = body.ok();
+            } else if (type == "iinf") {
+                ok = ::parse_iinf(body, meta);
+            } else if (type == "iloc") {
+                ok = ::parse_iloc(body, meta);
+            } else if (type == "iref") {
+                ok = ::parse_iref(body, meta);
+            } else if (type == "iprp") {
+                ok = ::parse_iprp(body, meta);
+            } else if (type == "idat") {
+                meta.idat_ = body;
+                meta.has_idat_ = true;
+            }
+
+            if (!ok)
+                return std::nullopt;
+        }
+
+        if (!reader.ok() || !meta.primary_item_)
+            return std::nullopt;
+        return meta;
+    }
+
+    // Size from the `ispe` associated with the primary item
+    std::optional<std::pair<uint32_t, uint32_t>> find_primary_size(
+        const MetaBox& meta
+    ) {
+        const auto found = meta.associations_.find(*meta.primary_item_);
+        if (found == meta.associations_.end())
+            return std::nullopt;
+
+        for (const auto index : found->second) {
+            if (index == 0 || index > meta.properties_.size())
+                continue;
+            if (const auto& size = meta.properties_[index - 1])
+                return size;
+        }
+        return std::nullopt;
+    }
+
+    // The XMP item libavif would pick: the first one described as
+    // belonging to the primary item
+    std::optional<uint32_t> find_primary_xmp(const MetaBox& meta) {
+        for (const auto id : meta.xmp_items_) {
+            const auto found = meta.describes_.find(id);
+            if (found == meta.describes_.end())
+                continue;
+            const auto& targets = found->second;
+            const auto primary = *meta.primary_item_;
+            if (std::find(targets.begin(), targets.end(), primary) !=
+                targets.end())
+                return id;
+        }
+        return std::nullopt;
+    }
+
+    bool read_item(
+        const sung::RandomAccessFile& file,
+        const MetaBox& meta,
+        const uint32_t id,
+        std::vector<uint8_t>& output
+    ) {
+        const auto found = meta.locations_.find(id);
+        if (found == meta.locations_.end())
+            return false;
+
+        const auto& location = found->second;
+        // Data in other files, or assembled from other items
+        if (location.data_reference_index_ != 0 ||
+            location.construction_method_ > 1)
+            return false;
+
+        const bool from_idat = location.construction_method_ == 1;
+        if (from_idat && !meta.has_idat_)
+            return false;
+        const auto source_size = from_idat ? meta.idat_.remaining()
+                                           : file.size();
+
+        output.clear();
+        for (const auto& extent : location.extents_) {
+            const auto offset = location.base_offset_ + extent.offset_;
+            if (offset > source_size)
+                return false;
+            // Zero means the rest of the source
+            const auto length = extent.length_ != 0 ? extent.length_
+                                                    : source_size - offset;
+            if (length > source_size - offset ||
+                output.size() + length > MAX_XMP_BYTES)
+                return false;
+
+            const auto used = output.size();
+            output.resize(used + static_cast<size_t>(length));
+            if (from_idat) {
+                std::memcpy(
+                    output.data() + used,
+                    meta.idat_.here() + offset,
+                    static_cast<size_t>(length)
+                );
+                continue;
+            }
+
+            const auto read = file.read_at(
+                offset, output.data() + used, static_cast<size_t>(length)
+            );
+            if (!read || *read != length)
+                return false;
+        }
+        return true;
+    }
+
+}  // namespace
+
+
+namespace sung::detail {
+
+    std::optional<AvifMeta> read_avif_boxes(const RandomAccessFile& file) {
+        std::vector<uint8_t> head(
+            static_cast<size_t>(std::min<uint64_t>(HEAD_BYTES, file.size()))
+        );
+        const auto head_read = file.read_at(0, head.data(), head.size());
+        if (!head_read || *head_read != head.size())
+            return std::nullopt;
+
+        // Serves a range from the head when it is there
+        std::vector<uint8_t> range;
+        const auto read_range = [&](const uint64_t offset, const size_t size) {
+            if (offset + size <= head.size()) {
+                range.assign(
+                    head.begin() + static_cast<ptrdiff_t>(offset),
+                    head.begin() + static_cast<ptrdiff_t>(offset + size)
+                );
+                return true;
+            }
+            range.resize(size);
+            const auto read = file.read_at(offset, range.data(), size);
+            return read && *read == size;
+        };
+
+        uint64_t offset = 0;
+        for (int i = 0; i < MAX_TOP_LEVEL_BOXES && offset < file.size(); ++i) {
+            const auto header_size = std::min<uint64_t>(
+                16, file.size() - offset
+            );
+            if (!read_range(offset, static_cast<size_t>(header_size)))
+                return std::nullopt;
+
+            ByteReader header{ range.data(), range.size() };
+            uint64_t size = header.u32();
+            const auto type = std::string(header.fourcc());
+            if (size == 1)
+                size = header.u64();
+            else if (size == 0)
+                size = file.size() - offset;
+            if (!header.ok() || size < 8 || size > file.size() - offset)
+                return std::nullopt;
+            if (i == 0 && type != "ftyp")
+                return std::nullopt;
+
+            if (type != "meta") {
+                offset += size;
+                continue;
+            }
+
+            const auto body_offset = header_size - header.remaining();
+            if (size > MAX_META_BYTES ||
+                !read_range(offset + body_offset, size - body_offset))
+                return std::nullopt;
+
+            const auto meta = ::parse_meta(
+                ByteReader{ range.data(), range.size() }
+            );
+            if (!meta)
+                return std::nullopt;
+
+            const auto primary_size = ::find_primary_size(*meta);
+            if (!primary_size)
+                return std::nullopt;
+
+            AvifMeta output;
+            output.width_ = primary_size->first;
+            output.height_ = primary_size->second;
+            if (const auto xmp_item = ::find_primary_xmp(*meta)) {
+                if (!::read_item(file, *meta, *xmp_item, output.xmp_data_))
+                    return std::nullopt;
+            }
+            return output;
+        }
+
+        return std::nullopt;
+    }
+
+}  // namespace sung::detail
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <optional>
+
+#include "sung/auxiliary/filesys.hpp"
+#include "sung/image/avif.hpp"
+
+
+namespace sung::detail {
+
+    // Reads the primary image size and the XMP item of an AVIF straight from
+    // its ISOBMFF boxes: the `meta` box, then only the XMP extents. Returns
+    // nothing for layouts it does not handle, such as items built from other
+    // items or an `ispe` missing on the primary item; use libavif then.
+    std::optional<AvifMeta> read_avif_boxes(const RandomAccessFile& file);
+
+}  // namespace sung::detail
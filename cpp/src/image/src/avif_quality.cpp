@@ -0,0 +1,273 @@
+#include "sung/image/avif_quality.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <vector>
+
+
+namespace {
+
+    // Longest edge of the trial image. Big enough to keep line art and
+    // gradients representative, small enough for a trial to take a few ms.
+    constexpr uint32_t TRIAL_MAX_EDGE = 512;
+    // Trials only need a relative answer, so they use a fast preset
+    constexpr int TRIAL_MIN_SPEED = 8;
+    constexpr uint32_t SSIM_WINDOW = 8;
+
+
+    struct LumaPlane {
+        std::vector<uint8_t> pixels_;
+        uint32_t width_ = 0;
+        uint32_t height_ = 0;
+    };
+
+    // Box-filters the Y plane down so its longer edge fits TRIAL_MAX_EDGE
+    LumaPlane downscale_luma(const avifImage& image) {
+        const auto longest = std::max(image.width, image.height);
+        const auto factor = std::max<uint32_t>(
+            1, (longest + TRIAL_MAX_EDGE - 1) / TRIAL_MAX_EDGE
+        );
+
+        LumaPlane output;
+        output.width_ = std::max<uint32_t>(1, image.width / factor);
+        output.height_ = std::max<uint32_t>(1, image.height / factor);
+        output.pixels_.resize(
+            static_cast<size_t>(output.width_) * output.height_
+        );
+
+        const auto src = image.yuvPlanes[AVIF_CHAN_Y];
+        const auto src_row_bytes = image.yuvRowBytes[AVIF_CHAN_Y];
+        for (uint32_t y = 0; y < output.height_; ++y) {
+            for (uint32_t x = 0; x < output.width_; ++x) {
+                uint32_t sum = 0;
+                uint32_t count = 0;
+                for (uint32_t dy = 0; dy < factor; ++dy) {
+                    const auto sy = y * factor + dy;
+                    if (sy >= image.height)
+                        break;
+                    const auto row = src + static_cast<size_t>(sy) *
+                                               src_row_bytes;
+                    for (uint32_t dx = 0; dx < factor; ++dx) {
+                        const auto sx = x * factor + dx;
+                        if (sx >= image.width)
+                            break;
+                        sum += row[sx];
+                        ++count;
+                    }
+                }
+                output.pixels_[static_cast<size_t>(y) * output.width_ + x] =
+                    static_cast<uint8_t>((sum + count / 2) / count);
+            }
+        }
+
+        return output;
+    }
+
+    // Encodes the plane as monochrome AVIF at `quantizer`, decodes it back
+    // and scores the round trip.
+    std::expected<double, std::string> run_trial(
+        const LumaPlane& plane, const int quantizer, const int speed
+    ) {
+        const auto image = avifImageCreate(
+            plane.width_, plane.height_, 8, AVIF_PIXEL_FORMAT_YUV400
+        );
+        if (!image)
+            return std::unexpected("avifImageCreate failed");
+
+        auto res = avifImageAllocatePlanes(image, AVIF_PLANES_YUV);
+        if (res != AVIF_RESULT_OK) {
+            avifImageDestroy(image);
+            return std::unexpected(avifResultToString(res));
+        }
+        for (uint32_t y = 0; y < plane.height_; ++y) {
+            std::copy_n(
+                plane.pixels_.data() + static_cast<size_t>(y) * plane.width_,
+                plane.width_,
+                image->yuvPlanes[AVIF_CHAN_Y] +
+                    static_cast<size_t>(y) * image->yuvRowBytes[AVIF_CHAN_Y]
+            );
+        }
+
+        const auto enc = avifEncoderCreate();
+        if (!enc) {
+            avifImageDestroy(image);
+            return std::unexpected("avifEncoderCreate failed");
+        }
+        enc->minQuantizer = quantizer;
+        enc->maxQuantizer = quantizer;
+        enc->speed = speed;
+
+        avifRWData encoded = AVIF_DATA_EMPTY;
+        res = avifEncoderWrite(enc, image, &encoded);
+        avifEncoderDestroy(enc);
+        if (res != AVIF_RESULT_OK) {
+            avifRWDataFree(&encoded);
+            avifImageDestroy(image);
+            return std::unexpected(avifResultToString(res));
+        }
+
+        const auto decoded = avifImageCreateEmpty();
+        const auto dec = avifDecoderCreate();
+        if (!decoded || !dec) {
+            if (dec)
+                avifDecoderDestroy(dec);
+            if (decoded)
+                avifImageDestroy(decoded);
+            avifRWDataFree(&encoded);
+            avifImageDestroy(image);
+            return std::unexpected("avifDecoderCreate failed");
+        }
+
+        res = avifDecoderReadMemory(dec, decoded, encoded.data, encoded.size);
+        std::expected<double, std::string> output;
+        if (res != AVIF_RESULT_OK) {
+            output = std::unexpected(avifResultToString(res));
+        } else if (decoded->width != image->width ||
+                   decoded->height != image->height ||
+                   decoded->depth != 8) {
+            output = std::unexpected("trial decode changed the image layout");
+        } else {
+            output = sung::calc_plane_ssim(
+                image->yuvPlanes[AVIF_CHAN_Y],
+                image->yuvRowBytes[AVIF_CHAN_Y],
+                decoded->yuvPlanes[AVIF_CHAN_Y],
+                decoded->yuvRowBytes[AVIF_CHAN_Y],
+                image->width,
+                image->height
+            );
+        }
+
+        avifDecoderDestroy(dec);
+        avifImageDestroy(decoded);
+        avifRWDataFree(&encoded);
+        avifImageDestroy(image);
+        return output;
+    }
+
+}  // namespace
+
+
+namespace sung {
+
+    double calc_plane_ssim(
+        const uint8_t* a,
+        const size_t a_row_bytes,
+        const uint8_t* b,
+        const size_t b_row_bytes,
+        const uint32_t width,
+        const uint32_t height
+    ) {
+        constexpr double c1 = (0.01 * 255) * (0.01 * 255);
+        constexpr double c2 = (0.03 * 255) * (0.03 * 255);
+
+        // Planes smaller than one window are scored as a single window
+        const auto win_w = std::min(SSIM_WINDOW, width);
+        const auto win_h = std::min(SSIM_WINDOW, height);
+        if (win_w == 0 || win_h == 0)
+            return 1;
+
+        double total = 0;
+        size_t windows = 0;
+        for (uint32_t y0 = 0; y0 + win_h <= height; y0 += win_h) {
+            for (uint32_t x0 = 0; x0 + win_w <= width; x0 += win_w) {
+                double sum_a = 0, sum_b = 0;
+                double sum_aa = 0, sum_bb = 0, sum_ab = 0;
+                for (uint32_t y = y0; y < y0 + win_h; ++y) {
+                    const auto row_a = a + static_cast<size_t>(y) * a_row_bytes;
+                    const auto row_b = b + static_cast<size_t>(y) * b_row_bytes;
+                    for (uint32_t x = x0; x < x0 + win_w; ++x) {
+                        const double va = row_a[x];
+                        const double vb = row_b[x];
+                        sum_a += va;
+                        sum_b += vb;
+                        sum_aa += va * va;
+                        sum_bb += vb * vb;
+                        sum_ab += va * vb;
+                    }
+                }
+
+                const double n = double(win_w) * double(win_h);
+                const double mean_a = sum_a / n;
+                const double mean_b = sum_b / n;
+                const double var_a = sum_aa / n - mean_a * mean_a;
+                const double var_b = sum_bb / n - mean_b * mean_b;
+                const double cov = sum_ab / n - mean_a * mean_b;
+
+                total += ((2 * mean_a * mean_b + c1) * (2 * cov + c2)) /
+                         ((mean_a * mean_a + mean_b * mean_b + c1) *
+                          (var_a + var_b + c2));
+                ++windows;
+            }
+        }
+
+        return total / static_cast<double>(windows);
+    }
+
+    std::expected<int, std::string> search_avif_quantizer(
+        const avifImage& image,
+        const AvifEncodeParams& params,
+        const double target_ssim
+    ) {
+        if (image.depth != 8 || !image.yuvPlanes[AVIF_CHAN_Y])
+            return std::unexpected("quality search needs an 8-bit YUV image");
+
+        const auto plane = ::downscale_luma(image);
+        const auto speed = std::max(params.speed(), TRIAL_MIN_SPEED);
+
+        // SSIM falls as the quantizer rises, so keep the largest passing one
+        std::optional<int> best;
+        int low = 0;
+        int high = 63;
+        while (low <= high) {
+            const auto mid = (low + high) / 2;
+            const auto score = ::run_trial(plane, mid, speed);
+            if (!score)
+                return std::unexpected(score.error());
+
+            if (*score >= target_ssim) {
+                best = mid;
+                low = mid + 1;
+            } else {
+                high = mid - 1;
+            }
+        }
+
+        // Quantizer 0 would encode near-lossless, larger than the source
+        if (!best) {
+            return std::unexpected(
+                std::format("no quantizer reaches SSIM {}", target_ssim)
+            );
+        }
+        return *best;
+    }
+
+}  // namespace sung
+
+
+// AvifQuantizerCache
+namespace sung {
+
+    int AvifQuantizerCache::resolution_bucket(
+        const uint32_t width, const uint32_t height
+    ) {
+        const auto pixels = static_cast<double>(width) * height;
+        if (pixels < 1)
+            return 0;
+        return static_cast<int>(std::lround(std::log2(pixels)));
+    }
+
+    std::optional<int> AvifQuantizerCache::find(const Key& key) const {
+        std::lock_guard lock(mut_);
+        const auto it = entries_.find(key);
+        if (it == entries_.end())
+            return std::nullopt;
+        return it->second;
+    }
+
+    void AvifQuantizerCache::store(const Key& key, const int quantizer) {
+        std::lock_guard lock(mut_);
+        entries_[key] = quantizer;
+    }
+
+}  // namespace sung
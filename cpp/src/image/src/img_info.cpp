@@ -1,44 +1,53 @@
 #include "sung/image/img_info.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
 #include "sung/auxiliary/filesys.hpp"
+#include "sung/image/png_chunks.hpp"
 
 
 namespace {
 
-    bool parse_comfyui_workflow(
-        sung::WorkflowData& out,
-        const sung::Path& file_path,
-        const refimg::SimpleImageInfo& simple
-    ) {
-        if (simple.is_png()) {
-            const auto exp_meta = sung::read_png_metadata_only(file_path);
-            if (!exp_meta)
-                return false;
-            const auto& meta = *exp_meta;
+    constexpr std::array<std::string_view, 1> WORKFLOW_KEYS{ "workflow" };
 
-            if (auto wf = meta.find_text_chunk("workflow")) {
-                out = sung::parse_comfyui_workflow(wf->data(), wf->size());
-                return true;
-            }
-        } else if (simple.is_avif()) {
-            const auto file_content = sung::read_file(file_path);
-            if (file_content.empty())
-                return false;
+    // Covers a PNG signature or an ISOBMFF `ftyp` box with a few brands
+    constexpr size_t SNIFF_BYTES = 64;
 
-            const auto avif_meta = sung::read_avif_metadata_only(
-                file_content.data(), file_content.size()
-            );
-            const auto workflow = avif_meta.find_workflow_data();
-            if (workflow.empty())
-                return false;
+    uint32_t read_be32(const uint8_t* p) {
+        return (static_cast<uint32_t>(p[0]) << 24) |
+               (static_cast<uint32_t>(p[1]) << 16) |
+               (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+    }
 
-            out = sung::parse_comfyui_workflow(
-                workflow.data(), workflow.size()
-            );
-            return true;
+    sung::ImageInfo::Format sniff_format(
+        const uint8_t* data, const size_t size
+    ) {
+        using Format = sung::ImageInfo::Format;
+
+        constexpr uint8_t png_signature[8] = { 137, 80, 78, 71,
+                                               13,  10, 26, 10 };
+        if (size >= 8 && 0 == std::memcmp(data, png_signature, 8))
+            return Format::png;
+
+        // Box size, "ftyp", major brand, minor version, compatible brands
+        if (size >= 16 && 0 == std::memcmp(data + 4, "ftyp", 4)) {
+            const auto box_end = std::min<size_t>(::read_be32(data), size);
+            for (size_t i = 8; i + 4 <= box_end; i += 4) {
+                if (i == 12)
+                    continue;
+                const std::string_view brand(
+                    reinterpret_cast<const char*>(data + i), 4
+                );
+                if (brand == "avif" || brand == "avis")
+                    return Format::avif;
+            }
         }
 
-        return false;
+        return Format::other;
     }
 
 }  // namespace
@@ -50,9 +59,8 @@ namespace sung {
     void ImageInfo::ComfyUiInfo::set_workflow(
         const uint8_t* data, size_t size
     ) {
-        workflow_ = sung::parse_comfyui_workflow(data, size);
-        nodes_ = workflow_.get_nodes();
-        links_ = workflow_.get_links();
+        auto summary = sung::summarize_comfyui_workflow(data, size);
+        summary_ = summary ? std::move(*summary) : WorkflowSummary{};
         workflow_src_.assign(reinterpret_cast<const char*>(data), size);
     }
 
@@ -65,7 +73,71 @@ namespace sung {
     ImageInfo::ImageInfo(const sung::Path& file_path) : file_path_(file_path) {}
 
     bool ImageInfo::load_simple_info() {
-        return get_simple_img_info(file_path_, simple_);
+        if (!get_simple_img_info(file_path_, simple_))
+            return false;
+
+        width_ = simple_.width_;
+        height_ = simple_.height_;
+        if (simple_.is_png())
+            format_ = Format::png;
+        else if (simple_.is_avif())
+            format_ = Format::avif;
+        else
+            format_ = Format::other;
+        return true;
+    }
+
+    bool ImageInfo::load_info_and_metadata() {
+        RandomAccessFile file;
+        if (file.open(file_path_))
+            return false;
+
+        std::array<uint8_t, ::SNIFF_BYTES> head{};
+        const auto head_size = file.read_at(0, head.data(), head.size());
+        if (!head_size)
+            return false;
+
+        switch (::sniff_format(head.data(), *head_size)) {
+            case Format::png: {
+                const auto chunks = read_png_chunks(file, ::WORKFLOW_KEYS);
+                if (!chunks)
+                    break;
+
+                width_ = chunks->width_;
+                height_ = chunks->height_;
+                format_ = Format::png;
+                if (const auto wf = chunks->find_text("workflow")) {
+                    comfyui_ = ComfyUiInfo{};
+                    comfyui_->set_workflow(
+                        reinterpret_cast<const uint8_t*>(wf->data()),
+                        wf->size()
+                    );
+                }
+                return true;
+            }
+            case Format::avif: {
+                const auto meta = read_avif_metadata_only(file);
+                if (!meta)
+                    break;
+
+                width_ = meta->width_;
+                height_ = meta->height_;
+                format_ = Format::avif;
+                const auto wf = meta->find_workflow_data();
+                if (!wf.empty()) {
+                    comfyui_ = ComfyUiInfo{};
+                    comfyui_->set_workflow(wf.data(), wf.size());
+                }
+                return true;
+            }
+            default:
+                break;
+        }
+
+        // Formats without a workflow, or files the fast paths could not
+        // make sense of
+        file.close();
+        return this->load_simple_info();
     }
 
     bool ImageInfo::load_img_metadata() {
@@ -78,14 +150,14 @@ namespace sung {
             png_->metadata_ = exp_meta.value();
             return true;
         } else if (simple_.is_avif()) {
-            const auto file_content = sung::read_file(file_path_);
-            if (file_content.empty())
+            RandomAccessFile file;
+            if (file.open(file_path_))
                 return false;
 
             avif_ = AvifInfo{};
-            avif_->metadata_ = sung::read_avif_metadata_only(
-                file_content.data(), file_content.size()
-            );
+            auto meta = sung::read_avif_metadata_only(file);
+            if (meta)
+                avif_->metadata_ = std::move(*meta);
             return true;
         }
 
@@ -115,9 +187,7 @@ namespace sung {
         if (!comfyui_)
             return false;
 
-        sd_.model_name_ = sung::find_model(
-            comfyui_->nodes(), comfyui_->links()
-        );
+        sd_.model_name_ = comfyui_->summary().model_;
         return true;
     }
 
@@ -125,7 +195,7 @@ namespace sung {
         if (!comfyui_)
             return false;
 
-        sd_.prompt_ = sung::find_prompt(comfyui_->nodes(), comfyui_->links());
+        sd_.prompt_ = comfyui_->summary().prompts_;
         return true;
     }
 
@@ -1,5 +1,6 @@
 #include "sung/image/png.hpp"
 
+#include <algorithm>
 #include <cstring>
 #include <format>
 #include <fstream>
@@ -106,6 +107,117 @@ namespace {
         }
 
         sung::ErrStr parse_pixels(sung::PngData& out) {
+            const auto exp_transforms = this->set_rgba8_transforms(out);
+            if (!exp_transforms)
+                return exp_transforms;
+
+            err_ctx_.msg_.clear();
+            if (setjmp(png_jmpbuf(png_ptr_))) {
+                return std::unexpected(
+                    std::format("Failed to read PNG pixels: {}", err_ctx_.msg_)
+                );
+            }
+
+            out.pixels.resize(
+                static_cast<size_t>(out.width) *
+                static_cast<size_t>(out.height) * 4
+            );
+
+            // Row pointers for libpng
+            rows_.resize(out.height);
+            for (png_uint_32 y = 0; y < out.height; ++y) {
+                rows_[y] = reinterpret_cast<png_bytep>(
+                    out.pixels.data() + (static_cast<size_t>(y) * out.width * 4)
+                );
+            }
+
+            png_read_image(png_ptr_, rows_.data());
+            png_read_end(png_ptr_, nullptr);
+            return {};
+        }
+
+        // Only valid for non-interlaced images, whose rows come out final in
+        // a single pass.
+        sung::ErrStr parse_strips(
+            sung::PngMeta& out,
+            const int strip_rows,
+            const sung::PngHeaderFn& on_header,
+            const sung::PngStripFn& on_strip
+        ) {
+            const auto exp_transforms = this->set_rgba8_transforms(out);
+            if (!exp_transforms)
+                return exp_transforms;
+
+            const auto exp_header = on_header(out);
+            if (!exp_header)
+                return exp_header;
+
+            const auto row_bytes = static_cast<size_t>(out.width) * 4;
+            const auto max_rows = std::clamp(strip_rows, 1, out.height);
+            strip_.resize(row_bytes * static_cast<size_t>(max_rows));
+            rows_.resize(max_rows);
+            for (int y = 0; y < max_rows; ++y) {
+                rows_[y] = reinterpret_cast<png_bytep>(
+                    strip_.data() + static_cast<size_t>(y) * row_bytes
+                );
+            }
+
+            err_ctx_.msg_.clear();
+            if (setjmp(png_jmpbuf(png_ptr_))) {
+                return std::unexpected(
+                    std::format("Failed to read PNG pixels: {}", err_ctx_.msg_)
+                );
+            }
+
+            // Nothing with a destructor may be alive across png_read_rows,
+            // since a libpng error longjmps straight back to the setjmp above.
+            for (int first = 0; first < out.height; first += max_rows) {
+                const auto count = std::min(max_rows, out.height - first);
+                png_read_rows(
+                    png_ptr_,
+                    rows_.data(),
+                    nullptr,
+                    static_cast<png_uint_32>(count)
+                );
+
+                const auto exp_strip = on_strip(strip_.data(), first, count);
+                if (!exp_strip)
+                    return exp_strip;
+            }
+
+            png_read_end(png_ptr_, nullptr);
+            return {};
+        }
+
+        bool is_interlaced() const {
+            return png_get_interlace_type(png_ptr_, info_ptr_) !=
+                   PNG_INTERLACE_NONE;
+        }
+
+        bool is_open() const {
+            return png_ptr_ != nullptr && info_ptr_ != nullptr && open_success_;
+        }
+
+        void destroy() {
+            open_success_ = false;
+
+            if (png_ptr_ || info_ptr_) {
+                png_destroy_read_struct(&png_ptr_, &info_ptr_, nullptr);
+                png_ptr_ = nullptr;
+                info_ptr_ = nullptr;
+            }
+            io_.stream = nullptr;
+            if (file_.is_open())
+                file_.close();
+
+            std::vector<png_bytep>().swap(rows_);
+            std::vector<uint8_t>().swap(strip_);
+        }
+
+    private:
+        // Normalizes whatever the file stores to 8-bit RGBA and updates `out`
+        // to describe the converted rows.
+        sung::ErrStr set_rgba8_transforms(sung::PngMeta& out) {
             if (!this->is_open())
                 return std::unexpected("PNG not opened");
 
@@ -175,44 +287,9 @@ namespace {
                 );
             }
 
-            out.pixels.resize(
-                static_cast<size_t>(out.width) *
-                static_cast<size_t>(out.height) * 4
-            );
-
-            // Row pointers for libpng
-            rows_.resize(out.height);
-            for (png_uint_32 y = 0; y < out.height; ++y) {
-                rows_[y] = reinterpret_cast<png_bytep>(
-                    out.pixels.data() + (static_cast<size_t>(y) * out.width * 4)
-                );
-            }
-
-            png_read_image(png_ptr_, rows_.data());
-            png_read_end(png_ptr_, nullptr);
             return {};
         }
 
-        bool is_open() const {
-            return png_ptr_ != nullptr && info_ptr_ != nullptr && open_success_;
-        }
-
-        void destroy() {
-            open_success_ = false;
-
-            if (png_ptr_ || info_ptr_) {
-                png_destroy_read_struct(&png_ptr_, &info_ptr_, nullptr);
-                png_ptr_ = nullptr;
-                info_ptr_ = nullptr;
-            }
-            io_.stream = nullptr;
-            if (file_.is_open())
-                file_.close();
-
-            std::vector<png_bytep>().swap(rows_);
-        }
-
-    private:
         struct PngIStream {
             std::ifstream* stream;
         };
@@ -251,6 +328,7 @@ namespace {
 
         std::ifstream file_;
         std::vector<png_bytep> rows_;
+        std::vector<uint8_t> strip_;
         PngErrorCtx err_ctx_;
         PngIStream io_{ nullptr };
         png_structp png_ptr_ = nullptr;
@@ -306,4 +384,57 @@ namespace sung {
         return png_data;
     }
 
+    std::expected<PngMeta, std::string> read_png_strips(
+        const Path& path,
+        const int strip_rows,
+        const PngHeaderFn& on_header,
+        const PngStripFn& on_strip
+    ) {
+        ::PngReader reader;
+
+        const auto exp_open = reader.open(path);
+        if (!exp_open)
+            return std::unexpected(exp_open.error());
+
+        PngMeta meta;
+        const auto exp_metadata = reader.get_metadata(meta);
+        if (!exp_metadata)
+            return std::unexpected(exp_metadata.error());
+
+        if (!reader.is_interlaced()) {
+            const auto exp_strips = reader.parse_strips(
+                meta, strip_rows, on_header, on_strip
+            );
+            if (!exp_strips)
+                return std::unexpected(exp_strips.error());
+            return meta;
+        }
+
+        PngData frame;
+        const auto exp_parse_pixels = reader.parse_pixels(frame);
+        if (!exp_parse_pixels)
+            return std::unexpected(exp_parse_pixels.error());
+        meta.bit_depth = frame.bit_depth;
+        meta.color_type = frame.color_type;
+
+        const auto exp_header = on_header(meta);
+        if (!exp_header)
+            return std::unexpected(exp_header.error());
+
+        const auto row_bytes = static_cast<size_t>(frame.width) * 4;
+        const auto max_rows = std::max(strip_rows, 1);
+        for (int first = 0; first < frame.height; first += max_rows) {
+            const auto count = std::min(max_rows, frame.height - first);
+            const auto exp_strip = on_strip(
+                frame.pixels.data() + static_cast<size_t>(first) * row_bytes,
+                first,
+                count
+            );
+            if (!exp_strip)
+                return std::unexpected(exp_strip.error());
+        }
+
+        return meta;
+    }
+
 }  // namespace sung
@@ -0,0 +1,343 @@
+#include "sung/image/png_chunks.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <utility>
+
+#include <zlib.h>
+
+
+namespace {
+
+    constexpr uint8_t PNG_SIGNATURE[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    // Keywords are 1 to 79 bytes followed by a NUL
+    constexpr size_t MAX_KEY_BYTES = 80;
+    // The spec caps chunk lengths at 2^31 - 1
+    constexpr uint32_t MAX_CHUNK_LENGTH = 0x7FFFFFFF;
+    // Refuses zTXt/iTXt payloads that inflate past this
+    constexpr size_t MAX_INFLATED_TEXT = 64 << 20;
+    // Enough for the signature, IHDR and the text chunks of a typical
+    // ComfyUI output in a single read
+    constexpr size_t FILE_WINDOW_BYTES = 64 << 10;
+
+    uint32_t read_be32(const uint8_t* p) {
+        return (static_cast<uint32_t>(p[0]) << 24) |
+               (static_cast<uint32_t>(p[1]) << 16) |
+               (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+    }
+
+    // `chunk` points at the type field, followed by the data and the CRC
+    bool check_crc(const uint8_t* chunk, const uint32_t length) {
+        auto crc = crc32(0, chunk, 4 + length);
+        return crc == ::read_be32(chunk + 4 + length);
+    }
+
+    std::optional<std::vector<char>> inflate_text(
+        const uint8_t* data, const size_t size
+    ) {
+        z_stream stream{};
+        if (inflateInit(&stream) != Z_OK)
+            return std::nullopt;
+
+        std::vector<char> output;
+        stream.next_in = const_cast<Bytef*>(data);
+        stream.avail_in = static_cast<uInt>(size);
+
+        int result = Z_OK;
+        while (result == Z_OK) {
+            const auto used = output.size();
+            const auto grow = std::max<size_t>(size * 2, 4096);
+            if (used + grow > MAX_INFLATED_TEXT)
+                break;
+            output.resize(used + grow);
+
+            stream.next_out = reinterpret_cast<Bytef*>(output.data() + used);
+            stream.avail_out = static_cast<uInt>(grow);
+            result = inflate(&stream, Z_NO_FLUSH);
+            output.resize(used + grow - stream.avail_out);
+        }
+        inflateEnd(&stream);
+
+        if (result != Z_STREAM_END)
+            return std::nullopt;
+        return output;
+    }
+
+    std::string_view find_key(const char* data, const size_t size) {
+        const auto end = std::min(size, MAX_KEY_BYTES);
+        const auto nul = static_cast<const char*>(std::memchr(data, 0, end));
+        if (!nul || nul == data)
+            return {};
+        return std::string_view(data, nul);
+    }
+
+    bool is_wanted(const std::string_view key, const sung::PngTextKeys keys) {
+        if (keys.empty())
+            return true;
+        return std::find(keys.begin(), keys.end(), key) != keys.end();
+    }
+
+    // Decodes one tEXt, zTXt or iTXt chunk whose data stays alive as long as
+    // `meta`. Malformed chunks are dropped.
+    void add_text_chunk(
+        sung::PngChunkMeta& meta,
+        const std::string_view type,
+        const char* data,
+        const size_t size
+    ) {
+        const auto key = ::find_key(data, size);
+        if (key.empty())
+            return;
+
+        const auto rest = std::string_view(data, size).substr(key.size() + 1);
+        if (type == "tEXt") {
+            meta.text_.push_back({ key, rest });
+            return;
+        }
+
+        bool compressed = false;
+        std::string_view text;
+        if (type == "zTXt") {
+            // Compression method 0 is the only one defined
+            if (rest.empty() || rest[0] != 0)
+                return;
+            compressed = true;
+            text = rest.substr(1);
+        } else {
+            // Compression flag and method, then language tag and translated
+            // keyword, both NUL terminated
+            if (rest.size() < 2 || (rest[0] != 0 && rest[1] != 0))
+                return;
+            compressed = rest[0] != 0;
+            const auto language_end = rest.find('\0', 2);
+            if (language_end == std::string_view::npos)
+                return;
+            const auto translated_end = rest.find('\0', language_end + 1);
+            if (translated_end == std::string_view::npos)
+                return;
+            text = rest.substr(translated_end + 1);
+        }
+
+        if (!compressed) {
+            meta.text_.push_back({ key, text });
+            return;
+        }
+
+        auto inflated = ::inflate_text(
+            reinterpret_cast<const uint8_t*>(text.data()), text.size()
+        );
+        if (!inflated)
+            return;
+        const auto& stored = meta.storage_.emplace_back(std::move(*inflated));
+        meta.text_.push_back(
+            { key, std::string_view(stored.data(), stored.size()) }
+        );
+    }
+
+    class MemorySource {
+
+    public:
+        MemorySource(const uint8_t* data, size_t size)
+            : data_(data), size_(size) {}
+
+        std::expected<const uint8_t*, std::string> fetch(
+            const uint64_t offset, const size_t size
+        ) {
+            if (offset > size_ || size > size_ - offset)
+                return std::unexpected("Truncated PNG file");
+            return data_ + offset;
+        }
+
+        // The caller's buffer outlives the result, so nothing is copied
+        const char* keep(const uint8_t* data, size_t, sung::PngChunkMeta&) {
+            return reinterpret_cast<const char*>(data);
+        }
+
+    private:
+        const uint8_t* data_;
+        size_t size_;
+    };
+
+    // Serves reads from a window that is refilled with one positioned read
+    // when a request falls outside it. A window that text was kept from is
+    // handed over to the result whole instead of copying the chunks out.
+    class FileSource {
+
+    public:
+        explicit FileSource(const sung::RandomAccessFile& file) : file_(file) {}
+
+        std::expected<const uint8_t*, std::string> fetch(
+            const uint64_t offset, const size_t size
+        ) {
+            if (offset >= window_start_ &&
+                offset + size <= window_start_ + window_size_)
+                return window_ + (offset - window_start_);
+
+            const auto file_size = file_.size();
+            if (offset > file_size || size > file_size - offset)
+                return std::unexpected("Truncated PNG file");
+
+            const auto wanted = std::min<uint64_t>(
+                std::max(size, FILE_WINDOW_BYTES), file_size - offset
+            );
+            buffer_.resize(static_cast<size_t>(wanted));
+            window_ = reinterpret_cast<const uint8_t*>(buffer_.data());
+            window_start_ = offset;
+            window_size_ = 0;
+
+            const auto read = file_.read_at(
+                offset, buffer_.data(), buffer_.size()
+            );
+            if (!read || *read < size) {
+                return std::unexpected(
+                    read ? "Truncated PNG file" : read.error().message()
+                );
+            }
+            window_size_ = *read;
+            return window_;
+        }
+
+        const char* keep(
+            const uint8_t* data, size_t, sung::PngChunkMeta& meta
+        ) {
+            // Moving a vector keeps its heap block, so the window and the
+            // views into it stay valid
+            if (!buffer_.empty())
+                meta.storage_.push_back(std::exchange(buffer_, {}));
+            return reinterpret_cast<const char*>(data);
+        }
+
+    private:
+        const sung::RandomAccessFile& file_;
+        std::vector<char> buffer_;
+        const uint8_t* window_ = nullptr;
+        uint64_t window_start_ = 0;
+        size_t window_size_ = 0;
+    };
+
+    template <typename TSource>
+    std::expected<sung::PngChunkMeta, std::string> scan_chunks(
+        TSource& source, const sung::PngTextKeys keys
+    ) {
+        const auto signature = source.fetch(0, sizeof(PNG_SIGNATURE));
+        if (!signature)
+            return std::unexpected(signature.error());
+        if (std::memcmp(*signature, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)))
+            return std::unexpected("Not a PNG file");
+
+        sung::PngChunkMeta meta;
+        bool seen_header = false;
+        uint64_t offset = sizeof(PNG_SIGNATURE);
+        while (true) {
+            const auto header = source.fetch(offset, 8);
+            if (!header)
+                return std::unexpected(header.error());
+
+            const auto length = ::read_be32(*header);
+            const std::string_view type(
+                reinterpret_cast<const char*>(*header + 4), 4
+            );
+            if (length > MAX_CHUNK_LENGTH)
+                return std::unexpected("Invalid PNG chunk length");
+
+            const auto data_offset = offset + 8;
+            offset = data_offset + length + 4;
+
+            if (!seen_header) {
+                if (type != "IHDR" || length != 13)
+                    return std::unexpected("PNG does not start with IHDR");
+
+                // Type, data and CRC in one piece
+                const auto chunk = source.fetch(data_offset - 4, 4 + 13 + 4);
+                if (!chunk)
+                    return std::unexpected(chunk.error());
+                if (!::check_crc(*chunk, 13))
+                    return std::unexpected("IHDR CRC mismatch");
+
+                const auto data = *chunk + 4;
+                meta.width_ = static_cast<int>(::read_be32(data));
+                meta.height_ = static_cast<int>(::read_be32(data + 4));
+                meta.bit_depth_ = data[8];
+                meta.color_type_ = data[9];
+                meta.interlaced_ = data[12] != 0;
+                seen_header = true;
+                continue;
+            }
+
+            if (type == "IDAT" || type == "IEND")
+                break;
+            if (type != "tEXt" && type != "zTXt" && type != "iTXt")
+                continue;
+
+            // Peek at the keyword before pulling in a chunk that may be
+            // megabytes of someone else's metadata
+            if (!keys.empty()) {
+                const auto peek_size = std::min<size_t>(length, MAX_KEY_BYTES);
+                const auto peek = source.fetch(data_offset, peek_size);
+                if (!peek)
+                    return std::unexpected(peek.error());
+                const auto key = ::find_key(
+                    reinterpret_cast<const char*>(*peek), peek_size
+                );
+                if (!::is_wanted(key, keys))
+                    continue;
+            }
+
+            // Text CRCs are not checked: hashing the chunk costs more than
+            // the rest of the scan, and a damaged workflow fails to parse
+            // as JSON further down anyway.
+            const auto chunk = source.fetch(data_offset, length);
+            if (!chunk)
+                return std::unexpected(chunk.error());
+
+            const auto data = source.keep(*chunk, length, meta);
+            ::add_text_chunk(meta, type, data, length);
+        }
+
+        return meta;
+    }
+
+}  // namespace
+
+
+namespace sung {
+
+    std::optional<std::string_view> PngChunkMeta::find_text(
+        const std::string_view key
+    ) const {
+        for (const auto& text : text_) {
+            if (text.key_ == key)
+                return text.value_;
+        }
+        return std::nullopt;
+    }
+
+    std::expected<PngChunkMeta, std::string> parse_png_chunks(
+        const uint8_t* data, const size_t size, const PngTextKeys keys
+    ) {
+        ::MemorySource source{ data, size };
+        return ::scan_chunks(source, keys);
+    }
+
+    std::expected<PngChunkMeta, std::string> read_png_chunks(
+        const Path& path, const PngTextKeys keys
+    ) {
+        RandomAccessFile file;
+        if (const auto error = file.open(path)) {
+            return std::unexpected(
+                std::format("Failed to open PNG file: {}", error.message())
+            );
+        }
+
+        return read_png_chunks(file, keys);
+    }
+
+    std::expected<PngChunkMeta, std::string> read_png_chunks(
+        const RandomAccessFile& file, const PngTextKeys keys
+    ) {
+        ::FileSource source{ file };
+        return ::scan_chunks(source, keys);
+    }
+
+}  // namespace sung
@@ -1,104 +1,154 @@
 #include "sung/image/xmp.hpp"
 
-#include <format>
-#include <sstream>
+#include <cstring>
 #include <string_view>
 
 #include <nlohmann/json.hpp>
-#include <pugixml.hpp>
 
 
 namespace {
 
-    void append_cdata_safely(pugi::xml_node parent, std::string_view s) {
-        // Splits CDATA terminators so the resulting XML is valid.
-        // The actual text content remains identical.
+    // The layout pugixml produced with two-space indents and no XML
+    // declaration. Packets already written by sprintboard look exactly like
+    // this, so the bytes must not change.
+    constexpr std::string_view PACKET_HEAD =
+        "<?xpacket begin=\"\xEF\xBB\xBF\" id=\"W5M0MpCehiHzreSzNTczkc9d\"?>\n"
+        "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\" x:xmptk=\"sprintboard\">\n"
+        "  <rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">"
+        "\n"
+        "    <rdf:Description rdf:about=\"\" "
+        "xmlns:sprintboard=\"https://github.com/SausageTaste/sprintboard/\"";
+    constexpr std::string_view DESCRIPTION_END = "    </rdf:Description>\n";
+    constexpr std::string_view PACKET_TAIL =
+        "  </rdf:RDF>\n"
+        "</x:xmpmeta>\n"
+        "<?xpacket end=\"w\"?>\n";
+
+    constexpr std::string_view PNG_TEXT_PREFIX = "sprintboard:pngText_";
+    constexpr std::string_view TAG_ANALYSIS_NAME = "sprintboard:tagAnalysis";
+
+    constexpr std::string_view CDATA_BEGIN = "<![CDATA[";
+    constexpr std::string_view CDATA_END = "]]>";
+    // A "]]>" in the text becomes a CDATA section holding "]]" followed by
+    // an escaped ">", so the text content stays identical
+    constexpr std::string_view CDATA_SPLIT_TERMINATOR = "<![CDATA[]]]]>&gt;";
+
+    // Indent, tags and the CDATA wrapper around one property
+    constexpr size_t PROPERTY_OVERHEAD = 64;
+
+    template <typename TBuffer>
+    void append(TBuffer& out, const std::string_view s) {
+        out.insert(out.end(), s.begin(), s.end());
+    }
+
+    template <typename TBuffer>
+    void append_cdata_safely(TBuffer& out, const std::string_view s) {
         size_t pos = 0;
         while (true) {
-            const size_t p = s.find("]]>", pos);
-            if (p == std::string_view::npos) {
-                parent.append_child(pugi::node_cdata)
-                    .set_value(std::string(s.substr(pos)).c_str());
+            const size_t p = s.find(CDATA_END, pos);
+            const auto end = p == std::string_view::npos ? s.size() : p;
+            auto piece = s.substr(pos, end - pos);
+            // pugixml kept each piece as a C string, which ended it at the
+            // first NUL
+            const auto nul = static_cast<const char*>(
+                std::memchr(piece.data(), 0, piece.size())
+            );
+            if (nul)
+                piece = piece.substr(0, nul - piece.data());
+
+            ::append(out, CDATA_BEGIN);
+            ::append(out, piece);
+            ::append(out, CDATA_END);
+            if (p == std::string_view::npos)
                 break;
-            }
-
-            parent.append_child(pugi::node_cdata)
-                .set_value(std::string(s.substr(pos, p - pos)).c_str());
-
-            // Recreate the terminator across adjacent text nodes.
-            parent.append_child(pugi::node_cdata).set_value("]]");
-            parent.append_child(pugi::node_pcdata).set_value(">");
 
-            pos = p + 3;
+            ::append(out, CDATA_SPLIT_TERMINATOR);
+            pos = p + CDATA_END.size();
         }
     }
 
-}  // namespace
-
-
-namespace sung {
-
-    std::string make_xmp_packet_impl(
-        const PngMeta& src, const nlohmann::json* tag_analysis
+    template <typename TBuffer>
+    void append_property(
+        TBuffer& out,
+        const std::string_view prefix,
+        const std::string_view name,
+        const std::string_view value
     ) {
-        pugi::xml_document doc;
-
-        std::string xpacket_begin = "begin=\"";
-        xpacket_begin += std::string("\xEF\xBB\xBF", 3);  // UTF-8 BOM bytes
-        xpacket_begin += "\" id=\"W5M0MpCehiHzreSzNTczkc9d\"";
-
-        auto pi_begin = doc.append_child(pugi::node_pi);
-        pi_begin.set_name("xpacket");
-        pi_begin.set_value(xpacket_begin);
-
-        pugi::xml_node xmpmeta = doc.append_child("x:xmpmeta");
-        xmpmeta.append_attribute("xmlns:x") = "adobe:ns:meta/";
-        xmpmeta.append_attribute("x:xmptk") = "sprintboard";
-
-        pugi::xml_node rdf = xmpmeta.append_child("rdf:RDF");
-        rdf.append_attribute(
-            "xmlns:rdf"
-        ) = "http://www.w3.org/1999/02/22-rdf-syntax-ns#";
+        ::append(out, "      <");
+        ::append(out, prefix);
+        ::append(out, name);
+        ::append(out, ">");
+        ::append_cdata_safely(out, value);
+        ::append(out, "</");
+        ::append(out, prefix);
+        ::append(out, name);
+        ::append(out, ">\n");
+    }
 
-        pugi::xml_node desc = rdf.append_child("rdf:Description");
-        desc.append_attribute("rdf:about") = "";
-        desc.append_attribute(
-            "xmlns:sprintboard"
-        ) = "https://github.com/SausageTaste/sprintboard/";
+    // Streams the packet into one buffer reserved up front. Only text that
+    // contains CDATA terminators can make it grow past the reservation.
+    template <typename TBuffer>
+    TBuffer make_xmp_packet_impl(
+        const sung::PngMeta& src, const nlohmann::json* tag_analysis
+    ) {
+        const auto analysis = tag_analysis ? tag_analysis->dump()
+                                           : std::string{};
 
+        size_t capacity = PACKET_HEAD.size() + DESCRIPTION_END.size() +
+                          PACKET_TAIL.size() + 4;
         for (const auto& kv : src.text) {
-            const auto key = std::format("sprintboard:pngText_{}", kv.key);
-            pugi::xml_node node = desc.append_child(key.c_str());
-            append_cdata_safely(node, kv.value);
+            capacity += PROPERTY_OVERHEAD + 2 * PNG_TEXT_PREFIX.size() +
+                        2 * kv.key.size() + kv.value.size();
         }
-
         if (tag_analysis) {
-            auto node = desc.append_child("sprintboard:tagAnalysis");
-            append_cdata_safely(node, tag_analysis->dump());
+            capacity += PROPERTY_OVERHEAD + 2 * TAG_ANALYSIS_NAME.size() +
+                        analysis.size();
         }
 
-        auto pi_end = doc.append_child(pugi::node_pi);
-        pi_end.set_name("xpacket");
-        pi_end.set_value(R"(end="w")");
+        TBuffer out;
+        out.reserve(capacity);
+        ::append(out, PACKET_HEAD);
+
+        if (src.text.empty() && !tag_analysis) {
+            ::append(out, " />\n");
+        } else {
+            ::append(out, ">\n");
+            for (const auto& kv : src.text)
+                ::append_property(out, PNG_TEXT_PREFIX, kv.key, kv.value);
+            if (tag_analysis)
+                ::append_property(out, TAG_ANALYSIS_NAME, {}, analysis);
+            ::append(out, DESCRIPTION_END);
+        }
 
-        std::ostringstream oss;
-        doc.save(
-            oss,
-            "  ",
-            pugi::format_default | pugi::format_no_declaration,
-            pugi::encoding_utf8
-        );
-        return oss.str();
+        ::append(out, PACKET_TAIL);
+        return out;
     }
 
+}  // namespace
+
+
+namespace sung {
+
     std::string make_xmp_packet(const PngMeta& src) {
-        return make_xmp_packet_impl(src, nullptr);
+        return ::make_xmp_packet_impl<std::string>(src, nullptr);
     }
 
     std::string make_xmp_packet(
         const PngMeta& src, const nlohmann::json& tag_analysis
     ) {
-        return make_xmp_packet_impl(src, &tag_analysis);
+        return ::make_xmp_packet_impl<std::string>(src, &tag_analysis);
+    }
+
+    std::vector<uint8_t> make_xmp_blob(const PngMeta& src) {
+        return ::make_xmp_packet_impl<std::vector<uint8_t>>(src, nullptr);
+    }
+
+    std::vector<uint8_t> make_xmp_blob(
+        const PngMeta& src, const nlohmann::json& tag_analysis
+    ) {
+        return ::make_xmp_packet_impl<std::vector<uint8_t>>(
+            src, &tag_analysis
+        );
     }
 
 }  // namespace sung
@@ -0,0 +1,203 @@
+#include "xmp_scan.hpp"
+
+#include <string_view>
+#include <utility>
+
+
+namespace {
+
+    constexpr std::string_view WORKFLOW_NAME = "sprintboard:pngText_workflow";
+    constexpr std::string_view LEGACY_WORKFLOW_NAME = "sprintboard:workflow";
+
+    constexpr std::string_view CDATA_BEGIN = "<![CDATA[";
+    constexpr std::string_view CDATA_END = "]]>";
+
+    bool is_space(const char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    // pugixml's `parse_eol` turns "\r\n" and lone "\r" into "\n"
+    void append_text(std::vector<uint8_t>& out, const std::string_view s) {
+        if (s.find('\r') == std::string_view::npos) {
+            out.insert(out.end(), s.begin(), s.end());
+            return;
+        }
+
+        for (size_t i = 0; i < s.size(); ++i) {
+            if (s[i] != '\r') {
+                out.push_back(static_cast<uint8_t>(s[i]));
+                continue;
+            }
+            out.push_back('\n');
+            if (i + 1 < s.size() && s[i + 1] == '\n')
+                ++i;
+        }
+    }
+
+    // Character data with the predefined entities decoded
+    bool append_pcdata(std::vector<uint8_t>& out, std::string_view s) {
+        while (!s.empty()) {
+            const auto amp = s.find('&');
+            ::append_text(out, s.substr(0, amp));
+            if (amp == std::string_view::npos)
+                break;
+
+            s.remove_prefix(amp);
+            constexpr std::pair<std::string_view, char> entities[] = {
+                { "&gt;", '>' },    { "&lt;", '<' },   { "&amp;", '&' },
+                { "&quot;", '"' }, { "&apos;", '\'' },
+            };
+            bool decoded = false;
+            for (const auto& [entity, c] : entities) {
+                if (s.starts_with(entity)) {
+                    out.push_back(static_cast<uint8_t>(c));
+                    s.remove_prefix(entity.size());
+                    decoded = true;
+                    break;
+                }
+            }
+            if (!decoded)
+                return false;
+        }
+        return true;
+    }
+
+    // Text of the element whose content starts at `pos`, up to its end tag
+    std::optional<std::vector<uint8_t>> collect_text(
+        const std::string_view xml, size_t pos, const std::string_view name
+    ) {
+        std::vector<uint8_t> output;
+        while (pos < xml.size()) {
+            const auto lt = xml.find('<', pos);
+            if (lt == std::string_view::npos)
+                return std::nullopt;
+
+            const auto pcdata = xml.substr(pos, lt - pos);
+            const auto blank = pcdata.find_first_not_of(" \t\r\n") ==
+                               std::string_view::npos;
+            if (!blank && !::append_pcdata(output, pcdata))
+                return std::nullopt;
+
+            const auto rest = xml.substr(lt);
+            if (rest.starts_with(CDATA_BEGIN)) {
+                const auto begin = lt + CDATA_BEGIN.size();
+                const auto end = xml.find(CDATA_END, begin);
+                if (end == std::string_view::npos)
+                    return std::nullopt;
+                ::append_text(output, xml.substr(begin, end - begin));
+                pos = end + CDATA_END.size();
+                continue;
+            }
+
+            // Anything but the matching end tag is left to the DOM
+            if (!rest.starts_with("</") || !rest.substr(2).starts_with(name))
+                return std::nullopt;
+            const auto after_name = rest.substr(2 + name.size());
+            const auto close = after_name.find('>');
+            if (close == std::string_view::npos)
+                return std::nullopt;
+            for (const auto c : after_name.substr(0, close)) {
+                if (!::is_space(c))
+                    return std::nullopt;
+            }
+            return output;
+        }
+
+        return std::nullopt;
+    }
+
+    // End of the start tag beginning at `pos`, skipping quoted attribute
+    // values
+    size_t find_tag_end(const std::string_view xml, size_t pos) {
+        char quote = 0;
+        for (; pos < xml.size(); ++pos) {
+            const auto c = xml[pos];
+            if (quote) {
+                if (c == quote)
+                    quote = 0;
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (c == '>') {
+                return pos;
+            }
+        }
+        return std::string_view::npos;
+    }
+
+}  // namespace
+
+
+namespace sung::detail {
+
+    std::optional<std::vector<uint8_t>> scan_xmp_workflow(
+        const uint8_t* data, const size_t size
+    ) {
+        const std::string_view xml(reinterpret_cast<const char*>(data), size);
+        // UTF-16 and UTF-32 packets have NULs early on; pugixml converts those
+        if (xml.substr(0, 4).find('\0') != std::string_view::npos)
+            return std::nullopt;
+
+        struct Found {
+            size_t content_ = 0;
+            bool empty_ = false;
+        };
+        std::optional<Found> legacy;
+
+        size_t pos = 0;
+        while (true) {
+            const auto lt = xml.find('<', pos);
+            if (lt == std::string_view::npos)
+                break;
+
+            const auto rest = xml.substr(lt);
+            std::string_view terminator;
+            if (rest.starts_with(CDATA_BEGIN))
+                terminator = CDATA_END;
+            else if (rest.starts_with("<!--"))
+                terminator = "-->";
+            else if (rest.starts_with("<?"))
+                terminator = "?>";
+            else if (rest.starts_with("<!"))
+                return std::nullopt;
+
+            if (!terminator.empty()) {
+                const auto end = xml.find(terminator, lt + 2);
+                if (end == std::string_view::npos)
+                    return std::nullopt;
+                pos = end + terminator.size();
+                continue;
+            }
+
+            const auto tag_end = ::find_tag_end(xml, lt + 1);
+            if (tag_end == std::string_view::npos)
+                return std::nullopt;
+            pos = tag_end + 1;
+            if (rest.starts_with("</"))
+                continue;
+
+            auto name = rest.substr(1, tag_end - lt - 1);
+            const auto empty = name.ends_with('/');
+            if (empty)
+                name.remove_suffix(1);
+            for (size_t i = 0; i < name.size(); ++i) {
+                if (::is_space(name[i])) {
+                    name = name.substr(0, i);
+                    break;
+                }
+            }
+
+            if (name == WORKFLOW_NAME) {
+                if (empty)
+                    return std::vector<uint8_t>{};
+                return ::collect_text(xml, pos, name);
+            }
+            if (name == LEGACY_WORKFLOW_NAME && !legacy)
+                legacy = Found{ pos, empty };
+        }
+
+        if (!legacy || legacy->empty_)
+            return std::vector<uint8_t>{};
+        return ::collect_text(xml, legacy->content_, LEGACY_WORKFLOW_NAME);
+    }
+
+}  // namespace sung::detail
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+
+namespace sung::detail {
+
+    // What `AvifMeta::find_workflow_data` returns, scanned straight from the
+    // packet bytes: the text of the first `sprintboard:pngText_workflow`
+    // element, else of the first `sprintboard:workflow`, else nothing. Text
+    // is rebuilt from the element's CDATA and character data as pugixml's
+    // default parse would. Returns nullopt for markup it does not handle,
+    // such as child elements, numeric character references or non UTF-8
+    // packets; parse the DOM then. The rest of the packet is not validated.
+    std::optional<std::vector<uint8_t>> scan_xmp_workflow(
+        const uint8_t* data, size_t size
+    );
+
+}  // namespace sung::detail
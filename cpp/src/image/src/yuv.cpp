@@ -0,0 +1,438 @@
+#include "sung/image/yuv.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <optional>
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #include <immintrin.h>
+    #define HAS_X86_SIMD 1
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        // MSVC accepts AVX2 intrinsics in any function
+        #define TARGET_AVX2
+    #else
+        #define TARGET_AVX2 __attribute__((target("avx2")))
+    #endif
+#else
+    #define HAS_X86_SIMD 0
+#endif
+
+
+namespace {
+
+    // The float math below follows libavif's reference conversion step by
+    // step, one operation per statement so no compiler fuses a multiply and
+    // an add that libavif rounds separately
+    struct Coefficients {
+        float kr_ = 0;
+        float kg_ = 0;
+        float kb_ = 0;
+        float u_div_ = 0;
+        float v_div_ = 0;
+        // Full range spans 0 to 255, limited range 16 to 235 for luma and
+        // 16 to 240 for chroma
+        float y_scale_ = 0;
+        float y_bias_ = 0;
+        float uv_scale_ = 0;
+    };
+
+    std::optional<Coefficients> find_coefficients(const avifImage& image) {
+        // MIAF defaults to BT.601 for images that do not say otherwise
+        float kr = 0.299f;
+        float kb = 0.114f;
+        switch (image.matrixCoefficients) {
+            case AVIF_MATRIX_COEFFICIENTS_UNSPECIFIED:
+            case AVIF_MATRIX_COEFFICIENTS_BT470BG:
+            case AVIF_MATRIX_COEFFICIENTS_BT601:
+                break;
+            case AVIF_MATRIX_COEFFICIENTS_BT709:
+                kr = 0.2126f;
+                kb = 0.0722f;
+                break;
+            case AVIF_MATRIX_COEFFICIENTS_FCC:
+                kr = 0.30f;
+                kb = 0.11f;
+                break;
+            case AVIF_MATRIX_COEFFICIENTS_SMPTE240:
+                kr = 0.212f;
+                kb = 0.087f;
+                break;
+            default:
+                return std::nullopt;
+        }
+
+        Coefficients output;
+        output.kr_ = kr;
+        output.kb_ = kb;
+        output.kg_ = 1.0f - kr - kb;
+        output.u_div_ = 2 * (1 - kb);
+        output.v_div_ = 2 * (1 - kr);
+        const bool limited = image.yuvRange == AVIF_RANGE_LIMITED;
+        output.y_scale_ = limited ? 219.0f : 255.0f;
+        output.y_bias_ = limited ? 16.0f : 0.0f;
+        output.uv_scale_ = limited ? 224.0f : 255.0f;
+        return output;
+    }
+
+    // One or two image rows and the chroma row they share
+    struct Block {
+        const uint8_t* rgba_[2] = {};
+        uint8_t* y_[2] = {};
+        uint8_t* a_[2] = {};
+        uint8_t* u_ = nullptr;
+        uint8_t* v_ = nullptr;
+        uint32_t rows_ = 0;
+        uint32_t width_ = 0;
+        bool subsample_x_ = false;
+    };
+
+    uint8_t to_unorm(const float value, const float scale, const float bias) {
+        const float scaled = value * scale;
+        const float biased = scaled + bias;
+        const auto output = static_cast<int>(std::floor(biased + 0.5f));
+        return static_cast<uint8_t>(std::clamp(output, 0, 255));
+    }
+
+    // Columns from `x_begin`, which must be even when subsampling
+    void convert_block_scalar(
+        const Block& block, const Coefficients& k, const uint32_t x_begin
+    ) {
+        const uint32_t block_w = block.subsample_x_ ? 2 : 1;
+        for (uint32_t x = x_begin; x < block.width_; x += block_w) {
+            const auto w = std::min(block_w, block.width_ - x);
+            float sum_u = 0.0f;
+            float sum_v = 0.0f;
+            for (uint32_t j = 0; j < block.rows_; ++j) {
+                for (uint32_t i = 0; i < w; ++i) {
+                    const auto* px = block.rgba_[j] + (x + i) * 4;
+                    const float r = px[0] / 255.0f;
+                    const float g = px[1] / 255.0f;
+                    const float b = px[2] / 255.0f;
+
+                    const float y_r = k.kr_ * r;
+                    const float y_g = k.kg_ * g;
+                    const float y_b = k.kb_ * b;
+                    const float y = y_r + y_g + y_b;
+                    const float u = (b - y) / k.u_div_;
+                    const float v = (r - y) / k.v_div_;
+
+                    block.y_[j][x + i] = ::to_unorm(y, k.y_scale_, k.y_bias_);
+                    if (block.a_[j])
+                        block.a_[j][x + i] = px[3];
+                    if (!block.subsample_x_ && block.u_) {
+                        block.u_[x + i] = ::to_unorm(u, k.uv_scale_, 128);
+                        block.v_[x + i] = ::to_unorm(v, k.uv_scale_, 128);
+                    }
+                    sum_u += u;
+                    sum_v += v;
+                }
+            }
+
+            if (block.subsample_x_ && block.u_) {
+                const auto samples = static_cast<float>(w * block.rows_);
+                const float u = sum_u / samples;
+                const float v = sum_v / samples;
+                block.u_[x / 2] = ::to_unorm(u, k.uv_scale_, 128);
+                block.v_[x / 2] = ::to_unorm(v, k.uv_scale_, 128);
+            }
+        }
+    }
+
+}  // namespace
+
+
+#if HAS_X86_SIMD
+namespace {
+
+    struct CoefficientsAvx2 {
+        __m256 kr_, kg_, kb_, u_div_, v_div_;
+    };
+
+    struct PixelsAvx2 {
+        __m256 y_, u_, v_;
+        __m256i a_;
+    };
+
+    bool detect_avx2() {
+    #if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    #else
+        return __builtin_cpu_supports("avx2");
+    #endif
+    }
+
+    // Eight pixels, deinterleaved and converted like the scalar path
+    TARGET_AVX2 PixelsAvx2
+    convert8_avx2(const uint8_t* rgba, const CoefficientsAvx2& k) {
+        const auto px = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(rgba)
+        );
+        const auto mask = _mm256_set1_epi32(0xFF);
+        const auto max_channel = _mm256_set1_ps(255.0f);
+        const auto r = _mm256_div_ps(
+            _mm256_cvtepi32_ps(_mm256_and_si256(px, mask)), max_channel
+        );
+        const auto g = _mm256_div_ps(
+            _mm256_cvtepi32_ps(
+                _mm256_and_si256(_mm256_srli_epi32(px, 8), mask)
+            ),
+            max_channel
+        );
+        const auto b = _mm256_div_ps(
+            _mm256_cvtepi32_ps(
+                _mm256_and_si256(_mm256_srli_epi32(px, 16), mask)
+            ),
+            max_channel
+        );
+
+        PixelsAvx2 output;
+        output.y_ = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(k.kr_, r), _mm256_mul_ps(k.kg_, g)),
+            _mm256_mul_ps(k.kb_, b)
+        );
+        output.u_ = _mm256_div_ps(_mm256_sub_ps(b, output.y_), k.u_div_);
+        output.v_ = _mm256_div_ps(_mm256_sub_ps(r, output.y_), k.v_div_);
+        output.a_ = _mm256_srli_epi32(px, 24);
+        return output;
+    }
+
+    // Out of range results are left for the saturating packs in the stores
+    TARGET_AVX2 __m256i
+    to_unorm_avx2(const __m256 value, const float scale, const float bias) {
+        const auto scaled = _mm256_mul_ps(value, _mm256_set1_ps(scale));
+        const auto biased = _mm256_add_ps(scaled, _mm256_set1_ps(bias));
+        return _mm256_cvttps_epi32(
+            _mm256_floor_ps(_mm256_add_ps(biased, _mm256_set1_ps(0.5f)))
+        );
+    }
+
+    TARGET_AVX2 __m128i to_unorm_sse(const __m128 value, const float scale) {
+        const auto scaled = _mm_mul_ps(value, _mm_set1_ps(scale));
+        const auto biased = _mm_add_ps(scaled, _mm_set1_ps(128.0f));
+        return _mm_cvttps_epi32(
+            _mm_floor_ps(_mm_add_ps(biased, _mm_set1_ps(0.5f)))
+        );
+    }
+
+    // Eight 32-bit lanes holding bytes
+    TARGET_AVX2 void store8_avx2(uint8_t* dst, const __m256i values) {
+        const auto words = _mm256_packus_epi32(values, values);
+        const auto bytes = _mm256_packus_epi16(words, words);
+        const auto joined = _mm256_permutevar8x32_epi32(
+            bytes, _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0)
+        );
+        _mm_storel_epi64(
+            reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(joined)
+        );
+    }
+
+    TARGET_AVX2 void store4_sse(uint8_t* dst, const __m128i values) {
+        const auto words = _mm_packus_epi32(values, values);
+        const auto bytes = _mm_packus_epi16(words, words);
+        const auto packed = _mm_cvtsi128_si32(bytes);
+        std::memcpy(dst, &packed, 4);
+    }
+
+    // Even lanes in the low half, odd lanes in the high half
+    TARGET_AVX2 __m256 split_even_odd(const __m256 values) {
+        return _mm256_permutevar8x32_ps(
+            values, _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7)
+        );
+    }
+
+    // Returns the number of columns converted, a multiple of 8. The scalar
+    // path finishes the rest. A lone last row of a 4:2:0 image is left to
+    // it whole.
+    TARGET_AVX2 uint32_t
+    convert_block_avx2(const Block& block, const Coefficients& k) {
+        // Only 4:2:0 blocks have two rows
+        const bool subsample_y = block.rows_ == 2;
+
+        const CoefficientsAvx2 kv{
+            _mm256_set1_ps(k.kr_),    _mm256_set1_ps(k.kg_),
+            _mm256_set1_ps(k.kb_),    _mm256_set1_ps(k.u_div_),
+            _mm256_set1_ps(k.v_div_),
+        };
+
+        const auto width = block.width_ & ~7u;
+        for (uint32_t x = 0; x < width; x += 8) {
+            PixelsAvx2 px[2];
+            for (uint32_t j = 0; j < block.rows_; ++j) {
+                px[j] = ::convert8_avx2(block.rgba_[j] + x * 4, kv);
+                ::store8_avx2(
+                    block.y_[j] + x,
+                    ::to_unorm_avx2(px[j].y_, k.y_scale_, k.y_bias_)
+                );
+                if (block.a_[j])
+                    ::store8_avx2(block.a_[j] + x, px[j].a_);
+            }
+            if (!block.u_)
+                continue;
+
+            if (!block.subsample_x_) {
+                ::store8_avx2(
+                    block.u_ + x, ::to_unorm_avx2(px[0].u_, k.uv_scale_, 128)
+                );
+                ::store8_avx2(
+                    block.v_ + x, ::to_unorm_avx2(px[0].v_, k.uv_scale_, 128)
+                );
+                continue;
+            }
+
+            // Summed in the scalar path's order: left then right, top row
+            // then bottom row
+            // `px[1]` is only written for 4:2:0 blocks, so it is read under
+            // `subsample_y` alone
+            __m128 sums[2];
+            for (int c = 0; c < 2; ++c) {
+                const auto top = ::split_even_odd(c == 0 ? px[0].u_ : px[0].v_);
+                auto sum = _mm_add_ps(
+                    _mm256_castps256_ps128(top), _mm256_extractf128_ps(top, 1)
+                );
+                if (subsample_y) {
+                    const auto bottom = ::split_even_odd(
+                        c == 0 ? px[1].u_ : px[1].v_
+                    );
+                    sum = _mm_add_ps(sum, _mm256_castps256_ps128(bottom));
+                    sum = _mm_add_ps(sum, _mm256_extractf128_ps(bottom, 1));
+                }
+                const auto samples = _mm_set1_ps(subsample_y ? 4.0f : 2.0f);
+                sums[c] = _mm_div_ps(sum, samples);
+            }
+            const auto u = ::to_unorm_sse(sums[0], k.uv_scale_);
+            const auto v = ::to_unorm_sse(sums[1], k.uv_scale_);
+            ::store4_sse(block.u_ + x / 2, u);
+            ::store4_sse(block.v_ + x / 2, v);
+        }
+        return width;
+    }
+
+}  // namespace
+#endif
+
+
+namespace sung {
+
+    bool has_avx2_yuv_converter() {
+#if HAS_X86_SIMD
+        static const bool output = ::detect_avx2();
+        return output;
+#else
+        return false;
+#endif
+    }
+
+    ErrStr rgba_to_yuv(
+        avifImage& image,
+        const uint8_t* rgba,
+        const size_t row_bytes,
+        const uint32_t first_row,
+        const uint32_t row_count,
+        const YuvConverter converter
+    ) {
+        if (image.depth != 8)
+            return std::unexpected("only 8-bit images supported");
+        if (first_row > image.height || row_count > image.height - first_row)
+            return std::unexpected("rows outside the image");
+        if (row_bytes < static_cast<size_t>(image.width) * 4)
+            return std::unexpected("RGBA rows are too short");
+
+        const auto k = ::find_coefficients(image);
+        if (!k)
+            return std::unexpected("unsupported matrix coefficients");
+
+        bool subsample_x = false;
+        bool subsample_y = false;
+        switch (image.yuvFormat) {
+            case AVIF_PIXEL_FORMAT_YUV444:
+            case AVIF_PIXEL_FORMAT_YUV400:
+                break;
+            case AVIF_PIXEL_FORMAT_YUV422:
+                subsample_x = true;
+                break;
+            case AVIF_PIXEL_FORMAT_YUV420:
+                subsample_x = true;
+                subsample_y = true;
+                break;
+            default:
+                return std::unexpected("unsupported pixel format");
+        }
+        const bool has_chroma = image.yuvFormat != AVIF_PIXEL_FORMAT_YUV400;
+        if (subsample_y && first_row % 2 != 0)
+            return std::unexpected("4:2:0 strips must start on an even row");
+        if (subsample_y && row_count % 2 != 0 &&
+            first_row + row_count != image.height)
+            return std::unexpected("4:2:0 strips must have even row counts");
+
+        [[maybe_unused]] bool use_avx2 = false;
+        switch (converter) {
+            case YuvConverter::best:
+                use_avx2 = has_avx2_yuv_converter();
+                break;
+            case YuvConverter::scalar:
+                break;
+            case YuvConverter::avx2:
+                if (!has_avx2_yuv_converter())
+                    return std::unexpected("AVX2 is not available");
+                use_avx2 = true;
+                break;
+        }
+
+        if (!image.yuvPlanes[AVIF_CHAN_Y] ||
+            (has_chroma &&
+             (!image.yuvPlanes[AVIF_CHAN_U] || !image.yuvPlanes[AVIF_CHAN_V])))
+            return std::unexpected("YUV planes are not allocated");
+
+        const uint32_t block_h = subsample_y ? 2 : 1;
+        for (uint32_t j = 0; j < row_count; j += block_h) {
+            Block block;
+            block.rows_ = std::min(block_h, row_count - j);
+            block.width_ = image.width;
+            block.subsample_x_ = subsample_x;
+
+            const auto row = first_row + j;
+            for (uint32_t i = 0; i < block.rows_; ++i) {
+                block.rgba_[i] = rgba + (j + i) * row_bytes;
+                block.y_[i] = image.yuvPlanes[AVIF_CHAN_Y] +
+                              static_cast<size_t>(row + i) *
+                                  image.yuvRowBytes[AVIF_CHAN_Y];
+                if (image.alphaPlane && image.alphaRowBytes) {
+                    block.a_[i] = image.alphaPlane +
+                                  static_cast<size_t>(row + i) *
+                                      image.alphaRowBytes;
+                }
+            }
+            if (has_chroma) {
+                const auto chroma_row = static_cast<size_t>(
+                    subsample_y ? row / 2 : row
+                );
+                block.u_ = image.yuvPlanes[AVIF_CHAN_U] +
+                           chroma_row * image.yuvRowBytes[AVIF_CHAN_U];
+                block.v_ = image.yuvPlanes[AVIF_CHAN_V] +
+                           chroma_row * image.yuvRowBytes[AVIF_CHAN_V];
+            }
+
+            uint32_t done = 0;
+#if HAS_X86_SIMD
+            if (use_avx2 && block.rows_ == block_h)
+                done = ::convert_block_avx2(block, *k);
+#endif
+            ::convert_block_scalar(block, *k, done);
+        }
+
+        return {};
+    }
+
+}  // namespace sung
@@ -1,12 +1,21 @@
 #include "index/image_index.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <format>
+#include <functional>
 #include <limits>
+#include <memory>
 #include <mutex>
 #include <print>
 #include <set>
+#include <shared_mutex>
+#include <span>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -25,6 +34,8 @@
 #include "image_query.hpp"
 #include "tag_sidecar.hpp"
 #include "tagger_client.hpp"
+#include "util/metadata_cache.hpp"
+#include "util/sidecar_writer.hpp"
 
 #if defined(SUNG_OS_WINDOWS)
     #ifndef NOMINMAX
@@ -74,7 +85,7 @@ namespace sung::detail {
 
 namespace {
 
-    constexpr int DATABASE_SCHEMA_VERSION = 5;
+    constexpr int DATABASE_SCHEMA_VERSION = 6;
     constexpr int64_t NANOSECONDS_PER_SECOND = 1'000'000'000;
 
 
@@ -184,6 +195,73 @@ namespace {
 #endif
     }
 
+}  // namespace
+
+
+namespace sung::detail {
+
+    int64_t read_image_sort_time(const Path& path) {
+        return ::get_image_sort_time(path);
+    }
+
+}  // namespace sung::detail
+
+
+namespace {
+
+    // Shared by the metadata map and every snapshot that lists the file, so
+    // prompt text is held once. Null when the image has no prompts.
+    using PromptList = std::shared_ptr<const std::vector<std::string>>;
+
+    const std::vector<std::string>& prompts_or_empty(const PromptList& list) {
+        static const std::vector<std::string> empty;
+        return list ? *list : empty;
+    }
+
+    PromptList make_prompt_list(std::vector<std::string> prompts) {
+        if (prompts.empty())
+            return nullptr;
+        return std::make_shared<const std::vector<std::string>>(
+            std::move(prompts)
+        );
+    }
+
+    // The `prompts_blob` column: each prompt as a 32-bit little endian byte
+    // count followed by its UTF-8 bytes
+    std::string encode_prompts(const PromptList& list) {
+        std::string output;
+        for (const auto& prompt : ::prompts_or_empty(list)) {
+            const auto size = static_cast<uint32_t>(prompt.size());
+            for (int shift = 0; shift < 32; shift += 8)
+                output.push_back(static_cast<char>((size >> shift) & 0xFF));
+            output += prompt;
+        }
+        return output;
+    }
+
+    // Empty optional when the blob is truncated
+    std::optional<PromptList> decode_prompts(
+        const void* data, const size_t size
+    ) {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        std::vector<std::string> prompts;
+        size_t pos = 0;
+        while (pos < size) {
+            if (size - pos < 4)
+                return std::nullopt;
+            uint32_t length = 0;
+            for (int i = 0; i < 4; ++i)
+                length |= static_cast<uint32_t>(bytes[pos + i]) << (i * 8);
+            pos += 4;
+            if (size - pos < length)
+                return std::nullopt;
+            prompts.emplace_back(
+                reinterpret_cast<const char*>(bytes + pos), length
+            );
+            pos += length;
+        }
+        return ::make_prompt_list(std::move(prompts));
+    }
 
     struct CachedMetadata {
         std::string physical_path_;
@@ -194,7 +272,7 @@ namespace {
         int width_ = 0;
         int height_ = 0;
         std::string model_;
-        std::vector<std::string> prompts_;
+        PromptList prompts_;
     };
 
     using CachedTagAnalysis = sung::TagAnalysisRecord;
@@ -206,7 +284,7 @@ namespace {
         std::string parent_browser_path_;
         sung::ImageListResponse::FileInfo info_;
         std::string model_;
-        std::vector<std::string> prompts_;
+        PromptList prompts_;
         std::string logical_path_;
         std::string tag_input_path_;
         int64_t tag_input_size_ = 0;
@@ -214,6 +292,14 @@ namespace {
         std::vector<std::string> tags_;
     };
 
+    // An image queued for the tagger, as it looked when the batch was built
+    struct TagCandidate {
+        std::string logical_path_;
+        sung::Path input_path_;
+        int64_t input_size_ = 0;
+        int64_t input_modified_time_ = 0;
+    };
+
     struct IndexedFolder {
         std::string root_key_;
         std::string name_;
@@ -222,14 +308,113 @@ namespace {
         int64_t sort_time_ns_ = 0;
     };
 
+    // Tags saved by the tagger after a snapshot was published, by position
+    // in its `files_`. Commits write here in place instead of copying the
+    // whole snapshot. The next refresh folds them into `IndexedFile::tags_`.
+    class TagOverlay {
+
+    public:
+        // Held while reading with `find`
+        std::shared_lock<std::shared_mutex> lock() const {
+            return std::shared_lock{ mut_ };
+        }
+
+        const std::vector<std::string>* find(const size_t file_index) const {
+            if (tags_.empty())
+                return nullptr;
+            const auto found = tags_.find(file_index);
+            return found == tags_.end() ? nullptr : &found->second;
+        }
+
+        void set(const size_t file_index, std::vector<std::string> tags) {
+            std::unique_lock lock{ mut_ };
+            tags_.insert_or_assign(file_index, std::move(tags));
+        }
+
+    private:
+        mutable std::shared_mutex mut_;
+        std::unordered_map<size_t, std::vector<std::string>> tags_;
+    };
+
     struct IndexSnapshot {
         uint64_t generation_ = 0;
         std::vector<IndexedFile> files_;
+        // Positions in `files_` by the hash of their logical path. A source
+        // and its proxy share one, and hashes can collide, so check the path.
+        std::unordered_multimap<size_t, size_t> files_by_logical_path_;
+        std::shared_ptr<TagOverlay> tag_overlay_ =
+            std::make_shared<TagOverlay>();
         std::vector<IndexedFolder> folders_;
         std::set<std::string> namespaces_;
         std::unordered_map<std::string, int64_t> namespace_sort_times_;
     };
 
+    // Call once `files_` is final. Positions change, so it also starts a new
+    // overlay; fold the old one in first.
+    void index_files(IndexSnapshot& snapshot) {
+        snapshot.files_by_logical_path_.clear();
+        snapshot.files_by_logical_path_.reserve(snapshot.files_.size());
+        for (size_t i = 0; i < snapshot.files_.size(); ++i) {
+            snapshot.files_by_logical_path_.emplace(
+                std::hash<std::string>{}(snapshot.files_[i].logical_path_), i
+            );
+        }
+        snapshot.tag_overlay_ = std::make_shared<TagOverlay>();
+    }
+
+    std::vector<size_t> find_files(
+        const IndexSnapshot& snapshot, const std::string& logical_path
+    ) {
+        std::vector<size_t> output;
+        const auto [begin, end] = snapshot.files_by_logical_path_.equal_range(
+            std::hash<std::string>{}(logical_path)
+        );
+        for (auto it = begin; it != end; ++it) {
+            if (snapshot.files_[it->second].logical_path_ == logical_path)
+                output.push_back(it->second);
+        }
+        return output;
+    }
+
+    // The first listed file with this logical path that can be tagged
+    const IndexedFile* find_tag_input(
+        const IndexSnapshot& snapshot, const std::string& logical_path
+    ) {
+        const IndexedFile* output = nullptr;
+        auto first = snapshot.files_.size();
+        for (const auto index : ::find_files(snapshot, logical_path)) {
+            if (index < first && snapshot.files_[index].tag_input_size_ > 0) {
+                first = index;
+                output = &snapshot.files_[index];
+            }
+        }
+        return output;
+    }
+
+    // Whether a logical path lists the same files with the same tag inputs
+    // in both snapshots
+    bool same_tag_inputs(
+        const IndexSnapshot& before,
+        const IndexSnapshot& after,
+        const std::string& logical_path
+    ) {
+        const auto old_files = ::find_files(before, logical_path);
+        const auto new_files = ::find_files(after, logical_path);
+        if (old_files.size() != new_files.size())
+            return false;
+        return std::ranges::all_of(new_files, [&](const size_t new_index) {
+            const auto& file = after.files_[new_index];
+            return std::ranges::any_of(old_files, [&](const size_t old_index) {
+                const auto& old = before.files_[old_index];
+                return old.physical_path_ == file.physical_path_ &&
+                       old.tag_input_path_ == file.tag_input_path_ &&
+                       old.tag_input_size_ == file.tag_input_size_ &&
+                       old.tag_input_modified_time_ ==
+                           file.tag_input_modified_time_;
+            });
+        });
+    }
+
 
     bool file_before(const IndexedFile& a, const IndexedFile& b) {
         return sung::ImageListResponse::file_before(a.info_, b.info_);
@@ -267,24 +452,18 @@ namespace {
         ));
     }
 
-    std::optional<sung::FileFingerprint> validate_fingerprint(
-        const sung::Path& path,
-        const int64_t expected_size,
-        const int64_t expected_modified_time,
-        const std::string& expected_sha256
-    ) {
-        const auto metadata = sung::fingerprint_file(path);
-        if (!metadata || metadata->size_ != expected_size)
-            return std::nullopt;
-        if (metadata->modified_time_ == expected_modified_time) {
-            auto output = *metadata;
-            output.sha256_ = expected_sha256;
-            return output;
-        }
-        const auto fingerprint = sung::fingerprint_file_with_sha256(path);
-        if (!fingerprint || fingerprint->sha256_ != expected_sha256)
-            return std::nullopt;
-        return *fingerprint;
+    // Inode number, so a file swapped for another of the same size and time
+    // is hashed again. Windows only exposes its file index through an open
+    // handle, so there size and time have to do.
+    int64_t get_file_id(const sung::Path& path) {
+#if defined(SUNG_OS_WINDOWS)
+        return 0;
+#else
+        struct stat attributes{};
+        if (::stat(path.c_str(), &attributes) != 0)
+            return 0;
+        return static_cast<int64_t>(attributes.st_ino);
+#endif
     }
 
     std::string make_path_key(const sung::Path& path) {
@@ -299,7 +478,8 @@ namespace {
         const sung::Path& path,
         const int64_t size,
         const int64_t modified,
-        const int64_t sort_time_ns
+        const int64_t sort_time_ns,
+        sung::MetadataCache* metadata_cache
     ) {
         CachedMetadata output;
         output.physical_path_ = sung::tostr(path);
@@ -307,19 +487,35 @@ namespace {
         output.modified_time_ = modified;
         output.sort_time_ns_ = sort_time_ns;
 
+        // Lookup only: storing what a full scan parses would churn out the
+        // entries the details endpoint and the walker put there
+        if (metadata_cache) {
+            const auto stamp = sung::fingerprint_file(path);
+            const auto cached = stamp ? metadata_cache->find(path, *stamp)
+                                      : nullptr;
+            if (cached) {
+                output.eligible_ = true;
+                output.width_ = cached->width_;
+                output.height_ = cached->height_;
+                output.model_ = cached->model_;
+                output.prompts_ = ::make_prompt_list(cached->prompts_);
+                return output;
+            }
+        }
+
         sung::ImageInfo info{ path };
-        if (!info.load_simple_info())
+        if (!info.load_info_and_metadata())
             return output;
 
         output.eligible_ = true;
         output.width_ = static_cast<int>(info.width());
         output.height_ = static_cast<int>(info.height());
 
-        if (info.load_img_metadata() && info.parse_comfyui_workflow()) {
+        if (info.comfyui()) {
             info.parse_stable_diffusion_model();
             info.parse_stable_diffusion_prompt();
             output.model_ = info.sd().model_name_;
-            output.prompts_ = info.sd().prompt_;
+            output.prompts_ = ::make_prompt_list(info.sd().prompt_);
         }
 
         return output;
@@ -332,6 +528,10 @@ namespace {
     // there are cores, to overlap that latency instead of serializing it.
     constexpr int SCAN_CONCURRENCY = 32;
 
+    // Rows per metadata write-behind transaction, so an initial index of a
+    // large library does not hold the database lock for the whole commit
+    constexpr size_t METADATA_WRITE_BATCH = 4096;
+
     struct FileProbe {
         bool shadowed_ = false;
         bool stat_failed_ = false;
@@ -347,7 +547,8 @@ namespace {
         const sung::Path& physical_path,
         const bool shadowed_by_proxy,
         const sung::Path* sort_time_source,
-        const CachedMetadata* existing
+        const CachedMetadata* existing,
+        sung::MetadataCache* metadata_cache
     ) {
         FileProbe probe;
 
@@ -402,7 +603,7 @@ namespace {
             if (sort_time_ns == 0 && sort_time_source)
                 sort_time_ns = get_image_sort_time(physical_path);
             probe.metadata_ = inspect_file(
-                physical_path, size, modified, sort_time_ns
+                physical_path, size, modified, sort_time_ns, metadata_cache
             );
             probe.needs_persist_ = true;
         }
@@ -425,23 +626,157 @@ namespace {
         return false;
     }
 
+
+    struct StatementDeleter {
+        void operator()(sqlite3_stmt* statement) const {
+            sqlite3_finalize(statement);
+        }
+    };
+
+    // For statements run once, such as a migration, which should not stay
+    // compiled in the cache for the life of the connection
+    using OneShotStatement = std::unique_ptr<sqlite3_stmt, StatementDeleter>;
+
+    // Empty if the statement does not compile
+    OneShotStatement prepare_once(sqlite3* database, const char* sql) {
+        sqlite3_stmt* statement = nullptr;
+        if (sqlite3_prepare_v2(database, sql, -1, &statement, nullptr) !=
+            SQLITE_OK) {
+            std::println(
+                "ImageIndex: Cannot prepare statement: {}",
+                sqlite3_errmsg(database)
+            );
+            sqlite3_finalize(statement);
+            return nullptr;
+        }
+        return OneShotStatement{ statement };
+    }
+
+
+    // Reset and unbound when it goes out of scope, ready for the next user
+    class CachedStatement {
+
+    public:
+        CachedStatement() = default;
+        explicit CachedStatement(sqlite3_stmt* statement)
+            : statement_(statement) {}
+
+        ~CachedStatement() {
+            if (statement_) {
+                sqlite3_reset(statement_);
+                sqlite3_clear_bindings(statement_);
+            }
+        }
+
+        CachedStatement(const CachedStatement&) = delete;
+        CachedStatement& operator=(const CachedStatement&) = delete;
+
+        sqlite3_stmt* get() const { return statement_; }
+        explicit operator bool() const { return statement_ != nullptr; }
+
+    private:
+        sqlite3_stmt* statement_ = nullptr;
+    };
+
+
+    // Prepared statements keyed by their SQL text, compiled on first use
+    // and kept until the connection closes. Single statements only; schema
+    // scripts go through `execute_sql`. Not thread safe, callers hold the
+    // database lock.
+    class StatementCache {
+
+    public:
+        StatementCache() = default;
+        ~StatementCache() { this->clear(); }
+
+        StatementCache(const StatementCache&) = delete;
+        StatementCache& operator=(const StatementCache&) = delete;
+
+        // Empty if the statement does not compile
+        CachedStatement get(sqlite3* database, const std::string_view sql) {
+            if (const auto found = statements_.find(sql);
+                found != statements_.end()) {
+                return CachedStatement{ found->second };
+            }
+
+            sqlite3_stmt* statement = nullptr;
+            if (sqlite3_prepare_v3(
+                    database,
+                    sql.data(),
+                    static_cast<int>(sql.size()),
+                    SQLITE_PREPARE_PERSISTENT,
+                    &statement,
+                    nullptr
+                ) != SQLITE_OK) {
+                std::println(
+                    "ImageIndex: Cannot prepare statement: {}",
+                    sqlite3_errmsg(database)
+                );
+                sqlite3_finalize(statement);
+                return {};
+            }
+            statements_.emplace(std::string{ sql }, statement);
+            return CachedStatement{ statement };
+        }
+
+        // Runs a statement that returns no rows, such as `COMMIT;`
+        bool execute(sqlite3* database, const std::string_view sql) {
+            const auto statement = this->get(database, sql);
+            return statement && sqlite3_step(statement.get()) == SQLITE_DONE;
+        }
+
+        // Must be called before the connection is closed
+        void clear() {
+            for (auto& [sql, statement] : statements_)
+                sqlite3_finalize(statement);
+            statements_.clear();
+        }
+
+    private:
+        struct SqlHash {
+            using is_transparent = void;
+            size_t operator()(const std::string_view sql) const {
+                return std::hash<std::string_view>{}(sql);
+            }
+        };
+
+        std::unordered_map<std::string, sqlite3_stmt*, SqlHash, std::equal_to<>>
+            statements_;
+    };
+
 }  // namespace
 
 
 class sung::ImageIndex::Impl {
 
 public:
-    explicit Impl(Path database_path)
-        : database_path_(std::move(database_path)) {
+    Impl(Path database_path, sung::MetadataCache* metadata_cache)
+        : database_path_(std::move(database_path))
+        , metadata_cache_(metadata_cache) {
         snapshot_ = std::make_shared<const IndexSnapshot>();
+        metadata_writer_ = std::thread([this]() { this->write_metadata(); });
     }
 
     ~Impl() {
+        {
+            std::lock_guard lock{ write_mutex_ };
+            write_stop_ = true;
+        }
+        write_cv_.notify_all();
+        if (metadata_writer_.joinable())
+            metadata_writer_.join();
+        close_database();
+    }
+
+    void close_database() {
+        statements_.clear();
         if (database_)
             sqlite3_close(database_);
+        database_ = nullptr;
     }
 
-    void open_database() {
+    void open_database(const ServerConfigs& configs) {
+        std::lock_guard database_lock{ database_mutex_ };
         std::error_code ec;
         const auto parent = database_path_.parent_path();
         if (!parent.empty())
@@ -467,28 +802,44 @@ public:
                 path_str,
                 database_ ? sqlite3_errmsg(database_) : "unknown error"
             );
-            if (database_)
-                sqlite3_close(database_);
-            database_ = nullptr;
+            close_database();
             return;
         }
 
-        if (!execute_sql(database_, "PRAGMA journal_mode=WAL;") ||
+        // The page size only applies to a database file without tables yet
+        const auto page_size = std::format(
+            "PRAGMA page_size={};", configs.index_page_size_
+        );
+        if (!execute_sql(database_, page_size.c_str()) ||
+            !execute_sql(database_, "PRAGMA journal_mode=WAL;") ||
             !execute_sql(database_, "PRAGMA synchronous=NORMAL;")) {
-            sqlite3_close(database_);
-            database_ = nullptr;
+            close_database();
             return;
         }
 
+        // Tuning only, so failures are not fatal
+        constexpr int64_t MEBIBYTE = 1024 * 1024;
+        const auto mmap_size = std::format(
+            "PRAGMA mmap_size={};", configs.index_mmap_size_mb_ * MEBIBYTE
+        );
+        execute_sql(database_, mmap_size.c_str());
+        if (configs.index_cache_size_mb_ > 0) {
+            // Negative sizes are in KiB rather than pages
+            const auto cache_size = std::format(
+                "PRAGMA cache_size=-{};", configs.index_cache_size_mb_ * 1024
+            );
+            execute_sql(database_, cache_size.c_str());
+        }
+        if (configs.index_temp_store_memory_)
+            execute_sql(database_, "PRAGMA temp_store=MEMORY;");
+
         int schema_version = 0;
-        sqlite3_stmt* statement = nullptr;
-        if (sqlite3_prepare_v2(
-                database_, "PRAGMA user_version;", -1, &statement, nullptr
-            ) == SQLITE_OK &&
-            sqlite3_step(statement) == SQLITE_ROW) {
-            schema_version = sqlite3_column_int(statement, 0);
+        if (const auto statement = statements_.get(
+                database_, "PRAGMA user_version;"
+            );
+            statement && sqlite3_step(statement.get()) == SQLITE_ROW) {
+            schema_version = sqlite3_column_int(statement.get(), 0);
         }
-        sqlite3_finalize(statement);
 
         if (schema_version == 1) {
             if (!execute_sql(
@@ -499,8 +850,7 @@ public:
                     "PRAGMA user_version=2;"
                     "COMMIT;"
                 )) {
-                sqlite3_close(database_);
-                database_ = nullptr;
+                close_database();
                 return;
             }
             schema_version = 2;
@@ -536,14 +886,33 @@ public:
             "proxy_materialization_id TEXT NOT NULL DEFAULT ''"
             ");";
 
+        // Rendered `/api/images/details` payloads, filled on first view
+        const char* create_details_table =
+            "CREATE TABLE IF NOT EXISTS image_details ("
+            "physical_path TEXT PRIMARY KEY,"
+            "file_size INTEGER NOT NULL,"
+            "modified_time INTEGER NOT NULL,"
+            "payload TEXT NOT NULL"
+            ");";
+
+        // SHA-256 of files hashed before, reused while the file keeps the
+        // same size, modification time and id
+        const char* create_hash_table =
+            "CREATE TABLE IF NOT EXISTS content_hashes ("
+            "physical_path TEXT PRIMARY KEY,"
+            "file_size INTEGER NOT NULL,"
+            "modified_time INTEGER NOT NULL,"
+            "file_id INTEGER NOT NULL,"
+            "sha256 TEXT NOT NULL"
+            ");";
+
         if (schema_version == 2) {
             if (!execute_sql(database_, "BEGIN IMMEDIATE;") ||
                 !execute_sql(database_, create_tag_table) ||
                 !execute_sql(database_, "PRAGMA user_version=5;") ||
                 !execute_sql(database_, "COMMIT;")) {
                 execute_sql(database_, "ROLLBACK;");
-                sqlite3_close(database_);
-                database_ = nullptr;
+                close_database();
                 return;
             }
             schema_version = 5;
@@ -558,19 +927,29 @@ public:
                 !execute_sql(database_, "PRAGMA user_version=5;") ||
                 !execute_sql(database_, "COMMIT;")) {
                 execute_sql(database_, "ROLLBACK;");
-                sqlite3_close(database_);
-                database_ = nullptr;
+                close_database();
                 return;
             }
             schema_version = 5;
         }
 
+        if (schema_version == 5) {
+            if (!this->migrate_prompts_to_blob()) {
+                execute_sql(database_, "ROLLBACK;");
+                close_database();
+                return;
+            }
+            schema_version = 6;
+        }
+
         if (schema_version != DATABASE_SCHEMA_VERSION) {
             if (!execute_sql(
                     database_,
                     "BEGIN;"
                     "DROP TABLE IF EXISTS image_metadata;"
                     "DROP TABLE IF EXISTS image_tag_analysis;"
+                    "DROP TABLE IF EXISTS image_details;"
+                    "DROP TABLE IF EXISTS content_hashes;"
                     "CREATE TABLE image_metadata ("
                     "physical_path TEXT PRIMARY KEY,"
                     "file_size INTEGER NOT NULL,"
@@ -580,15 +959,16 @@ public:
                     "width INTEGER NOT NULL,"
                     "height INTEGER NOT NULL,"
                     "model TEXT NOT NULL,"
-                    "prompts_json TEXT NOT NULL"
+                    "prompts_blob BLOB NOT NULL"
                     ");"
                 ) ||
                 !execute_sql(database_, create_tag_table) ||
-                !execute_sql(database_, "PRAGMA user_version=5;") ||
+                !execute_sql(database_, create_details_table) ||
+                !execute_sql(database_, create_hash_table) ||
+                !execute_sql(database_, "PRAGMA user_version=6;") ||
                 !execute_sql(database_, "COMMIT;")) {
                 execute_sql(database_, "ROLLBACK;");
-                sqlite3_close(database_);
-                database_ = nullptr;
+                close_database();
                 return;
             }
         } else if (
@@ -603,13 +983,14 @@ public:
                 "width INTEGER NOT NULL,"
                 "height INTEGER NOT NULL,"
                 "model TEXT NOT NULL,"
-                "prompts_json TEXT NOT NULL"
+                "prompts_blob BLOB NOT NULL"
                 ");"
             ) ||
-            !execute_sql(database_, create_tag_table)
+            !execute_sql(database_, create_tag_table) ||
+            !execute_sql(database_, create_details_table) ||
+            !execute_sql(database_, create_hash_table)
         ) {
-            sqlite3_close(database_);
-            database_ = nullptr;
+            close_database();
             return;
         }
 
@@ -617,25 +998,95 @@ public:
         load_tag_analyses();
     }
 
+    // Schema six stores prompts as `encode_prompts` blobs instead of JSON
+    // text. Rewrites the column in place so the metadata stays cached.
+    bool migrate_prompts_to_blob() {
+        if (!execute_sql(database_, "BEGIN IMMEDIATE;") ||
+            !execute_sql(
+                database_,
+                "ALTER TABLE image_metadata ADD COLUMN prompts_blob BLOB NOT "
+                "NULL DEFAULT x'';"
+            )) {
+            return false;
+        }
+
+        {
+            // Scoped so both statements are finalized before the column drop
+            const auto select = ::prepare_once(
+                database_,
+                "SELECT physical_path, prompts_json FROM image_metadata;"
+            );
+            const auto update = ::prepare_once(
+                database_,
+                "UPDATE image_metadata SET prompts_blob=? "
+                "WHERE physical_path=?;"
+            );
+            if (!select || !update)
+                return false;
+
+            while (sqlite3_step(select.get()) == SQLITE_ROW) {
+                PromptList prompts;
+                try {
+                    const auto* prompts_text = reinterpret_cast<const char*>(
+                        sqlite3_column_text(select.get(), 1)
+                    );
+                    prompts = ::make_prompt_list(
+                        nlohmann::json::parse(prompts_text)
+                            .get<std::vector<std::string>>()
+                    );
+                } catch (const std::exception&) {
+                    prompts = nullptr;
+                }
+
+                const auto blob = ::encode_prompts(prompts);
+                sqlite3_bind_blob(
+                    update.get(),
+                    1,
+                    blob.data(),
+                    static_cast<int>(blob.size()),
+                    SQLITE_TRANSIENT
+                );
+                sqlite3_bind_text(
+                    update.get(),
+                    2,
+                    reinterpret_cast<const char*>(
+                        sqlite3_column_text(select.get(), 0)
+                    ),
+                    -1,
+                    SQLITE_TRANSIENT
+                );
+                const auto result = sqlite3_step(update.get());
+                sqlite3_reset(update.get());
+                if (result != SQLITE_DONE)
+                    return false;
+            }
+        }
+
+        return execute_sql(
+                   database_,
+                   "ALTER TABLE image_metadata DROP COLUMN prompts_json;"
+               ) &&
+               execute_sql(database_, "PRAGMA user_version=6;") &&
+               execute_sql(database_, "COMMIT;");
+    }
+
     void load_metadata() {
         if (!database_)
             return;
 
-        sqlite3_stmt* statement = nullptr;
-        if (sqlite3_prepare_v2(
-                database_,
-                "SELECT physical_path, file_size, modified_time, sort_time_ns, "
-                "eligible, width, height, model, prompts_json FROM "
-                "image_metadata;",
-                -1,
-                &statement,
-                nullptr
-            ) != SQLITE_OK) {
+        const auto cached = statements_.get(
+            database_,
+            "SELECT physical_path, file_size, modified_time, sort_time_ns, "
+            "eligible, width, height, model, prompts_blob FROM "
+            "image_metadata;"
+        );
+        if (!cached) {
             std::println(
                 "ImageIndex: Cannot load cache: {}", sqlite3_errmsg(database_)
             );
             return;
         }
+        auto* statement = cached.get();
 
         while (sqlite3_step(statement) == SQLITE_ROW) {
             CachedMetadata metadata;
@@ -652,25 +1103,22 @@ public:
                 sqlite3_column_text(statement, 7)
             );
 
-            try {
-                const auto* prompts_text = reinterpret_cast<const char*>(
-                    sqlite3_column_text(statement, 8)
-                );
-                metadata.prompts_ = nlohmann::json::parse(prompts_text)
-                                        .get<std::vector<std::string>>();
-            } catch (const std::exception&) {
-                metadata.prompts_.clear();
-            }
+            // Leaving a damaged row out makes the next refresh reparse it
+            auto prompts = ::decode_prompts(
+                sqlite3_column_blob(statement, 8),
+                static_cast<size_t>(sqlite3_column_bytes(statement, 8))
+            );
+            if (!prompts)
+                continue;
+            metadata.prompts_ = std::move(*prompts);
             metadata_[metadata.physical_path_] = std::move(metadata);
         }
-        sqlite3_finalize(statement);
     }
 
     void load_tag_analyses() {
         if (!database_)
             return;
 
-        sqlite3_stmt* statement = nullptr;
         const char* query =
             "SELECT logical_path, input_kind, input_path, input_size, "
             "input_modified_time, input_sha256, analyzer_fingerprint, "
@@ -682,14 +1130,15 @@ public:
             "sidecar_path, proxy_path, proxy_size, proxy_modified_time, "
             "proxy_sha256, proxy_materialization_id "
             "FROM image_tag_analysis;";
-        if (sqlite3_prepare_v2(database_, query, -1, &statement, nullptr) !=
-            SQLITE_OK) {
+        const auto cached = statements_.get(database_, query);
+        if (!cached) {
             std::println(
                 "ImageIndex: Cannot load tag cache: {}",
                 sqlite3_errmsg(database_)
             );
             return;
         }
+        auto* statement = cached.get();
 
         while (sqlite3_step(statement) == SQLITE_ROW) {
             CachedTagAnalysis analysis;
@@ -765,33 +1214,25 @@ public:
                 analysis.logical_path_, std::move(analysis)
             );
         }
-        sqlite3_finalize(statement);
     }
 
     bool persist_changes(
         const std::vector<CachedMetadata>& changed,
-        const std::vector<std::string>& removed,
-        const bool replace_all
+        const std::vector<std::string>& removed
     ) {
+        std::lock_guard database_lock{ database_mutex_ };
         if (!database_)
-            return false;
-        if (changed.empty() && removed.empty() && !replace_all)
             return true;
-        if (!execute_sql(database_, "BEGIN IMMEDIATE;"))
-            return false;
-
-        if (replace_all &&
-            !execute_sql(database_, "DELETE FROM image_metadata;")) {
-            execute_sql(database_, "ROLLBACK;");
+        if (changed.empty() && removed.empty())
+            return true;
+        if (!statements_.execute(database_, "BEGIN IMMEDIATE;"))
             return false;
-        }
 
-        sqlite3_stmt* upsert = nullptr;
-        sqlite3_stmt* erase = nullptr;
-        const auto upsert_sql =
+        const auto upsert = statements_.get(
+            database_,
             "INSERT INTO image_metadata "
             "(physical_path, file_size, modified_time, sort_time_ns, eligible, "
-            "width, height, model, prompts_json) VALUES (?, ?, ?, ?, ?, ?, ?, "
+            "width, height, model, prompts_blob) VALUES (?, ?, ?, ?, ?, ?, ?, "
             "?, ?) "
             "ON CONFLICT(physical_path) DO UPDATE SET "
             "file_size=excluded.file_size, "
@@ -799,63 +1240,181 @@ public:
             "sort_time_ns=excluded.sort_time_ns, "
             "eligible=excluded.eligible, width=excluded.width, "
             "height=excluded.height, model=excluded.model, "
-            "prompts_json=excluded.prompts_json;";
-
-        bool success = sqlite3_prepare_v2(
-                           database_, upsert_sql, -1, &upsert, nullptr
-                       ) == SQLITE_OK &&
-                       sqlite3_prepare_v2(
-                           database_,
-                           "DELETE FROM image_metadata WHERE physical_path=?;",
-                           -1,
-                           &erase,
-                           nullptr
-                       ) == SQLITE_OK;
+            "prompts_blob=excluded.prompts_blob;"
+        );
+        const auto erase = statements_.get(
+            database_, "DELETE FROM image_metadata WHERE physical_path=?;"
+        );
+        const auto erase_details = statements_.get(
+            database_, "DELETE FROM image_details WHERE physical_path=?;"
+        );
+        const auto erase_hash = statements_.get(
+            database_, "DELETE FROM content_hashes WHERE physical_path=?;"
+        );
+        bool success = upsert && erase && erase_details && erase_hash;
 
         for (const auto& item : changed) {
             if (!success)
                 break;
-            const auto prompts = nlohmann::json(item.prompts_).dump();
+            auto* statement = upsert.get();
+            const auto prompts = ::encode_prompts(item.prompts_);
             sqlite3_bind_text(
-                upsert, 1, item.physical_path_.c_str(), -1, SQLITE_TRANSIENT
+                statement, 1, item.physical_path_.c_str(), -1, SQLITE_TRANSIENT
             );
-            sqlite3_bind_int64(upsert, 2, item.file_size_);
-            sqlite3_bind_int64(upsert, 3, item.modified_time_);
-            sqlite3_bind_int64(upsert, 4, item.sort_time_ns_);
-            sqlite3_bind_int(upsert, 5, item.eligible_ ? 1 : 0);
-            sqlite3_bind_int(upsert, 6, item.width_);
-            sqlite3_bind_int(upsert, 7, item.height_);
+            sqlite3_bind_int64(statement, 2, item.file_size_);
+            sqlite3_bind_int64(statement, 3, item.modified_time_);
+            sqlite3_bind_int64(statement, 4, item.sort_time_ns_);
+            sqlite3_bind_int(statement, 5, item.eligible_ ? 1 : 0);
+            sqlite3_bind_int(statement, 6, item.width_);
+            sqlite3_bind_int(statement, 7, item.height_);
             sqlite3_bind_text(
-                upsert, 8, item.model_.c_str(), -1, SQLITE_TRANSIENT
+                statement, 8, item.model_.c_str(), -1, SQLITE_TRANSIENT
             );
-            sqlite3_bind_text(upsert, 9, prompts.c_str(), -1, SQLITE_TRANSIENT);
-            success = sqlite3_step(upsert) == SQLITE_DONE;
-            sqlite3_reset(upsert);
-            sqlite3_clear_bindings(upsert);
+            sqlite3_bind_blob(
+                statement,
+                9,
+                prompts.data(),
+                static_cast<int>(prompts.size()),
+                SQLITE_TRANSIENT
+            );
+            success = sqlite3_step(statement) == SQLITE_DONE;
+            sqlite3_reset(statement);
+            sqlite3_clear_bindings(statement);
         }
 
         for (const auto& path : removed) {
-            if (!success)
-                break;
-            sqlite3_bind_text(erase, 1, path.c_str(), -1, SQLITE_TRANSIENT);
-            success = sqlite3_step(erase) == SQLITE_DONE;
-            sqlite3_reset(erase);
-            sqlite3_clear_bindings(erase);
+            for (const auto* cached : { &erase, &erase_details, &erase_hash }) {
+                if (!success)
+                    break;
+                auto* statement = cached->get();
+                sqlite3_bind_text(
+                    statement, 1, path.c_str(), -1, SQLITE_TRANSIENT
+                );
+                success = sqlite3_step(statement) == SQLITE_DONE;
+                sqlite3_reset(statement);
+                sqlite3_clear_bindings(statement);
+            }
         }
 
-        sqlite3_finalize(upsert);
-        sqlite3_finalize(erase);
         if (success)
-            success = execute_sql(database_, "COMMIT;");
+            success = statements_.execute(database_, "COMMIT;");
         else
-            execute_sql(database_, "ROLLBACK;");
+            statements_.execute(database_, "ROLLBACK;");
         return success;
     }
 
+    // Hands metadata changes to the write-behind thread, which also retries
+    // any batch that failed before. Later changes to a path replace pending
+    // ones.
+    void enqueue_metadata_writes(
+        std::vector<CachedMetadata> changed,
+        const std::vector<std::string>& removed
+    ) {
+        {
+            std::lock_guard lock{ write_mutex_ };
+            for (auto& item : changed) {
+                auto key = item.physical_path_;
+                pending_writes_.insert_or_assign(
+                    std::move(key), std::move(item)
+                );
+            }
+            for (const auto& path : removed)
+                pending_writes_.insert_or_assign(path, std::nullopt);
+            write_ready_ = true;
+        }
+        write_cv_.notify_all();
+    }
+
+    void flush_metadata_writes() {
+        std::unique_lock lock{ write_mutex_ };
+        write_idle_cv_.wait(lock, [this] {
+            return !write_busy_ && (pending_writes_.empty() || !write_ready_);
+        });
+    }
+
+    // Body of `metadata_writer_`. A failed batch stays in `pending_writes_`
+    // as the dirty journal and is retried along with the next refresh's
+    // changes, rather than rewriting the whole table.
+    void write_metadata() {
+        std::unique_lock lock{ write_mutex_ };
+        while (true) {
+            write_cv_.wait(lock, [this] {
+                return write_stop_ || write_ready_;
+            });
+            if (pending_writes_.empty() || !write_ready_) {
+                write_ready_ = false;
+                write_idle_cv_.notify_all();
+                if (write_stop_)
+                    break;
+                continue;
+            }
+
+            std::vector<CachedMetadata> changed;
+            std::vector<std::string> removed;
+            std::vector<decltype(pending_writes_)::node_type> batch;
+            while (!pending_writes_.empty() &&
+                   batch.size() < METADATA_WRITE_BATCH) {
+                auto& node = batch.emplace_back(
+                    pending_writes_.extract(pending_writes_.begin())
+                );
+                if (node.mapped())
+                    changed.push_back(*node.mapped());
+                else
+                    removed.push_back(node.key());
+            }
+
+            write_busy_ = true;
+            lock.unlock();
+            const auto success = persist_changes(changed, removed);
+            lock.lock();
+            write_busy_ = false;
+
+            if (!success) {
+                std::println(
+                    "ImageIndex: Cache update of {} rows failed; retrying "
+                    "after the next refresh.",
+                    batch.size()
+                );
+                // Keep anything queued meanwhile, it is newer
+                for (auto& node : batch)
+                    pending_writes_.insert(std::move(node));
+                write_ready_ = false;
+                write_idle_cv_.notify_all();
+            }
+        }
+    }
+
     bool persist_tag_analysis(const CachedTagAnalysis& item) {
+        std::lock_guard database_lock{ database_mutex_ };
         if (!database_)
             return true;
+        return upsert_tag_analysis(item);
+    }
+
+    // One transaction for the lot, so a tagger batch costs a single commit
+    bool persist_tag_analyses(const std::vector<CachedTagAnalysis>& items) {
+        std::lock_guard database_lock{ database_mutex_ };
+        if (!database_ || items.empty())
+            return true;
+        if (!statements_.execute(database_, "BEGIN IMMEDIATE;"))
+            return false;
+
+        bool success = true;
+        for (const auto& item : items) {
+            success = upsert_tag_analysis(item);
+            if (!success)
+                break;
+        }
+
+        if (success)
+            success = statements_.execute(database_, "COMMIT;");
+        else
+            statements_.execute(database_, "ROLLBACK;");
+        return success;
+    }
 
+    // Callers hold `database_mutex_`
+    bool upsert_tag_analysis(const CachedTagAnalysis& item) {
         const char* sql =
             "INSERT INTO image_tag_analysis ("
             "logical_path, input_kind, input_path, input_size, "
@@ -896,11 +1455,10 @@ public:
             "proxy_sha256=excluded.proxy_sha256, "
             "proxy_materialization_id=excluded.proxy_materialization_id;";
 
-        sqlite3_stmt* statement = nullptr;
-        if (sqlite3_prepare_v2(database_, sql, -1, &statement, nullptr) !=
-            SQLITE_OK) {
+        const auto cached = statements_.get(database_, sql);
+        if (!cached)
             return false;
-        }
+        auto* statement = cached.get();
 
         const auto analysis_json = item.analysis_.is_null()
                                        ? std::string{}
@@ -937,30 +1495,120 @@ public:
         bind_text(25, item.proxy_sha256_);
         bind_text(26, item.proxy_materialization_id_);
 
-        const auto success = sqlite3_step(statement) == SQLITE_DONE;
-        sqlite3_finalize(statement);
-        return success;
+        return sqlite3_step(statement) == SQLITE_DONE;
     }
 
     bool erase_tag_analysis(const std::string& logical_path) {
+        std::lock_guard database_lock{ database_mutex_ };
         if (!database_)
             return true;
-        sqlite3_stmt* statement = nullptr;
-        if (sqlite3_prepare_v2(
-                database_,
-                "DELETE FROM image_tag_analysis WHERE logical_path=?;",
-                -1,
-                &statement,
-                nullptr
-            ) != SQLITE_OK) {
+        const auto statement = statements_.get(
+            database_, "DELETE FROM image_tag_analysis WHERE logical_path=?;"
+        );
+        if (!statement)
             return false;
+        sqlite3_bind_text(
+            statement.get(), 1, logical_path.c_str(), -1, SQLITE_TRANSIENT
+        );
+        return sqlite3_step(statement.get()) == SQLITE_DONE;
+    }
+
+    // Takes only `database_mutex_`, so a details request is not held up
+    // by a scan in progress
+    std::optional<std::string> find_details(
+        const Path& physical_path, const FileFingerprint& stamp
+    ) const {
+        std::lock_guard database_lock{ database_mutex_ };
+        if (!database_)
+            return std::nullopt;
+
+        const auto cached = statements_.get(
+            database_,
+            "SELECT payload FROM image_details WHERE physical_path=? AND "
+            "file_size=? AND modified_time=?;"
+        );
+        if (!cached)
+            return std::nullopt;
+        auto* statement = cached.get();
+
+        const auto path_str = sung::tostr(physical_path);
+        sqlite3_bind_text(
+            statement, 1, path_str.c_str(), -1, SQLITE_TRANSIENT
+        );
+        sqlite3_bind_int64(statement, 2, stamp.size_);
+        sqlite3_bind_int64(statement, 3, stamp.modified_time_);
+
+        std::optional<std::string> output;
+        if (sqlite3_step(statement) == SQLITE_ROW) {
+            const auto* text = reinterpret_cast<const char*>(
+                sqlite3_column_text(statement, 0)
+            );
+            output.emplace(text, sqlite3_column_bytes(statement, 0));
         }
+        return output;
+    }
+
+    bool store_details(
+        const Path& physical_path,
+        const FileFingerprint& stamp,
+        const std::string_view payload
+    ) {
+        std::lock_guard database_lock{ database_mutex_ };
+        if (!database_)
+            return false;
+
+        const auto cached = statements_.get(
+            database_,
+            "INSERT INTO image_details "
+            "(physical_path, file_size, modified_time, payload) "
+            "VALUES (?, ?, ?, ?) "
+            "ON CONFLICT(physical_path) DO UPDATE SET "
+            "file_size=excluded.file_size, "
+            "modified_time=excluded.modified_time, "
+            "payload=excluded.payload;"
+        );
+        if (!cached)
+            return false;
+        auto* statement = cached.get();
+
+        const auto path_str = sung::tostr(physical_path);
         sqlite3_bind_text(
-            statement, 1, logical_path.c_str(), -1, SQLITE_TRANSIENT
+            statement, 1, path_str.c_str(), -1, SQLITE_TRANSIENT
         );
-        const auto success = sqlite3_step(statement) == SQLITE_DONE;
-        sqlite3_finalize(statement);
-        return success;
+        sqlite3_bind_int64(statement, 2, stamp.size_);
+        sqlite3_bind_int64(statement, 3, stamp.modified_time_);
+        sqlite3_bind_text(
+            statement,
+            4,
+            payload.data(),
+            static_cast<int>(payload.size()),
+            SQLITE_TRANSIENT
+        );
+        return sqlite3_step(statement) == SQLITE_DONE;
+    }
+
+    // `fingerprint_file_with_sha256`, but a file that kept its size,
+    // modification time and id since it was last hashed is not read again
+    std::expected<FileFingerprint, std::string> hash_file(
+        const Path& path
+    ) const {
+        const auto current = sung::fingerprint_file(path);
+        if (!current)
+            return std::unexpected(current.error());
+        const auto path_str = sung::tostr(path);
+        const auto file_id = ::get_file_id(path);
+        if (auto sha256 = find_content_hash(path_str, *current, file_id)) {
+            auto output = *current;
+            output.sha256_ = std::move(*sha256);
+            return output;
+        }
+
+        auto hashed = sung::fingerprint_file_with_sha256(path);
+        if (hashed && hashed->size_ == current->size_ &&
+            hashed->modified_time_ == current->modified_time_) {
+            store_content_hash(path_str, *hashed, file_id);
+        }
+        return hashed;
     }
 
     ImageIndexRefreshStats refresh(
@@ -987,6 +1635,7 @@ public:
         std::unordered_map<std::string, size_t> seen_folder_paths;
         std::unordered_map<std::string, Path> seen_sidecars;
         std::vector<CachedMetadata> changed;
+        std::vector<CachedTagAnalysis> imported_analyses;
         bool all_roots_accessible = true;
 
         const auto add_folder = [&](IndexedFolder folder) {
@@ -1005,11 +1654,18 @@ public:
         };
 
         const auto preserve_root = [&](const std::string& root_key) {
-            for (const auto& file : old_snapshot->files_) {
+            const auto& overlay = *old_snapshot->tag_overlay_;
+            const auto overlay_lock = overlay.lock();
+            for (size_t i = 0; i < old_snapshot->files_.size(); ++i) {
+                const auto& file = old_snapshot->files_[i];
                 if (file.root_key_ != root_key)
                     continue;
-                if (seen_api_paths.insert(sung::tostr(file.info_.path_)).second)
-                    next->files_.push_back(file);
+                if (seen_api_paths.insert(sung::tostr(file.info_.path_))
+                        .second) {
+                    auto& copy = next->files_.emplace_back(file);
+                    if (const auto tags = overlay.find(i))
+                        copy.tags_ = *tags;
+                }
                 seen_physical.insert(file.physical_path_);
             }
             for (const auto& folder : old_snapshot->folders_) {
@@ -1120,6 +1776,10 @@ public:
                 for (auto& folder : root_folders) add_folder(std::move(folder));
 
                 for (const auto& sidecar_path : sidecar_files) {
+                    // The file lags the analysis already held in memory
+                    if (sidecar_writer_.pending(sidecar_path))
+                        continue;
+
                     const auto parsed = sung::read_tag_sidecar(sidecar_path);
                     if (!parsed) {
                         std::println(
@@ -1185,7 +1845,7 @@ public:
                     }
 
                     auto imported = *parsed;
-                    if (const auto fingerprint = ::validate_fingerprint(
+                    if (const auto fingerprint = this->validate_fingerprint(
                             sung::fromstr(imported.input_path_),
                             imported.input_size_,
                             imported.input_modified_time_,
@@ -1196,7 +1856,7 @@ public:
                             fingerprint->modified_time_;
                     }
                     if (!imported.proxy_path_.empty()) {
-                        if (const auto fingerprint = ::validate_fingerprint(
+                        if (const auto fingerprint = this->validate_fingerprint(
                                 sung::fromstr(imported.proxy_path_),
                                 imported.proxy_size_,
                                 imported.proxy_modified_time_,
@@ -1222,15 +1882,13 @@ public:
                             existing->second.failure_count_;
                         imported.last_error_ = existing->second.last_error_;
                     }
+                    // The imported input may differ from the file on disk,
+                    // so let the next poll judge it
+                    tag_pending_.insert(imported.logical_path_);
                     tag_analyses_.insert_or_assign(
                         imported.logical_path_, imported
                     );
-                    if (!persist_tag_analysis(imported)) {
-                        std::println(
-                            "ImageIndex: Failed to cache tag sidecar {}",
-                            sung::tostr(sidecar_path)
-                        );
-                    }
+                    imported_analyses.push_back(std::move(imported));
                 }
 
                 for (const auto& path : physical_files) {
@@ -1321,7 +1979,8 @@ public:
                                     paired_sources.contains(path_key) ||
                                         stale_proxies.contains(path_key),
                                     sort_time_source,
-                                    existing
+                                    existing,
+                                    metadata_cache_
                                 );
                             }
                         }
@@ -1429,6 +2088,13 @@ public:
             }
         }
 
+        if (!persist_tag_analyses(imported_analyses)) {
+            std::println(
+                "ImageIndex: Failed to cache {} tag sidecars",
+                imported_analyses.size()
+            );
+        }
+
         std::vector<std::string> removed;
         for (auto it = metadata_.begin(); it != metadata_.end();) {
             if (seen_physical.contains(it->first)) {
@@ -1479,7 +2145,7 @@ public:
                 if (const auto sidecar = seen_sidecars.find(it->first);
                     sidecar != seen_sidecars.end()) {
                     std::error_code sidecar_error;
-                    fs::remove(sidecar->second, sidecar_error);
+                    sidecar_writer_.remove(sidecar->second, sidecar_error);
                     if (sidecar_error) {
                         std::println(
                             "ImageIndex: Failed to remove orphan tag sidecar "
@@ -1493,28 +2159,12 @@ public:
             }
         }
 
-        if (database_) {
-            std::vector<CachedMetadata> persistence_items;
-            if (database_dirty_) {
-                persistence_items.reserve(metadata_.size());
-                for (const auto& [path, metadata] : metadata_)
-                    persistence_items.push_back(metadata);
-            } else {
-                persistence_items = changed;
-            }
-
-            if (!persist_changes(persistence_items, removed, database_dirty_)) {
-                database_dirty_ = true;
-                std::println(
-                    "ImageIndex: Cache update failed; continuing with memory "
-                    "snapshot and retrying on the next refresh."
-                );
-            } else {
-                database_dirty_ = false;
-            }
-        }
-
         std::sort(next->files_.begin(), next->files_.end(), file_before);
+        ::index_files(*next);
+        for (const auto& file : next->files_) {
+            if (!::same_tag_inputs(*old_snapshot, *next, file.logical_path_))
+                tag_pending_.insert(file.logical_path_);
+        }
         std::sort(
             next->folders_.begin(),
             next->folders_.end(),
@@ -1529,6 +2179,8 @@ public:
         stats.folders_available_ = next->folders_.size();
         stats.elapsed_seconds_ = timer.elapsed();
         store_snapshot(std::move(next));
+        if (database_)
+            enqueue_metadata_writes(std::move(changed), removed);
 
         std::println(
             "ImageIndex: {} images, {} folders ({} reused, {} indexed, "
@@ -1547,9 +2199,26 @@ public:
         if (!configs->tagger_enabled_)
             return;
 
-        const TaggerClient client{ configs->tagger_host_,
-                                   configs->tagger_port_ };
-        const auto info = client.get_info();
+        const auto slot_limit = static_cast<size_t>(
+            std::max(configs->tagger_max_in_flight_, 1)
+        );
+        if (!tagger_clients_.empty() &&
+            (tagger_clients_.front()->host() != configs->tagger_host_ ||
+             tagger_clients_.front()->port() != configs->tagger_port_)) {
+            tagger_clients_.clear();
+        }
+        // Closes the connections of slots the limit no longer allows
+        if (tagger_clients_.size() > slot_limit)
+            tagger_clients_.resize(slot_limit);
+        while (tagger_clients_.size() < slot_limit) {
+            tagger_clients_.push_back(
+                std::make_unique<TaggerClient>(
+                    configs->tagger_host_, configs->tagger_port_
+                )
+            );
+        }
+
+        const auto info = tagger_clients_.front()->get_info();
         if (!info) {
             std::println(
                 "ImageTagger: Service unavailable at {}:{}: {}",
@@ -1560,32 +2229,31 @@ public:
             return;
         }
 
-        {
-            std::lock_guard refresh_lock{ refresh_mutex_ };
-            current_analyzer_fingerprint_ = info->fingerprint_;
-        }
-
-        struct Candidate {
-            std::string logical_path_;
-            Path input_path_;
-            int64_t input_size_ = 0;
-            int64_t input_modified_time_ = 0;
-        };
-
         const auto now = std::chrono::duration_cast<std::chrono::seconds>(
                              std::chrono::system_clock::now().time_since_epoch()
         )
                              .count();
-        std::vector<Candidate> candidates;
+        std::vector<TagCandidate> candidates;
         {
             std::lock_guard refresh_lock{ refresh_mutex_ };
             const auto current = load_snapshot();
-            std::unordered_set<std::string> queued;
-            for (const auto& file : current->files_) {
-                if (file.tag_input_size_ <= 0 ||
-                    !queued.insert(file.logical_path_).second) {
+            // Every analysis is stale after an analyzer change
+            if (current_analyzer_fingerprint_ != info->fingerprint_) {
+                for (const auto& file : current->files_)
+                    tag_pending_.insert(file.logical_path_);
+                current_analyzer_fingerprint_ = info->fingerprint_;
+            }
+
+            // Paths found current are dropped from `tag_pending_`. Ones in
+            // a retry delay or sent to the tagger stay until committed.
+            std::vector<CachedTagAnalysis> revalidated;
+            for (auto it = tag_pending_.begin(); it != tag_pending_.end();) {
+                const auto found = ::find_tag_input(*current, *it);
+                if (!found) {
+                    it = tag_pending_.erase(it);
                     continue;
                 }
+                const auto& file = *found;
 
                 const auto existing = tag_analyses_.find(file.logical_path_);
                 if (existing != tag_analyses_.end() &&
@@ -1599,6 +2267,7 @@ public:
                             sung::fromstr(existing->second.input_path_),
                             old_input_error
                         )) {
+                        it = tag_pending_.erase(it);
                         continue;
                     }
                 }
@@ -1615,7 +2284,7 @@ public:
                     existing->second.analyzer_fingerprint_ ==
                         info->fingerprint_;
                 if (current_analysis) {
-                    const auto validated = ::validate_fingerprint(
+                    const auto validated = this->validate_fingerprint(
                         sung::fromstr(file.tag_input_path_),
                         existing->second.input_size_,
                         existing->second.input_modified_time_,
@@ -1628,11 +2297,13 @@ public:
                         existing->second.input_size_ = validated->size_;
                         existing->second.input_modified_time_ =
                             validated->modified_time_;
-                        persist_tag_analysis(existing->second);
+                        revalidated.push_back(existing->second);
                     }
                 }
-                if (current_analysis)
+                if (current_analysis) {
+                    it = tag_pending_.erase(it);
                     continue;
+                }
 
                 if (existing != tag_analyses_.end()) {
                     const auto& attempt = existing->second;
@@ -1652,6 +2323,7 @@ public:
                     );
                     if (same_failed_attempt &&
                         now - attempt.last_attempt_at_ < retry_delay) {
+                        ++it;
                         continue;
                     }
                 }
@@ -1664,179 +2336,220 @@ public:
                         file.tag_input_modified_time_,
                     }
                 );
+                ++it;
             }
+            persist_tag_analyses(revalidated);
         }
 
+        // Batches go out over `tagger_max_in_flight` connections, so the
+        // service already has the next one queued while a finished one is
+        // hashed and committed. Each slot commits its own results.
         const auto batch_size = static_cast<size_t>(
             std::max(configs->tagger_batch_size_, 1)
         );
-        for (size_t offset = 0; offset < candidates.size();
-             offset += batch_size) {
-            const auto count = std::min(batch_size, candidates.size() - offset);
-            std::vector<Path> paths;
-            paths.reserve(count);
-            for (size_t i = 0; i < count; ++i)
-                paths.push_back(candidates[offset + i].input_path_);
-
-            const auto results = client.analyze(paths, info->fingerprint_);
-            if (!results) {
-                std::println(
-                    "ImageTagger: Batch request failed: {}", results.error()
+        const auto batch_count = (candidates.size() + batch_size - 1) /
+                                 batch_size;
+        const auto slot_count = std::min(slot_limit, batch_count);
+        std::atomic<size_t> next_batch = 0;
+        std::atomic<bool> request_failed = false;
+        const auto run_slot = [&](TaggerClient& slot_client) {
+            while (!request_failed) {
+                const auto batch = next_batch.fetch_add(1);
+                if (batch >= batch_count)
+                    break;
+
+                const auto offset = batch * batch_size;
+                const auto count = std::min(
+                    batch_size, candidates.size() - offset
                 );
-                return;
-            }
+                std::vector<Path> paths;
+                paths.reserve(count);
+                for (size_t i = 0; i < count; ++i)
+                    paths.push_back(candidates[offset + i].input_path_);
 
-            std::lock_guard refresh_lock{ refresh_mutex_ };
-            const auto latest_snapshot = load_snapshot();
-            bool snapshot_changed = false;
-            for (size_t i = 0; i < count; ++i) {
-                const auto& candidate = candidates[offset + i];
-                const auto& result = results->at(i);
-
-                const auto current_file = std::find_if(
-                    latest_snapshot->files_.begin(),
-                    latest_snapshot->files_.end(),
-                    [&](const auto& file) {
-                        return file.logical_path_ == candidate.logical_path_ &&
-                               file.tag_input_path_ ==
-                                   sung::tostr(candidate.input_path_) &&
-                               file.tag_input_size_ == candidate.input_size_ &&
-                               file.tag_input_modified_time_ ==
-                                   candidate.input_modified_time_;
-                    }
+                const auto results = slot_client.analyze(
+                    paths, info->fingerprint_
                 );
-                if (current_file == latest_snapshot->files_.end())
-                    continue;
-
-                const auto current = sung::fingerprint_file(
-                    candidate.input_path_
-                );
-                if (!current || current->size_ != candidate.input_size_ ||
-                    current->modified_time_ != candidate.input_modified_time_) {
-                    continue;
-                }
-
-                std::optional<sung::FileFingerprint> content_fingerprint;
-                if (result.error_.empty()) {
-                    const auto hashed = sung::fingerprint_file_with_sha256(
-                        candidate.input_path_
+                if (!results) {
+                    std::println(
+                        "ImageTagger: Batch request failed: {}",
+                        results.error()
                     );
-                    if (!hashed || hashed->size_ != candidate.input_size_ ||
-                        hashed->modified_time_ !=
-                            candidate.input_modified_time_) {
-                        std::println(
-                            "ImageTagger: Input changed while fingerprinting: "
-                            "{}",
-                            sung::tostr(candidate.input_path_)
-                        );
-                        continue;
-                    }
-                    content_fingerprint = *hashed;
+                    request_failed = true;
+                    break;
                 }
+                commit_tag_batch(
+                    std::span{ candidates }.subspan(offset, count),
+                    *results,
+                    *info,
+                    now
+                );
+            }
+        };
 
-                auto analysis = tag_analyses_[candidate.logical_path_];
-                analysis.logical_path_ = candidate.logical_path_;
-                const bool repeated_failure =
-                    analysis.attempt_input_path_ ==
-                        sung::tostr(candidate.input_path_) &&
-                    analysis.attempt_input_size_ == candidate.input_size_ &&
-                    analysis.attempt_input_modified_time_ ==
-                        candidate.input_modified_time_ &&
-                    analysis.attempt_analyzer_fingerprint_ ==
-                        info->fingerprint_;
-                analysis.attempt_input_path_ = sung::tostr(
-                    candidate.input_path_
+        std::vector<std::thread> slots;
+        for (size_t i = 1; i < slot_count; ++i)
+            slots.emplace_back(run_slot, std::ref(*tagger_clients_[i]));
+        if (slot_count > 0)
+            run_slot(*tagger_clients_.front());
+        for (auto& slot : slots)
+            slot.join();
+    }
+
+    // Records one tagger response. `results` lines up with `candidates`.
+    void commit_tag_batch(
+        const std::span<const TagCandidate> candidates,
+        const std::vector<TaggerResult>& results,
+        const TaggerInfo& info,
+        const int64_t now
+    ) {
+        // Hashing happens before taking the lock, so other slots and queries
+        // are not held up by disk reads
+        std::vector<std::optional<sung::FileFingerprint>> fingerprints(
+            candidates.size()
+        );
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            const auto& candidate = candidates[i];
+            const auto current = sung::fingerprint_file(candidate.input_path_);
+            if (!current || current->size_ != candidate.input_size_ ||
+                current->modified_time_ != candidate.input_modified_time_) {
+                continue;
+            }
+            if (!results[i].error_.empty()) {
+                fingerprints[i] = *current;
+                continue;
+            }
+
+            const auto hashed = this->hash_file(candidate.input_path_);
+            if (!hashed || hashed->size_ != candidate.input_size_ ||
+                hashed->modified_time_ != candidate.input_modified_time_) {
+                std::println(
+                    "ImageTagger: Input changed while fingerprinting: {}",
+                    sung::tostr(candidate.input_path_)
                 );
-                analysis.attempt_input_size_ = candidate.input_size_;
-                analysis.attempt_input_modified_time_ =
-                    candidate.input_modified_time_;
-                analysis.attempt_analyzer_fingerprint_ = info->fingerprint_;
-                analysis.last_attempt_at_ = now;
-
-                if (!result.error_.empty()) {
-                    analysis.failure_count_ = repeated_failure
-                                                  ? analysis.failure_count_ + 1
-                                                  : 1;
-                    analysis.last_error_ = result.error_;
-                    std::println(
-                        "ImageTagger: Analysis failed for {}: {}",
-                        sung::tostr(candidate.input_path_),
-                        result.error_
-                    );
-                } else {
-                    analysis.input_kind_ = sung::is_sprintboard_proxy_path(
-                                               candidate.input_path_
-                                           )
-                                               ? "proxy"
-                                               : "source";
-                    analysis.input_path_ = sung::tostr(candidate.input_path_);
-                    analysis.input_size_ = content_fingerprint->size_;
-                    analysis.input_modified_time_ =
-                        content_fingerprint->modified_time_;
-                    analysis.input_sha256_ = content_fingerprint->sha256_;
-                    analysis.analyzer_fingerprint_ = info->fingerprint_;
-                    analysis.model_id_ = info->model_id_;
-                    analysis.general_threshold_ = info->general_threshold_;
-                    analysis.character_threshold_ = info->character_threshold_;
-                    analysis.analysis_ = result.analysis_;
-                    analysis.searchable_tags_ = result.searchable_tags_;
-                    analysis.analyzed_at_ = now;
-                    analysis.analysis_id_ = sung::make_analysis_id(analysis);
-                    analysis.sidecar_path_ = sung::tostr(
-                        sung::make_sprintboard_tag_sidecar_path(
-                            candidate.input_path_
-                        )
-                    );
-                    analysis.proxy_path_.clear();
-                    analysis.proxy_size_ = 0;
-                    analysis.proxy_modified_time_ = 0;
-                    analysis.proxy_sha256_.clear();
-                    analysis.proxy_materialization_id_.clear();
-                    analysis.failure_count_ = 0;
-                    analysis.last_error_.clear();
-                    snapshot_changed = true;
-                    std::println(
-                        "ImageTagger: Saved {} tags for {}",
-                        analysis.searchable_tags_.size(),
-                        candidate.logical_path_
-                    );
+                continue;
+            }
+            fingerprints[i] = *hashed;
+        }
+
+        std::lock_guard refresh_lock{ refresh_mutex_ };
+        const auto latest_snapshot = load_snapshot();
+        std::vector<CachedTagAnalysis> updates;
+        updates.reserve(candidates.size());
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            const auto& candidate = candidates[i];
+            const auto& result = results[i];
+            if (!fingerprints[i])
+                continue;
+
+            const auto file_indices = ::find_files(
+                *latest_snapshot, candidate.logical_path_
+            );
+            const auto input_path = sung::tostr(candidate.input_path_);
+            const bool still_listed = std::ranges::any_of(
+                file_indices,
+                [&](const size_t index) {
+                    const auto& file = latest_snapshot->files_[index];
+                    return file.tag_input_path_ == input_path &&
+                           file.tag_input_size_ == candidate.input_size_ &&
+                           file.tag_input_modified_time_ ==
+                               candidate.input_modified_time_;
                 }
+            );
+            if (!still_listed)
+                continue;
 
-                tag_analyses_.insert_or_assign(
-                    candidate.logical_path_, analysis
+            const auto& content_fingerprint = fingerprints[i];
+            auto analysis = tag_analyses_[candidate.logical_path_];
+            analysis.logical_path_ = candidate.logical_path_;
+            const bool repeated_failure =
+                analysis.attempt_input_path_ ==
+                    sung::tostr(candidate.input_path_) &&
+                analysis.attempt_input_size_ == candidate.input_size_ &&
+                analysis.attempt_input_modified_time_ ==
+                    candidate.input_modified_time_ &&
+                analysis.attempt_analyzer_fingerprint_ ==
+                    info.fingerprint_;
+            analysis.attempt_input_path_ = sung::tostr(
+                candidate.input_path_
+            );
+            analysis.attempt_input_size_ = candidate.input_size_;
+            analysis.attempt_input_modified_time_ =
+                candidate.input_modified_time_;
+            analysis.attempt_analyzer_fingerprint_ = info.fingerprint_;
+            analysis.last_attempt_at_ = now;
+
+            if (!result.error_.empty()) {
+                analysis.failure_count_ = repeated_failure
+                                              ? analysis.failure_count_ + 1
+                                              : 1;
+                analysis.last_error_ = result.error_;
+                std::println(
+                    "ImageTagger: Analysis failed for {}: {}",
+                    sung::tostr(candidate.input_path_),
+                    result.error_
                 );
-                if (!persist_tag_analysis(analysis)) {
-                    std::println(
-                        "ImageTagger: Failed to persist analysis state for {}",
-                        candidate.logical_path_
-                    );
-                }
-                if (result.error_.empty()) {
-                    const auto sidecar_result = sung::write_tag_sidecar(
-                        sung::fromstr(analysis.sidecar_path_), analysis
+            } else {
+                analysis.input_kind_ = sung::is_sprintboard_proxy_path(
+                                           candidate.input_path_
+                                       )
+                                           ? "proxy"
+                                           : "source";
+                analysis.input_path_ = sung::tostr(candidate.input_path_);
+                analysis.input_size_ = content_fingerprint->size_;
+                analysis.input_modified_time_ =
+                    content_fingerprint->modified_time_;
+                analysis.input_sha256_ = content_fingerprint->sha256_;
+                analysis.analyzer_fingerprint_ = info.fingerprint_;
+                analysis.model_id_ = info.model_id_;
+                analysis.general_threshold_ = info.general_threshold_;
+                analysis.character_threshold_ = info.character_threshold_;
+                analysis.analysis_ = result.analysis_;
+                analysis.searchable_tags_ = result.searchable_tags_;
+                analysis.analyzed_at_ = now;
+                analysis.analysis_id_ = sung::make_analysis_id(analysis);
+                analysis.sidecar_path_ = sung::tostr(
+                    sung::make_sprintboard_tag_sidecar_path(
+                        candidate.input_path_
+                    )
+                );
+                analysis.proxy_path_.clear();
+                analysis.proxy_size_ = 0;
+                analysis.proxy_modified_time_ = 0;
+                analysis.proxy_sha256_.clear();
+                analysis.proxy_materialization_id_.clear();
+                analysis.failure_count_ = 0;
+                analysis.last_error_.clear();
+                for (const auto index : file_indices) {
+                    latest_snapshot->tag_overlay_->set(
+                        index, analysis.searchable_tags_
                     );
-                    if (!sidecar_result) {
-                        std::println(
-                            "ImageTagger: Failed to write sidecar for {}: {}",
-                            candidate.logical_path_,
-                            sidecar_result.error()
-                        );
-                    }
                 }
+                tag_pending_.erase(candidate.logical_path_);
+                std::println(
+                    "ImageTagger: Saved {} tags for {}",
+                    analysis.searchable_tags_.size(),
+                    candidate.logical_path_
+                );
             }
 
-            if (snapshot_changed) {
-                auto next = std::make_shared<IndexSnapshot>(*latest_snapshot);
-                for (auto& file : next->files_) {
-                    const auto found = tag_analyses_.find(file.logical_path_);
-                    if (found != tag_analyses_.end() &&
-                        !found->second.analysis_.is_null()) {
-                        file.tags_ = found->second.searchable_tags_;
-                    }
-                }
-                ++next->generation_;
-                store_snapshot(std::move(next));
+            tag_analyses_.insert_or_assign(
+                candidate.logical_path_, analysis
+            );
+            if (result.error_.empty()) {
+                sidecar_writer_.enqueue(
+                    sung::fromstr(analysis.sidecar_path_), analysis
+                );
             }
+            updates.push_back(std::move(analysis));
+        }
+
+        if (!persist_tag_analyses(updates)) {
+            std::println(
+                "ImageTagger: Failed to persist analysis state for {} "
+                "images",
+                updates.size()
+            );
         }
     }
 
@@ -1886,7 +2599,7 @@ public:
             found->second.input_path_ != sung::tostr(source_path)) {
             return std::nullopt;
         }
-        const auto fingerprint = ::validate_fingerprint(
+        const auto fingerprint = this->validate_fingerprint(
             source_path,
             found->second.input_size_,
             found->second.input_modified_time_,
@@ -1917,7 +2630,7 @@ public:
             found->second.proxy_path_ != sung::tostr(proxy_path)) {
             return false;
         }
-        return ::validate_fingerprint(
+        return this->validate_fingerprint(
                    proxy_path,
                    found->second.proxy_size_,
                    found->second.proxy_modified_time_,
@@ -1936,7 +2649,7 @@ public:
         const auto found = tag_analyses_.find(logical_path);
         if (found == tag_analyses_.end() || found->second.analysis_.is_null())
             return;
-        const auto fingerprint = sung::fingerprint_file_with_sha256(proxy_path);
+        const auto fingerprint = this->hash_file(proxy_path);
         if (!fingerprint)
             return;
 
@@ -1957,18 +2670,13 @@ public:
                 logical_path
             );
         }
-        const auto sidecar_result = sung::write_tag_sidecar(
+        sidecar_writer_.enqueue(
             sung::fromstr(analysis.sidecar_path_), analysis
         );
-        if (!sidecar_result) {
-            std::println(
-                "ImgWalker: Failed to update tag sidecar for {}: {}",
-                logical_path,
-                sidecar_result.error()
-            );
-        }
     }
 
+    void flush_tag_sidecars() { sidecar_writer_.flush(); }
+
     ImageListResponse query(
         const Path& dir_path,
         const std::string& query_text,
@@ -1998,7 +2706,10 @@ public:
         }
 
         const sung::detail::ImageQuery query{ query_text };
-        for (const auto& file : current->files_) {
+        const auto& overlay = *current->tag_overlay_;
+        const auto overlay_lock = overlay.lock();
+        for (size_t i = 0; i < current->files_.size(); ++i) {
+            const auto& file = current->files_[i];
             if (avif_only) {
                 auto ext = file.info_.path_.extension().string();
                 absl::AsciiStrToLower(&ext);
@@ -2017,11 +2728,15 @@ public:
                 )) {
                 continue;
             }
-            if (query.needs_metadata() &&
-                !query.matches_metadata(
-                    file.model_, file.prompts_, file.tags_
-                )) {
-                continue;
+            if (query.needs_metadata()) {
+                const auto overlay_tags = overlay.find(i);
+                if (!query.matches_metadata(
+                        file.model_,
+                        ::prompts_or_empty(file.prompts_),
+                        overlay_tags ? *overlay_tags : file.tags_
+                    )) {
+                    continue;
+                }
             }
             response.add_file(
                 file.info_.name_,
@@ -2048,6 +2763,14 @@ public:
         std::lock_guard refresh_lock{ refresh_mutex_ };
         const auto current = load_snapshot();
         auto next = std::make_shared<IndexSnapshot>(*current);
+        {
+            const auto& overlay = *current->tag_overlay_;
+            const auto overlay_lock = overlay.lock();
+            for (size_t i = 0; i < next->files_.size(); ++i) {
+                if (const auto tags = overlay.find(i))
+                    next->files_[i].tags_ = *tags;
+            }
+        }
         std::vector<std::string> removed_logical_paths;
         std::erase_if(next->files_, [&](const auto& file) {
             if (sung::tostr(file.info_.path_) != api_path)
@@ -2055,7 +2778,13 @@ public:
             removed_logical_paths.push_back(file.logical_path_);
             return true;
         });
+        ::index_files(*next);
         for (const auto& logical_path : removed_logical_paths) {
+            // A file left under the same logical path loses the analysis
+            if (::find_files(*next, logical_path).empty())
+                tag_pending_.erase(logical_path);
+            else
+                tag_pending_.insert(logical_path);
             tag_analyses_.erase(logical_path);
             if (!erase_tag_analysis(logical_path)) {
                 std::println(
@@ -2071,6 +2800,97 @@ public:
     bool persistent() const { return database_ != nullptr; }
 
 private:
+    std::optional<sung::FileFingerprint> validate_fingerprint(
+        const Path& path,
+        const int64_t expected_size,
+        const int64_t expected_modified_time,
+        const std::string& expected_sha256
+    ) const {
+        const auto metadata = sung::fingerprint_file(path);
+        if (!metadata || metadata->size_ != expected_size)
+            return std::nullopt;
+        if (metadata->modified_time_ == expected_modified_time) {
+            auto output = *metadata;
+            output.sha256_ = expected_sha256;
+            return output;
+        }
+        const auto fingerprint = this->hash_file(path);
+        if (!fingerprint || fingerprint->sha256_ != expected_sha256)
+            return std::nullopt;
+        return *fingerprint;
+    }
+
+    std::optional<std::string> find_content_hash(
+        const std::string& path_str,
+        const FileFingerprint& stamp,
+        const int64_t file_id
+    ) const {
+        std::lock_guard database_lock{ database_mutex_ };
+        if (!database_)
+            return std::nullopt;
+
+        const auto cached = statements_.get(
+            database_,
+            "SELECT sha256 FROM content_hashes WHERE physical_path=? AND "
+            "file_size=? AND modified_time=? AND file_id=?;"
+        );
+        if (!cached)
+            return std::nullopt;
+        auto* statement = cached.get();
+
+        sqlite3_bind_text(
+            statement, 1, path_str.c_str(), -1, SQLITE_TRANSIENT
+        );
+        sqlite3_bind_int64(statement, 2, stamp.size_);
+        sqlite3_bind_int64(statement, 3, stamp.modified_time_);
+        sqlite3_bind_int64(statement, 4, file_id);
+
+        std::optional<std::string> output;
+        if (sqlite3_step(statement) == SQLITE_ROW) {
+            const auto* text = reinterpret_cast<const char*>(
+                sqlite3_column_text(statement, 0)
+            );
+            output.emplace(text, sqlite3_column_bytes(statement, 0));
+        }
+        return output;
+    }
+
+    // Failing to store only means the file gets hashed again next time
+    void store_content_hash(
+        const std::string& path_str,
+        const FileFingerprint& fingerprint,
+        const int64_t file_id
+    ) const {
+        std::lock_guard database_lock{ database_mutex_ };
+        if (!database_)
+            return;
+
+        const auto cached = statements_.get(
+            database_,
+            "INSERT INTO content_hashes "
+            "(physical_path, file_size, modified_time, file_id, sha256) "
+            "VALUES (?, ?, ?, ?, ?) "
+            "ON CONFLICT(physical_path) DO UPDATE SET "
+            "file_size=excluded.file_size, "
+            "modified_time=excluded.modified_time, "
+            "file_id=excluded.file_id, sha256=excluded.sha256;"
+        );
+        if (!cached)
+            return;
+        auto* statement = cached.get();
+
+        sqlite3_bind_text(
+            statement, 1, path_str.c_str(), -1, SQLITE_TRANSIENT
+        );
+        sqlite3_bind_int64(statement, 2, fingerprint.size_);
+        sqlite3_bind_int64(statement, 3, fingerprint.modified_time_);
+        sqlite3_bind_int64(statement, 4, file_id);
+        sqlite3_bind_text(
+            statement, 5, fingerprint.sha256_.c_str(), -1, SQLITE_TRANSIENT
+        );
+        sqlite3_step(statement);
+    }
+
     std::shared_ptr<const IndexSnapshot> load_snapshot() const {
         std::lock_guard lock{ snapshot_mutex_ };
         return snapshot_;
@@ -2082,14 +2902,36 @@ private:
     }
 
     Path database_path_;
+    sung::MetadataCache* metadata_cache_;
     sqlite3* database_ = nullptr;
-    bool database_dirty_ = false;
+    // Mutable for `find_details`, used under `database_mutex_` only
+    mutable StatementCache statements_;
     std::unordered_map<std::string, CachedMetadata> metadata_;
     std::unordered_map<std::string, CachedTagAnalysis> tag_analyses_;
     std::string current_analyzer_fingerprint_;
+    // Logical paths whose analysis may be missing or stale. Filled by
+    // refresh, so a tagger poll only checks these.
+    std::unordered_set<std::string> tag_pending_;
     std::shared_ptr<const IndexSnapshot> snapshot_;
     mutable std::mutex refresh_mutex_;
     mutable std::mutex snapshot_mutex_;
+    // Guards `database_`. Taken after `refresh_mutex_` where both are held.
+    mutable std::mutex database_mutex_;
+    SidecarWriter sidecar_writer_;
+    // One per request slot, kept between polls so their connections stay
+    // open. Only the auto-tagging thread uses them.
+    std::vector<std::unique_ptr<TaggerClient>> tagger_clients_;
+    // Write-behind queue of `image_metadata` rows, keyed by physical path.
+    // Null entries delete the row.
+    std::unordered_map<std::string, std::optional<CachedMetadata>>
+        pending_writes_;
+    std::mutex write_mutex_;
+    std::condition_variable write_cv_;
+    std::condition_variable write_idle_cv_;
+    bool write_ready_ = false;
+    bool write_busy_ = false;
+    bool write_stop_ = false;
+    std::thread metadata_writer_;
     // Isolated from the default TBB arena (used by CPU-bound AVIF encoding)
     // since this one is deliberately oversubscribed for I/O latency-hiding.
     tbb::task_arena scan_arena_{ SCAN_CONCURRENCY };
@@ -2111,8 +2953,10 @@ namespace sung {
         };
     }
 
-    ImageIndex::ImageIndex(Path database_path)
-        : impl_(std::make_unique<Impl>(std::move(database_path))) {}
+    ImageIndex::ImageIndex(Path database_path, MetadataCache* metadata_cache)
+        : impl_(std::make_unique<Impl>(
+              std::move(database_path), metadata_cache
+          )) {}
 
     ImageIndex::~ImageIndex() {
         auto_refresh_stop_ = true;
@@ -2126,7 +2970,7 @@ namespace sung {
     ImageIndexRefreshStats ImageIndex::initialize(
         std::shared_ptr<const ServerConfigs> configs
     ) {
-        impl_->open_database();
+        impl_->open_database(*configs);
         return impl_->refresh(configs);
     }
 
@@ -2199,6 +3043,26 @@ namespace sung {
         return impl_->tag_analysis(physical_path);
     }
 
+    std::optional<std::string> ImageIndex::find_details(
+        const Path& physical_path, const FileFingerprint& stamp
+    ) const {
+        return impl_->find_details(physical_path, stamp);
+    }
+
+    bool ImageIndex::store_details(
+        const Path& physical_path,
+        const FileFingerprint& stamp,
+        const std::string_view payload
+    ) {
+        return impl_->store_details(physical_path, stamp, payload);
+    }
+
+    std::expected<FileFingerprint, std::string> ImageIndex::hash_file(
+        const Path& path
+    ) const {
+        return impl_->hash_file(path);
+    }
+
     std::optional<TagAnalysisRecord> ImageIndex::current_tag_analysis(
         const Path& source_path, const bool require_current_analyzer
     ) const {
@@ -2225,4 +3089,10 @@ namespace sung {
         );
     }
 
+    void ImageIndex::flush_tag_sidecars() { impl_->flush_tag_sidecars(); }
+
+    void ImageIndex::flush_metadata_writes() {
+        impl_->flush_metadata_writes();
+    }
+
 }  // namespace sung
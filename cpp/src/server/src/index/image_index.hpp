@@ -27,8 +27,14 @@ namespace sung {
 
         std::string logical_image_key(const Path& physical_path);
 
+        // The time images are sorted by: creation time where the
+        // filesystem records it, otherwise modification time. 0 on error.
+        int64_t read_image_sort_time(const Path& path);
+
     }  // namespace detail
 
+    class MetadataCache;
+
     struct ImageIndexRefreshStats {
         size_t files_scanned_ = 0;
         size_t metadata_reused_ = 0;
@@ -46,7 +52,11 @@ namespace sung {
     class ImageIndex {
 
     public:
-        explicit ImageIndex(Path database_path);
+        // Files that are new or changed since the last scan are looked up
+        // in `metadata_cache` before being parsed, if one is given
+        explicit ImageIndex(
+            Path database_path, MetadataCache* metadata_cache = nullptr
+        );
         ~ImageIndex();
 
         ImageIndex(const ImageIndex&) = delete;
@@ -92,6 +102,23 @@ namespace sung {
             const Path& physical_path
         ) const;
 
+        // The `/api/images/details` payload stored for the file, if it was
+        // stored at the same size and modification time
+        std::optional<std::string> find_details(
+            const Path& physical_path, const FileFingerprint& stamp
+        ) const;
+        bool store_details(
+            const Path& physical_path,
+            const FileFingerprint& stamp,
+            std::string_view payload
+        );
+
+        // `fingerprint_file_with_sha256`, answered from a cache of earlier
+        // hashes while the file keeps its size, time and id
+        std::expected<FileFingerprint, std::string> hash_file(
+            const Path& path
+        ) const;
+
         std::optional<TagAnalysisRecord> current_tag_analysis(
             const Path& source_path, bool require_current_analyzer = true
         ) const;
@@ -106,6 +133,14 @@ namespace sung {
             std::string materialization_id
         );
 
+        // Tag sidecars are written in the background. Blocks until the ones
+        // queued so far are on disk.
+        void flush_tag_sidecars();
+
+        // Metadata rows are written behind the published snapshot. Blocks
+        // until the ones queued so far are committed, or have failed.
+        void flush_metadata_writes();
+
     private:
         class Impl;
         std::unique_ptr<Impl> impl_;
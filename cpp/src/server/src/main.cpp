@@ -20,6 +20,8 @@
 #include "sung/auxiliary/filesys.hpp"
 #include "sung/auxiliary/server_configs.hpp"
 #include "task/img_walker.hpp"
+#include "util/access_recency.hpp"
+#include "util/metadata_cache.hpp"
 #include "util/task.hpp"
 #include "util/wake.hpp"
 
@@ -37,6 +39,10 @@ namespace {
     // directory would need.
     constexpr double IMAGE_INDEX_REFRESH_INTERVAL = 30;
 
+    // Workflows run from a few KB to a few MB, so this holds the parsed
+    // metadata of a few thousand typical images
+    constexpr size_t METADATA_CACHE_BYTES = 64 << 20;
+
 
     std::expected<size_t, std::string> parse_size_param(
         const HttpReq& req,
@@ -62,6 +68,22 @@ namespace {
     }
 
 
+    // Adds a field to a serialized JSON object without parsing it again
+    void append_json_field(
+        std::string& object,
+        const std::string_view key,
+        const nlohmann::json& value
+    ) {
+        object.pop_back();
+        if (object.size() > 1)
+            object += ',';
+        object += nlohmann::json(key).dump();
+        object += ':';
+        object += value.dump();
+        object += '}';
+    }
+
+
     std::pair<sung::Path, sung::Path> split_namespace(const sung::Path& p) {
         sung::Path namespace_path;
         sung::Path rest_path;
@@ -191,8 +213,9 @@ int main() {
         return 1;
     }
 
+    sung::MetadataCache metadata_cache{ ::METADATA_CACHE_BYTES };
     sung::ImageIndex image_index{
-        sung::fromstr(".sprintboard/image-index.sqlite3")
+        sung::fromstr(".sprintboard/image-index.sqlite3"), &metadata_cache
     };
     image_index.initialize(server_configs.get());
     image_index.start_auto_refresh(
@@ -203,6 +226,8 @@ int main() {
         return server_configs.get();
     });
 
+    sung::AccessRecency access_recency;
+    sung::AvifGenStats avif_stats;
     sung::TaskManager tasks;
     auto power_req = std::make_shared<::PowerRequestTask>();
     tasks.add_periodic_task(power_req, 3.0);
@@ -211,7 +236,12 @@ int main() {
 
     tasks.add_periodic_task(
         sung::create_img_walker_task(
-            server_configs, power_req->get(), image_index
+            server_configs,
+            power_req->get(),
+            image_index,
+            access_recency,
+            metadata_cache,
+            avif_stats
         ),
         sung::AVIF_ENCODE_TIME_INTERVAL
     );
@@ -320,6 +350,7 @@ int main() {
                     );
                     return;
                 }
+                access_recency.touch(*full_path, recursive);
             }
         }
 
@@ -380,22 +411,35 @@ int main() {
             return;
         }
 
-        const auto response = sung::make_img_detail_response();
-        const auto err = response->fetch_img(*full_path);
-        if (!err) {
-            res.status = 400;
-            res.set_content(
-                "Error fetching image details: " + err.error(), "text/plain"
+        // The rendered payload of an unchanged file is stored in the index
+        // database, so repeated views skip parsing and beautifying
+        const auto stamp = sung::fingerprint_file(*full_path);
+        auto json_str = stamp ? image_index.find_details(*full_path, *stamp)
+                              : std::nullopt;
+        if (!json_str) {
+            const auto response = sung::make_img_detail_response(
+                metadata_cache
             );
-            return;
+            const auto err = response->fetch_img(*full_path);
+            if (!err) {
+                res.status = 400;
+                res.set_content(
+                    "Error fetching image details: " + err.error(),
+                    "text/plain"
+                );
+                return;
+            }
+
+            json_str = response->make_json().dump();
+            if (stamp)
+                image_index.store_details(*full_path, *stamp, *json_str);
         }
 
-        auto json_data = response->make_json();
+        // Changes independently of the file, so it is never stored
         if (const auto tag_analysis = image_index.tag_analysis(*full_path))
-            json_data["tagAnalysis"] = *tag_analysis;
-        const auto json_str = json_data.dump();
+            ::append_json_field(*json_str, "tagAnalysis", *tag_analysis);
         res.status = 200;
-        res.set_content(json_str, "application/json");
+        res.set_content(*json_str, "application/json");
         return;
     });
 
@@ -513,6 +557,18 @@ int main() {
         res.set_content("File deleted", "text/plain");
     });
 
+    svr.Get("/api/stats/avif", [&](const HttpReq&, HttpRes& res) {
+        res.status = 200;
+        res.set_content(avif_stats.make_json().dump(), "application/json");
+    });
+
+    svr.Get("/api/stats/metadata", [&](const HttpReq&, HttpRes& res) {
+        res.status = 200;
+        res.set_content(
+            metadata_cache.make_json().dump(), "application/json"
+        );
+    });
+
     svr.Get("/api/wake", [&](const HttpReq& req, HttpRes& res) {
         auto response = nlohmann::json::object();
         response["wake_on"] = power_req->get().is_active();
@@ -546,6 +602,7 @@ int main() {
             return;
         }
 
+        access_recency.touch(full_path->parent_path());
         const auto mime = ::determine_mime(*full_path);
 
         if (serve_file_streaming(*full_path, mime, res)) {
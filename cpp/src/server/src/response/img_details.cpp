@@ -8,6 +8,8 @@
 
 #include "sung/auxiliary/filesys.hpp"
 #include "sung/image/img_info.hpp"
+#include "tag_sidecar.hpp"
+#include "util/metadata_cache.hpp"
 
 
 namespace {
@@ -36,6 +38,38 @@ namespace {
     }
 
 
+    nlohmann::json make_metadata_json(const sung::ImageMetadata& data) {
+        nlohmann::json j;
+        j["sdModelName"] = data.model_;
+        j["sdPrompt"] = data.prompts_;
+        j["width"] = data.width_;
+        j["height"] = data.height_;
+
+        if (const auto workflow = data.workflow()) {
+            auto& j_comfyui = j["comfyuiInfo"];
+            j_comfyui["workflowSrc"] = ::beautify_json(*workflow)
+                                           .value_or(*workflow);
+        }
+
+        if (data.png_text_) {
+            auto& j_png = j["pngInfo"];
+            for (const auto& item : *data.png_text_) {
+                j_png["text_chunks"][item.key] =
+                    ::beautify_json(item.value).value_or(item.value);
+            }
+        }
+
+        if (data.avif_xmp_) {
+            auto& j_avif = j["avifInfo"];
+            const auto xml_str = std::string{ data.avif_xmp_->begin(),
+                                              data.avif_xmp_->end() };
+            j_avif["xmp"] = ::beautify_xml(xml_str).value_or(xml_str);
+        }
+
+        return j;
+    }
+
+
     class ResponseData : public sung::ImageInfo {
 
     public:
@@ -59,38 +93,19 @@ namespace {
             return {};
         }
 
-        nlohmann::json make_json() const {
-            nlohmann::json j;
-            j["sdModelName"] = this->sd().model_name_;
-            j["sdPrompt"] = this->sd().prompt_;
-            j["width"] = this->width();
-            j["height"] = this->height();
-
-            if (this->comfyui()) {
-                auto& j_comfyui = j["comfyuiInfo"];
-                j_comfyui["workflowSrc"] =
-                    ::beautify_json(this->comfyui()->workflow_src())
-                        .value_or(this->comfyui()->workflow_src());
-            }
-
-            if (this->png()) {
-                auto& j_png = j["pngInfo"];
-                for (const auto& item : this->png()->metadata_.text) {
-                    j_png["text_chunks"][item.key] =
-                        ::beautify_json(item.value).value_or(item.value);
-                }
-            }
-
-            if (this->avif()) {
-                auto& j_avif = j["avifInfo"];
-                const auto xml_str = std::string{
-                    this->avif()->metadata_.xmp_data_.begin(),
-                    this->avif()->metadata_.xmp_data_.end()
-                };
-                j_avif["xmp"] = ::beautify_xml(xml_str).value_or(xml_str);
-            }
-
-            return j;
+        sung::ImageMetadata make_metadata() const {
+            sung::ImageMetadata output;
+            output.width_ = static_cast<int>(this->width());
+            output.height_ = static_cast<int>(this->height());
+            output.model_ = this->sd().model_name_;
+            output.prompts_ = this->sd().prompt_;
+            if (this->png())
+                output.png_text_ = this->png()->metadata_.text;
+            if (this->comfyui() && !output.workflow())
+                output.workflow_ = this->comfyui()->workflow_src();
+            if (this->avif())
+                output.avif_xmp_ = this->avif()->metadata_.xmp_data_;
+            return output;
         }
     };
 
@@ -98,15 +113,43 @@ namespace {
     class ImageDetailResponse : public sung::IImageDetailResponse {
 
     public:
+        explicit ImageDetailResponse(sung::MetadataCache& cache)
+            : cache_(cache) {}
+
         sung::ErrStr fetch_img(const sung::Path& file_path) override {
-            data_ = ResponseData{ file_path };
-            return data_.fetch_all();
+            // Taken before reading, so an edit in between is caught by the
+            // next request instead of being cached under the new stamp
+            const auto stamp = sung::fingerprint_file(file_path);
+            if (stamp) {
+                data_ = cache_.find(file_path, *stamp);
+                if (data_)
+                    return {};
+            }
+
+            ResponseData response{ file_path };
+            if (const auto err = response.fetch_all(); !err)
+                return err;
+
+            auto metadata = response.make_metadata();
+            if (stamp) {
+                data_ = cache_.insert(file_path, *stamp, std::move(metadata));
+            } else {
+                data_ = std::make_shared<const sung::ImageMetadata>(
+                    std::move(metadata)
+                );
+            }
+            return {};
         }
 
-        nlohmann::json make_json() const override { return data_.make_json(); }
+        nlohmann::json make_json() const override {
+            if (!data_)
+                return nlohmann::json{};
+            return ::make_metadata_json(*data_);
+        }
 
     private:
-        ResponseData data_;
+        sung::MetadataCache& cache_;
+        std::shared_ptr<const sung::ImageMetadata> data_;
     };
 
 }  // namespace
@@ -114,8 +157,10 @@ namespace {
 
 namespace sung {
 
-    std::unique_ptr<IImageDetailResponse> make_img_detail_response() {
-        return std::make_unique<::ImageDetailResponse>();
+    std::unique_ptr<IImageDetailResponse> make_img_detail_response(
+        MetadataCache& cache
+    ) {
+        return std::make_unique<::ImageDetailResponse>(cache);
     }
 
 }  // namespace sung
@@ -11,12 +11,18 @@
 
 namespace sung {
 
+    class MetadataCache;
+
     struct IImageDetailResponse {
         virtual ~IImageDetailResponse() = default;
         virtual ErrStr fetch_img(const sung::Path& img_path) = 0;
         virtual nlohmann::json make_json() const = 0;
     };
 
-    std::unique_ptr<IImageDetailResponse> make_img_detail_response();
+    // Answers from `cache` when the file is unchanged since it was last
+    // parsed, and stores what it parses otherwise
+    std::unique_ptr<IImageDetailResponse> make_img_detail_response(
+        MetadataCache& cache
+    );
 
 }  // namespace sung
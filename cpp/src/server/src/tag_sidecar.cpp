@@ -158,7 +158,11 @@ namespace sung {
         if (!before)
             return std::unexpected(before.error());
 
-        std::ifstream input{ path, std::ios::binary };
+        // Unbuffered with large reads, so the data is copied once, straight
+        // into `buffer`
+        std::ifstream input;
+        input.rdbuf()->pubsetbuf(nullptr, 0);
+        input.open(path, std::ios::binary);
         if (!input)
             return std::unexpected("cannot read file for SHA-256");
 
@@ -170,7 +174,7 @@ namespace sung {
             return std::unexpected("cannot initialize SHA-256");
         }
 
-        std::array<char, 64 * 1024> buffer{};
+        std::vector<char> buffer(1024 * 1024);
         while (input) {
             input.read(buffer.data(), buffer.size());
             const auto count = input.gcount();
@@ -234,9 +238,10 @@ namespace sung {
         const TagAnalysisRecord& record,
         const std::string_view pixel_format,
         const double quality,
-        const int speed
+        const int speed,
+        const double target_ssim
     ) {
-        const auto input = std::format(
+        auto input = std::format(
             "{}\n{}\n{}\n{}\n{:.17g}\n{}",
             record.analysis_id_,
             record.input_size_,
@@ -245,6 +250,10 @@ namespace sung {
             quality,
             speed
         );
+        // Appended only when set, so ids of proxies encoded without a
+        // target stay valid.
+        if (target_ssim > 0)
+            input += std::format("\n{:.17g}", target_ssim);
         return std::format("{:016x}", ::fnv1a(input));
     }
 
@@ -70,7 +70,8 @@ namespace sung {
         const TagAnalysisRecord& record,
         std::string_view pixel_format,
         double quality,
-        int speed
+        int speed,
+        double target_ssim = 0
     );
 
     nlohmann::json make_embedded_tag_analysis(const TagAnalysisRecord& record);
@@ -1,22 +1,19 @@
 #include "tagger_client.hpp"
 
+#include <algorithm>
 #include <chrono>
-#include <memory>
+#include <format>
+#include <functional>
+#include <mutex>
 
 #include <httplib.h>
 
 
 namespace {
 
-    std::unique_ptr<httplib::Client> make_client(
-        const std::string& host, const int port
-    ) {
-        auto client = std::make_unique<httplib::Client>(host, port);
-        client->set_connection_timeout(std::chrono::seconds{ 5 });
-        client->set_read_timeout(std::chrono::minutes{ 10 });
-        client->set_write_timeout(std::chrono::seconds{ 30 });
-        return client;
-    }
+    using Clock = std::chrono::steady_clock;
+
+    constexpr auto MAX_RETRY_DELAY = std::chrono::seconds{ 60 };
 
     std::expected<nlohmann::json, std::string> parse_response(
         const httplib::Result& response
@@ -166,12 +163,82 @@ namespace sung {
 
     }  // namespace detail
 
+    class TaggerClient::Connection {
+
+    public:
+        Connection(const std::string& host, const int port)
+            : client_(host, port) {
+            client_.set_connection_timeout(std::chrono::seconds{ 5 });
+            client_.set_read_timeout(std::chrono::minutes{ 10 });
+            client_.set_write_timeout(std::chrono::seconds{ 30 });
+            client_.set_keep_alive(true);
+            // Asks for compressed responses, which carry every tag with its
+            // confidence. Requests are only a few paths, so they are sent
+            // as they are.
+            client_.set_decompress(true);
+        }
+
+        std::expected<nlohmann::json, std::string> send(
+            const std::function<httplib::Result(httplib::Client&)>& request
+        ) {
+            std::lock_guard lock{ mut_ };
+            const auto started = Clock::now();
+            if (started < retry_at_) {
+                const auto wait = std::chrono::ceil<std::chrono::seconds>(
+                    retry_at_ - started
+                );
+                return std::unexpected(
+                    std::format(
+                        "service unreachable, retrying in {} s", wait.count()
+                    )
+                );
+            }
+
+            auto response = request(client_);
+            // The service may have closed the connection while it sat idle.
+            // Sending on it fails at once, so that is retried on a new one.
+            if (!response && reused_ &&
+                (response.error() == httplib::Error::Read ||
+                 response.error() == httplib::Error::Write) &&
+                Clock::now() - started < std::chrono::seconds{ 1 }) {
+                response = request(client_);
+            }
+
+            if (!response) {
+                reused_ = false;
+                const auto delay = std::min<Clock::duration>(
+                    std::chrono::seconds{ 1LL << std::min(failures_, 6) },
+                    MAX_RETRY_DELAY
+                );
+                ++failures_;
+                retry_at_ = Clock::now() + delay;
+            } else {
+                reused_ = true;
+                failures_ = 0;
+                retry_at_ = {};
+            }
+            return ::parse_response(response);
+        }
+
+    private:
+        std::mutex mut_;
+        httplib::Client client_;
+        Clock::time_point retry_at_;
+        int failures_ = 0;
+        bool reused_ = false;
+    };
+
     TaggerClient::TaggerClient(std::string host, const int port)
-        : host_(std::move(host)), port_(port) {}
+        : host_(std::move(host))
+        , port_(port)
+        , connection_(std::make_unique<Connection>(host_, port_)) {}
 
-    std::expected<TaggerInfo, std::string> TaggerClient::get_info() const {
-        const auto response = ::make_client(host_, port_)->Get("/v1/info");
-        const auto parsed = ::parse_response(response);
+    TaggerClient::~TaggerClient() = default;
+
+    std::expected<TaggerInfo, std::string> TaggerClient::get_info() {
+        const auto parsed = connection_->send([](httplib::Client& client) {
+            return client.Get("/v1/info");
+        });
         if (!parsed)
             return std::unexpected(parsed.error());
         return detail::parse_tagger_info(*parsed);
@@ -179,16 +246,16 @@ namespace sung {
 
     std::expected<std::vector<TaggerResult>, std::string> TaggerClient::analyze(
         const std::vector<Path>& paths, const std::string& expected_fingerprint
-    ) const {
+    ) {
         auto request = nlohmann::json::object();
         request["paths"] = nlohmann::json::array();
         for (const auto& path : paths)
             request["paths"].push_back(sung::tostr(path));
 
-        const auto response =
-            ::make_client(host_, port_)
-                ->Post("/v1/analyze", request.dump(), "application/json");
-        const auto parsed = ::parse_response(response);
+        const auto body = request.dump();
+        const auto parsed = connection_->send([&](httplib::Client& client) {
+            return client.Post("/v1/analyze", body, "application/json");
+        });
         if (!parsed)
             return std::unexpected(parsed.error());
         return detail::parse_tagger_results(
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <expected>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -39,20 +40,36 @@ namespace sung {
 
     }  // namespace detail
 
+    // Keeps one keep-alive connection to the tagging service. After a
+    // request fails to reach it, further requests fail right away until a
+    // backoff delay passes, which doubles with each failure up to a minute.
+    // Requests from several threads are sent one at a time.
     class TaggerClient {
 
     public:
         TaggerClient(std::string host, int port);
+        ~TaggerClient();
 
-        std::expected<TaggerInfo, std::string> get_info() const;
+        TaggerClient(const TaggerClient&) = delete;
+        TaggerClient& operator=(const TaggerClient&) = delete;
+        TaggerClient(TaggerClient&&) = delete;
+        TaggerClient& operator=(TaggerClient&&) = delete;
+
+        const std::string& host() const { return host_; }
+        int port() const { return port_; }
+
+        std::expected<TaggerInfo, std::string> get_info();
         std::expected<std::vector<TaggerResult>, std::string> analyze(
             const std::vector<Path>& paths,
             const std::string& expected_fingerprint
-        ) const;
+        );
 
     private:
+        class Connection;
+
         std::string host_;
         int port_;
+        std::unique_ptr<Connection> connection_;
     };
 
 }  // namespace sung
@@ -1,7 +1,11 @@
 #include "task/img_walker.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <memory>
 #include <optional>
 #include <print>
+#include <queue>
 
 #include <absl/strings/ascii.h>
 #include <tbb/task_group.h>
@@ -11,8 +15,13 @@
 #include "index/image_index.hpp"
 #include "sung/auxiliary/filesys.hpp"
 #include "sung/image/avif.hpp"
+#include "sung/image/avif_quality.hpp"
 #include "sung/image/png.hpp"
 #include "sung/image/xmp.hpp"
+#include "sung/image/yuv.hpp"
+#include "task/proxy_dedup.hpp"
+#include "util/access_recency.hpp"
+#include "util/metadata_cache.hpp"
 
 #if defined(__cpp_lib_generator) && __cpp_lib_generator >= SUNG__cplusplus
     #include <generator>
@@ -60,54 +69,38 @@ namespace {
         return "unknown";
     }
 
-    std::expected<std::vector<uint8_t>, std::string> encode_avif(
-        const sung::PngData& src, const sung::AvifEncodeParams& params
-    ) {
-        if (src.pixels.empty())
-            return std::unexpected("empty image");
-        if (src.bit_depth != 8)
-            return std::unexpected("only 8-bit images supported");
-
-        const auto image = avifImageCreate(
-            src.width,
-            src.height,
-            8,  // bit depth
-            params.yuv_format()
-        );
-        if (!image)
-            return std::unexpected("avifImageCreate failed");
+    // Rows decoded per PNG strip. Even, so every strip after the first starts
+    // on a 4:2:0 chroma row boundary and subsampling matches a full-frame
+    // conversion.
+    constexpr int PNG_STRIP_ROWS = 64;
 
-        // If you need alpha, tell libavif we have it (BGRA → YUVA)
-        image->alphaPremultiplied = AVIF_FALSE;
+    struct AvifImageDeleter {
+        void operator()(avifImage* image) const { avifImageDestroy(image); }
+    };
 
-        avifRGBImage rgb;
-        avifRGBImageSetDefaults(&rgb, image);
-        rgb.depth = 8;
-        rgb.pixels = const_cast<uint8_t*>(src.pixels.data());
-        rgb.rowBytes = static_cast<uint32_t>(src.width * 4);  // assuming RGBA
-        rgb.format = AVIF_RGB_FORMAT_RGBA;
+    using AvifImagePtr = std::unique_ptr<avifImage, AvifImageDeleter>;
 
-        auto res = avifImageRGBToYUV(image, &rgb);
-        if (res != AVIF_RESULT_OK) {
-            avifImageDestroy(image);
-            return std::unexpected(avifResultToString(res));
-        }
+    struct YuvFrame {
+        sung::PngMeta meta_;
+        AvifImagePtr image_;
+        // Spent in RGB to YUV conversion, interleaved with the PNG decode
+        double yuv_seconds_ = 0;
+    };
 
+    std::expected<std::vector<uint8_t>, std::string> encode_avif(
+        avifImage* image, const sung::AvifEncodeParams& params
+    ) {
         if (!params.xmp().empty()) {
             const auto result = avifImageSetMetadataXMP(
                 image, params.xmp().data(), params.xmp().size()
             );
-            if (result != AVIF_RESULT_OK) {
-                avifImageDestroy(image);
+            if (result != AVIF_RESULT_OK)
                 return std::unexpected(avifResultToString(result));
-            }
         }
 
         const auto enc = avifEncoderCreate();
-        if (!enc) {
-            avifImageDestroy(image);
+        if (!enc)
             return std::unexpected("avifEncoderCreate failed");
-        }
 
         enc->minQuantizer = params.calc_quantizer();
         // constant quality for simplicity
@@ -115,25 +108,152 @@ namespace {
         enc->speed = params.speed();
 
         avifRWData encoded = AVIF_DATA_EMPTY;
-        res = avifEncoderWrite(enc, image, &encoded);
+        const auto res = avifEncoderWrite(enc, image, &encoded);
         if (res != AVIF_RESULT_OK) {
             avifRWDataFree(&encoded);
             avifEncoderDestroy(enc);
-            avifImageDestroy(image);
             return std::unexpected(avifResultToString(res));
         }
 
-        // 7) Copy bytes out
         std::vector<uint8_t> outData(encoded.data, encoded.data + encoded.size);
 
-        // 8) Cleanup
         avifRWDataFree(&encoded);
         avifEncoderDestroy(enc);
-        avifImageDestroy(image);
 
         return outData;
     }
 
+    // Decodes the PNG strip by strip straight into the YUV planes of an
+    // AVIF image, so only one strip of RGBA pixels is alive at a time instead
+    // of the whole frame.
+    std::expected<YuvFrame, std::string> read_png_as_yuv(
+        const sung::Path& src_path, const avifPixelFormat yuv_format
+    ) {
+        AvifImagePtr image;
+        double yuv_seconds = 0;
+        const AvifImagePtr view{ avifImageCreateEmpty() };
+        if (!view)
+            return std::unexpected("avifImageCreateEmpty failed");
+
+        auto exp_meta = sung::read_png_strips(
+            src_path,
+            ::PNG_STRIP_ROWS,
+            [&](const sung::PngMeta& meta) -> sung::ErrStr {
+                if (meta.width <= 0 || meta.height <= 0)
+                    return std::unexpected("empty image");
+                if (meta.bit_depth != 8)
+                    return std::unexpected("only 8-bit images supported");
+
+                image.reset(avifImageCreate(
+                    meta.width,
+                    meta.height,
+                    8,  // bit depth
+                    yuv_format
+                ));
+                if (!image)
+                    return std::unexpected("avifImageCreate failed");
+                image->alphaPremultiplied = AVIF_FALSE;
+
+                // Strips are converted through views that share these planes
+                const auto res = avifImageAllocatePlanes(
+                    image.get(), AVIF_PLANES_ALL
+                );
+                if (res != AVIF_RESULT_OK)
+                    return std::unexpected(avifResultToString(res));
+                return {};
+            },
+            [&](const uint8_t* rows, int first_row, int row_count)
+                -> sung::ErrStr {
+                sung::MonotonicRealtimeTimer yuv_timer;
+                const auto converted = sung::rgba_to_yuv(
+                    *image,
+                    rows,
+                    image->width * 4,
+                    static_cast<uint32_t>(first_row),
+                    static_cast<uint32_t>(row_count)
+                );
+                if (converted) {
+                    yuv_seconds += yuv_timer.elapsed();
+                    return {};
+                }
+
+                // Settings the converter above does not handle
+                const avifCropRect rect{
+                    0,
+                    static_cast<uint32_t>(first_row),
+                    image->width,
+                    static_cast<uint32_t>(row_count),
+                };
+                auto res = avifImageSetViewRect(view.get(), image.get(), &rect);
+                if (res != AVIF_RESULT_OK)
+                    return std::unexpected(avifResultToString(res));
+
+                avifRGBImage rgb;
+                avifRGBImageSetDefaults(&rgb, view.get());
+                rgb.depth = 8;
+                rgb.pixels = const_cast<uint8_t*>(rows);
+                rgb.rowBytes = image->width * 4;
+                rgb.format = AVIF_RGB_FORMAT_RGBA;
+
+                res = avifImageRGBToYUV(view.get(), &rgb);
+                if (res != AVIF_RESULT_OK)
+                    return std::unexpected(avifResultToString(res));
+                yuv_seconds += yuv_timer.elapsed();
+                return {};
+            }
+        );
+        if (!exp_meta)
+            return std::unexpected(exp_meta.error());
+
+        return YuvFrame{ std::move(*exp_meta), std::move(image), yuv_seconds };
+    }
+
+    // Tracks concurrent encodes for `AvifGenStats`
+    class InFlightGauge {
+
+    public:
+        explicit InFlightGauge(sung::AvifGenStats& stats) : stats_(stats) {
+            const auto now = ++stats_.in_flight_;
+            auto peak = stats_.peak_in_flight_.load();
+            while (peak < now &&
+                   !stats_.peak_in_flight_.compare_exchange_weak(peak, now)) {
+            }
+        }
+
+        ~InFlightGauge() { --stats_.in_flight_; }
+
+        InFlightGauge(const InFlightGauge&) = delete;
+        InFlightGauge& operator=(const InFlightGauge&) = delete;
+
+    private:
+        sung::AvifGenStats& stats_;
+    };
+
+    struct EncodedProxy {
+        std::vector<uint8_t> avif_;
+        // Packet embedded in `avif_`, handed back by the encoder
+        std::vector<uint8_t> xmp_;
+        // Of the source PNG, parsed once for the XMP packet and the
+        // quantizer cache
+        sung::ImageMetadata metadata_;
+    };
+
+    // Cache entry of a freshly written proxy. Takes the XMP packet, so only
+    // the workflow and the summary are copied from the source entry.
+    sung::ImageMetadata make_proxy_metadata(
+        const sung::ImageMetadata& source, std::vector<uint8_t>&& xmp
+    ) {
+        sung::ImageMetadata output;
+        output.width_ = source.width_;
+        output.height_ = source.height_;
+        output.avif_xmp_ = std::move(xmp);
+        if (const auto workflow = source.workflow())
+            output.workflow_ = *workflow;
+        output.model_ = source.model_;
+        output.prompts_ = source.prompts_;
+        return output;
+    }
+
     struct PngWorkItem {
         sung::Path path_;
         const sung::ServerConfigs::BindingInfo* binding_;
@@ -142,17 +262,128 @@ namespace {
         std::string materialization_id_;
     };
 
+    // A directory waiting in the walk. Folders the user browsed recently
+    // come first, then the most recently modified ones, which is where new
+    // outputs land.
+    struct DirVisit {
+        bool operator<(const DirVisit& rhs) const {
+            if (access_ns_ != rhs.access_ns_)
+                return access_ns_ < rhs.access_ns_;
+            return modified_ns_ < rhs.modified_ns_;
+        }
+
+        int64_t access_ns_ = 0;
+        int64_t modified_ns_ = 0;
+        sung::Path path_;
+        const sung::ServerConfigs::BindingInfo* binding_ = nullptr;
+    };
+
+    int64_t to_ns(const sung::fs::file_time_type time) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   time.time_since_epoch()
+        )
+            .count();
+    }
+
+    DirVisit make_dir_visit(
+        const sung::Path& dir,
+        const sung::fs::file_time_type modified,
+        const sung::ServerConfigs::BindingInfo& binding,
+        const sung::AccessRecency& access_recency
+    ) {
+        return DirVisit{
+            access_recency.last_access_ns(dir),
+            ::to_ns(modified),
+            dir,
+            &binding,
+        };
+    }
+
+    // Returns nothing if the PNG's proxy is current or it cannot be
+    // processed yet
+    std::optional<PngWorkItem> check_png_file(
+        const sung::fs::directory_entry& entry,
+        const sung::ServerConfigs::BindingInfo& binding_info,
+        const sung::ServerConfigs& cfg,
+        const sung::ImageIndex& image_index
+    ) {
+        std::error_code absolute_error;
+        auto source_path = sung::fs::absolute(entry.path(), absolute_error);
+        if (absolute_error)
+            source_path = entry.path().lexically_normal();
+        else
+            source_path = source_path.lexically_normal();
+
+        const auto source_fingerprint = sung::fingerprint_file(source_path);
+        auto analysis = source_fingerprint
+                            ? image_index.current_tag_analysis(
+                                  source_path, cfg.tagger_enabled_
+                              )
+                            : std::nullopt;
+        if (!source_fingerprint || (cfg.tagger_enabled_ && !analysis))
+            return std::nullopt;
+
+        const auto avif_opts = cfg.effective_avif_options(binding_info);
+        std::string materialization_id;
+        if (analysis) {
+            materialization_id = sung::make_proxy_materialization_id(
+                *analysis,
+                ::pix_format_name(avif_opts.pix_format_),
+                avif_opts.quality_,
+                avif_opts.speed_,
+                avif_opts.target_ssim_
+            );
+        }
+        const auto avif = sung::make_sprintboard_proxy_path(source_path);
+
+        // A generated AVIF carries the source's mtime from encode time, so
+        // anything other than an exact match means the source has changed
+        // since. This costs the same one stat per file as the previous
+        // exists() check; the source mtime comes from attributes the
+        // directory iteration already fetched.
+        std::error_code avif_error;
+        const auto avif_time = sung::fs::last_write_time(avif, avif_error);
+        bool up_to_date = false;
+        if (!avif_error) {
+            std::error_code png_error;
+            const auto png_time = entry.last_write_time(png_error);
+            up_to_date = !png_error && png_time == avif_time;
+            if (up_to_date && analysis) {
+                up_to_date = image_index.proxy_materialization_current(
+                    avif, materialization_id
+                );
+            }
+        }
+
+        if (up_to_date)
+            return std::nullopt;
+
+        return PngWorkItem{
+            std::move(source_path),
+            &binding_info,
+            *source_fingerprint,
+            std::move(analysis),
+            std::move(materialization_id),
+        };
+    }
+
 #if HAS_GENERATOR
     std::generator<PngWorkItem> gen_png_files(
 #else
     std::vector<PngWorkItem> gen_png_files(
 #endif
-        const sung::ServerConfigs& cfg, const sung::ImageIndex& image_index
+        const sung::ServerConfigs& cfg,
+        const sung::ImageIndex& image_index,
+        const sung::AccessRecency& access_recency
     ) {
 #if !HAS_GENERATOR
         std::vector<PngWorkItem> result;
 #endif
 
+        // Best-first instead of depth-first, so the few files encoded per
+        // tick come from the folders people are looking at rather than
+        // whichever binding sorts first.
+        std::priority_queue<DirVisit> pending;
         for (const auto& [name, binding_info] : cfg.dir_bindings_) {
             if (!cfg.effective_avif_options(binding_info).gen_)
                 continue;
@@ -161,157 +392,106 @@ namespace {
                 if (!sung::fs::is_directory(local_dir))
                     continue;
 
-                // Walks with the error-code API instead of the throwing
-                // recursive iterator: a volume that fails mid-scan (e.g. EIO
-                // from a flaky external drive) must only cost the unreadable
-                // subtree, not the process. The next scan retries whatever
-                // was skipped.
-                std::vector<sung::Path> pending{ local_dir };
-                while (!pending.empty()) {
-                    const auto dir = std::move(pending.back());
-                    pending.pop_back();
-
-                    std::error_code iter_error;
-                    auto entry_it = sung::fs::directory_iterator(
-                        dir, iter_error
-                    );
-                    if (iter_error) {
-                        std::println(
-                            "ImgWalker: Skipping unreadable directory {}: {}",
-                            sung::tostr(dir),
-                            iter_error.message()
+                std::error_code time_error;
+                const auto modified = sung::fs::last_write_time(
+                    local_dir, time_error
+                );
+                pending.push(::make_dir_visit(
+                    local_dir,
+                    time_error ? sung::fs::file_time_type{} : modified,
+                    binding_info,
+                    access_recency
+                ));
+            }
+        }
+
+        // Walks with the error-code API instead of the throwing recursive
+        // iterator: a volume that fails mid-scan (e.g. EIO from a flaky
+        // external drive) must only cost the unreadable subtree, not the
+        // process. The next scan retries whatever was skipped.
+        while (!pending.empty()) {
+            const auto visit = pending.top();
+            pending.pop();
+            const auto& dir = visit.path_;
+
+            std::error_code iter_error;
+            auto entry_it = sung::fs::directory_iterator(dir, iter_error);
+            if (iter_error) {
+                std::println(
+                    "ImgWalker: Skipping unreadable directory {}: {}",
+                    sung::tostr(dir),
+                    iter_error.message()
+                );
+                continue;
+            }
+
+            std::vector<PngWorkItem> items;
+            const sung::fs::directory_iterator dir_end;
+            while (entry_it != dir_end) {
+                const auto& entry = *entry_it;
+
+                // Queue subdirectories without following symlinks, matching
+                // recursive_directory_iterator's default.
+                std::error_code type_error;
+                if (entry.is_directory(type_error) && !type_error) {
+                    if (!entry.is_symlink(type_error) && !type_error) {
+                        std::error_code time_error;
+                        const auto modified = entry.last_write_time(
+                            time_error
                         );
-                        continue;
+                        pending.push(::make_dir_visit(
+                            entry.path(),
+                            time_error ? sung::fs::file_time_type{}
+                                       : modified,
+                            *visit.binding_,
+                            access_recency
+                        ));
                     }
+                }
+
+                auto ext_str = sung::tostr(entry.path().extension());
+                ext_str = absl::AsciiStrToLower(ext_str);
+                if (ext_str == ".png") {
+                    auto item = ::check_png_file(
+                        entry, *visit.binding_, cfg, image_index
+                    );
+                    if (item)
+                        items.push_back(std::move(*item));
+                }
+
+                entry_it.increment(iter_error);
+                if (iter_error) {
+                    std::println(
+                        "ImgWalker: Stopping scan of directory {}: {}",
+                        sung::tostr(dir),
+                        iter_error.message()
+                    );
+                    break;
+                }
+            }
 
-                    const sung::fs::directory_iterator dir_end;
-                    while (entry_it != dir_end) {
-                        const auto& entry = *entry_it;
-
-                        // Queue subdirectories without following symlinks,
-                        // matching recursive_directory_iterator's default.
-                        std::error_code type_error;
-                        if (entry.is_directory(type_error) && !type_error) {
-                            if (!entry.is_symlink(type_error) && !type_error)
-                                pending.push_back(entry.path());
-                        }
-
-                        auto ext_str = sung::tostr(entry.path().extension());
-                        ext_str = absl::AsciiStrToLower(ext_str);
-                        if (ext_str == ".png") {
-                            std::error_code absolute_error;
-                            auto source_path = sung::fs::absolute(
-                                entry.path(), absolute_error
-                            );
-                            if (absolute_error)
-                                source_path = entry.path().lexically_normal();
-                            else
-                                source_path = source_path.lexically_normal();
-
-                            const auto source_fingerprint =
-                                sung::fingerprint_file(source_path);
-                            auto analysis =
-                                source_fingerprint
-                                    ? image_index.current_tag_analysis(
-                                          source_path, cfg.tagger_enabled_
-                                      )
-                                    : std::nullopt;
-                            if (!source_fingerprint ||
-                                (cfg.tagger_enabled_ && !analysis)) {
-                                entry_it.increment(iter_error);
-                                if (iter_error) {
-                                    std::println(
-                                        "ImgWalker: Stopping scan of "
-                                        "directory {}: {}",
-                                        sung::tostr(dir),
-                                        iter_error.message()
-                                    );
-                                    break;
-                                }
-                                continue;
-                            }
-
-                            const auto avif_opts = cfg.effective_avif_options(
-                                binding_info
-                            );
-                            std::string materialization_id;
-                            if (analysis) {
-                                materialization_id =
-                                    sung::make_proxy_materialization_id(
-                                        *analysis,
-                                        ::pix_format_name(
-                                            avif_opts.pix_format_
-                                        ),
-                                        avif_opts.quality_,
-                                        avif_opts.speed_
-                                    );
-                            }
-                            const auto avif = sung::make_sprintboard_proxy_path(
-                                source_path
-                            );
-
-                            // A generated AVIF carries the source's mtime
-                            // from encode time, so anything other than an
-                            // exact match means the source has changed since.
-                            // This costs the same one stat per file as the
-                            // previous exists() check; the source mtime comes
-                            // from attributes the directory iteration already
-                            // fetched.
-                            std::error_code avif_error;
-                            const auto avif_time = sung::fs::last_write_time(
-                                avif, avif_error
-                            );
-                            bool up_to_date = false;
-                            if (!avif_error) {
-                                std::error_code png_error;
-                                const auto png_time = entry.last_write_time(
-                                    png_error
-                                );
-                                up_to_date = !png_error &&
-                                             png_time == avif_time;
-                                if (up_to_date && analysis) {
-                                    up_to_date =
-                                        image_index
-                                            .proxy_materialization_current(
-                                                avif, materialization_id
-                                            );
-                                }
-                            }
-
-                            if (!up_to_date) {
+            // Newest first, in the same order the gallery lists them. Only
+            // PNGs that need work are ranked, so an up-to-date directory
+            // costs no extra stat per file each tick.
+            std::vector<std::pair<int64_t, size_t>> order;
+            order.reserve(items.size());
+            for (size_t i = 0; i < items.size(); ++i) {
+                order.emplace_back(
+                    sung::detail::read_image_sort_time(items[i].path_), i
+                );
+            }
+            std::stable_sort(
+                order.begin(),
+                order.end(),
+                [](const auto& a, const auto& b) { return a.first > b.first; }
+            );
+
+            for (const auto& [sort_time, index] : order) {
 #if HAS_GENERATOR
-                                co_yield PngWorkItem{
-                                    source_path,
-                                    &binding_info,
-                                    *source_fingerprint,
-                                    std::move(analysis),
-                                    std::move(materialization_id),
-                                };
+                co_yield std::move(items[index]);
 #else
-                                result.push_back(
-                                    {
-                                        source_path,
-                                        &binding_info,
-                                        *source_fingerprint,
-                                        std::move(analysis),
-                                        std::move(materialization_id),
-                                    }
-                                );
+                result.push_back(std::move(items[index]));
 #endif
-                            }
-                        }
-
-                        entry_it.increment(iter_error);
-                        if (iter_error) {
-                            std::println(
-                                "ImgWalker: Stopping scan of directory {}: {}",
-                                sung::tostr(dir),
-                                iter_error.message()
-                            );
-                            break;
-                        }
-                    }
-                }
             }
         }
 
@@ -331,9 +511,17 @@ namespace {
         Task(
             const sung::ServerConfigManager& cfg,
             sung::GatedPowerRequest& power_req,
-            sung::ImageIndex& image_index
+            sung::ImageIndex& image_index,
+            const sung::AccessRecency& access_recency,
+            sung::MetadataCache& metadata_cache,
+            sung::AvifGenStats& stats
         )
-            : cfg_(cfg), power_req_(power_req), image_index_(image_index) {}
+            : cfg_(cfg)
+            , power_req_(power_req)
+            , image_index_(image_index)
+            , access_recency_(access_recency)
+            , metadata_cache_(metadata_cache)
+            , stats_(stats) {}
 
         ~Task() noexcept override { tg_.wait(); }
 
@@ -343,123 +531,291 @@ namespace {
                 return;
 
             size_t count = 0;
-            for (const auto& item : ::gen_png_files(*svrcfg, image_index_)) {
+            auto items = ::gen_png_files(
+                *svrcfg, image_index_, access_recency_
+            );
+            for (const auto& item : items) {
                 ++count;
 
                 const auto avif_opts = svrcfg->effective_avif_options(
                     *item.binding_
                 );
-                tg_.run([p = item.path_,
-                         source_fingerprint = item.source_fingerprint_,
-                         analysis = item.analysis_,
-                         materialization_id = item.materialization_id_,
-                         avif_opts,
-                         this]() {
-                    const sung::ScopedWakeLock wake_lock{ power_req_ };
-                    sung::MonotonicRealtimeTimer one_timer;
-
-                    // Captured before reading the pixels: if the source is
-                    // edited while encoding, the AVIF keeps the pre-edit
-                    // timestamp, and the mismatch makes a later scan
-                    // regenerate it.
-                    sung::FileTimestamps src_timestamps;
-                    const auto src_ts_error = sung::read_file_timestamps(
-                        p, src_timestamps
+                tg_.run([item, avif_opts, this]() {
+                    this->materialize(item, avif_opts);
+                });
+
+                if (count > 32)
+                    break;
+            }
+
+            tg_.wait();
+        }
+
+    private:
+        void materialize(
+            const PngWorkItem& item,
+            const sung::ServerConfigs::AvifOptions& avif_opts
+        ) {
+            const auto& p = item.path_;
+            const sung::ScopedWakeLock wake_lock{ power_req_ };
+            const ::InFlightGauge in_flight{ stats_ };
+            sung::MonotonicRealtimeTimer one_timer;
+
+            // Captured before reading the pixels: if the source is
+            // edited while encoding, the AVIF keeps the pre-edit
+            // timestamp, and the mismatch makes a later scan
+            // regenerate it.
+            sung::FileTimestamps src_timestamps;
+            const auto src_ts_error = sung::read_file_timestamps(
+                p, src_timestamps
+            );
+
+            // The materialization id already covers the source hash and
+            // every encode setting. Untagged sources are hashed here.
+            sung::MonotonicRealtimeTimer fingerprint_timer;
+            auto dedup_key = item.materialization_id_;
+            if (dedup_key.empty()) {
+                if (const auto hashed = image_index_.hash_file(p)) {
+                    dedup_key = sung::ProxyDedupCache::make_key(
+                        hashed->sha256_,
+                        ::pix_format_name(avif_opts.pix_format_),
+                        avif_opts.quality_,
+                        avif_opts.speed_,
+                        avif_opts.target_ssim_
                     );
+                }
+            }
+            auto fingerprint_seconds = fingerprint_timer.elapsed();
+
+            std::optional<sung::Path> copy_from;
+            std::optional<sung::ProxyDedupClaim> dedup_claim;
+            if (!dedup_key.empty()) {
+                auto lookup = dedup_.find_or_claim(dedup_key);
+                // Identical content is being encoded by another worker; the
+                // next scan finds its proxy and copies it.
+                if (!lookup.proxy_ && !lookup.claim_)
+                    return;
+                copy_from = std::move(lookup.proxy_);
+                dedup_claim = std::move(lookup.claim_);
+            }
 
-                    const auto png_data = sung::read_png(p);
-                    if (!png_data)
-                        return;
-
-                    sung::AvifEncodeParams avif_params;
-                    avif_params.set_quality(avif_opts.quality_);
-                    avif_params.set_speed(avif_opts.speed_);
-                    if (analysis) {
-                        avif_params.set_xmp(
-                            sung::make_xmp_packet(
-                                *png_data,
-                                sung::make_embedded_tag_analysis(*analysis)
-                            )
-                        );
-                    } else {
-                        avif_params.set_xmp(sung::make_xmp_packet(*png_data));
-                    }
-                    avif_params.set_yuv_format(
-                        ::conv_pix_format(avif_opts.pix_format_)
+            EncodedProxy encoded_proxy;
+            const auto& avif_blob = encoded_proxy.avif_;
+            if (!copy_from) {
+                auto encoded = this->encode_proxy(item, avif_opts);
+                if (!encoded) {
+                    ++stats_.files_failed_;
+                    std::println(
+                        "ImgWalker: AVIF encoding failed for {}: {}",
+                        sung::tostr(p),
+                        encoded.error()
                     );
+                    return;
+                }
+                encoded_proxy = std::move(*encoded);
+            }
 
-                    const auto avif_blob = encode_avif(*png_data, avif_params);
-                    if (!avif_blob) {
-                        std::println(
-                            "ImgWalker: AVIF encoding failed for {}: {}",
-                            sung::tostr(p),
-                            avif_blob.error()
-                        );
-                        return;
-                    }
+            const auto avif_path = sung::make_sprintboard_proxy_path(p);
+            fingerprint_timer.check();
+            const auto current_fingerprint = sung::fingerprint_file(p);
+            fingerprint_seconds += fingerprint_timer.elapsed();
+            stats_.fingerprint_.record(fingerprint_seconds);
+            if (!current_fingerprint ||
+                *current_fingerprint != item.source_fingerprint_) {
+                std::println(
+                    "ImgWalker: Source PNG changed, skipping: {}",
+                    sung::tostr(p)
+                );
+                return;
+            }
 
-                    const auto avif_path = sung::make_sprintboard_proxy_path(p);
-                    const auto current_fingerprint = sung::fingerprint_file(p);
-                    if (!current_fingerprint ||
-                        *current_fingerprint != source_fingerprint) {
-                        std::println(
-                            "ImgWalker: Source PNG changed, skipping: {}",
-                            sung::tostr(p)
-                        );
-                        return;
-                    }
+            sung::MonotonicRealtimeTimer write_timer;
+            std::error_code write_error;
+            const auto saved = copy_from
+                                   ? sung::copy_file_atomically(
+                                         *copy_from, avif_path, write_error
+                                     )
+                                   : sung::write_file_atomically(
+                                         avif_path, avif_blob, write_error
+                                     );
+            if (!saved) {
+                ++stats_.files_failed_;
+                std::println(
+                    "ImgWalker: Failed to save AVIF {}: {}",
+                    sung::tostr(avif_path),
+                    write_error.message()
+                );
+                return;
+            }
 
-                    std::error_code write_error;
-                    if (!sung::write_file_atomically(
-                            avif_path, *avif_blob, write_error
-                        )) {
-                        std::println(
-                            "ImgWalker: Failed to save AVIF {}: {}",
-                            sung::tostr(avif_path),
-                            write_error.message()
-                        );
-                        return;
-                    }
+            const auto timestamp_error =
+                src_ts_error
+                    ? src_ts_error
+                    : sung::set_file_timestamps(avif_path, src_timestamps);
+            if (timestamp_error) {
+                std::println(
+                    "ImgWalker: Failed to copy timestamps from {} to {}: {}",
+                    sung::tostr(p),
+                    sung::tostr(avif_path),
+                    timestamp_error.message()
+                );
+            }
+            stats_.write_.record(write_timer.elapsed());
+
+            // Saves the index and the details endpoint from parsing either
+            // file again. The proxy carries the same workflow in its XMP.
+            if (!copy_from) {
+                if (const auto stamp = sung::fingerprint_file(avif_path)) {
+                    metadata_cache_.insert(
+                        avif_path,
+                        *stamp,
+                        ::make_proxy_metadata(
+                            encoded_proxy.metadata_,
+                            std::move(encoded_proxy.xmp_)
+                        )
+                    );
+                }
+                metadata_cache_.insert(
+                    p,
+                    *current_fingerprint,
+                    std::move(encoded_proxy.metadata_)
+                );
+            }
 
-                    const auto timestamp_error =
-                        src_ts_error ? src_ts_error
-                                     : sung::set_file_timestamps(
-                                           avif_path, src_timestamps
-                                       );
-                    if (timestamp_error) {
-                        std::println(
-                            "ImgWalker: Failed to copy timestamps from {} to "
-                            "{}: {}",
-                            sung::tostr(p),
-                            sung::tostr(avif_path),
-                            timestamp_error.message()
-                        );
-                    }
+            if (item.analysis_) {
+                image_index_.mark_proxy_materialized(
+                    p, avif_path, item.materialization_id_
+                );
+            }
+            if (dedup_claim)
+                dedup_claim->publish(avif_path);
+
+            stats_.total_.record(one_timer.elapsed());
+            if (copy_from) {
+                ++stats_.files_copied_;
+            } else {
+                ++stats_.files_encoded_;
+                stats_.bytes_in_ += static_cast<uint64_t>(
+                    item.source_fingerprint_.size_
+                );
+                stats_.bytes_out_ += avif_blob.size();
+            }
 
-                    if (analysis) {
-                        image_index_.mark_proxy_materialized(
-                            p, avif_path, materialization_id
-                        );
-                    }
+            if (copy_from) {
+                std::println(
+                    "ImgWalker: AVIF copied from identical source: {} ({:.3f} "
+                    "sec)",
+                    sung::tostr(avif_path),
+                    one_timer.elapsed()
+                );
+            } else {
+                std::println(
+                    "ImgWalker: AVIF saved: {} ({:.3f} sec)",
+                    sung::tostr(avif_path),
+                    one_timer.elapsed()
+                );
+            }
+        }
 
-                    std::println(
-                        "ImgWalker: AVIF saved: {} ({:.3f} sec)",
-                        sung::tostr(avif_path),
-                        one_timer.elapsed()
-                    );
-                });
+        std::expected<EncodedProxy, std::string> encode_proxy(
+            const PngWorkItem& item,
+            const sung::ServerConfigs::AvifOptions& avif_opts
+        ) {
+            sung::MonotonicRealtimeTimer decode_timer;
+            const auto frame = ::read_png_as_yuv(
+                item.path_, ::conv_pix_format(avif_opts.pix_format_)
+            );
+            if (!frame)
+                return std::unexpected(frame.error());
+            stats_.decode_.record(
+                std::max(0.0, decode_timer.elapsed() - frame->yuv_seconds_)
+            );
+            stats_.yuv_.record(frame->yuv_seconds_);
+
+            auto xmp = item.analysis_
+                           ? sung::make_xmp_blob(
+                                 frame->meta_,
+                                 sung::make_embedded_tag_analysis(
+                                     *item.analysis_
+                                 )
+                             )
+                           : sung::make_xmp_blob(frame->meta_);
+            EncodedProxy output;
+            output.metadata_ = sung::make_image_metadata(frame->meta_);
+
+            sung::AvifEncodeParams avif_params;
+            avif_params.set_quality(avif_opts.quality_);
+            avif_params.set_speed(avif_opts.speed_);
+            avif_params.set_xmp(std::move(xmp));
+            avif_params.set_yuv_format(
+                ::conv_pix_format(avif_opts.pix_format_)
+            );
+            if (avif_opts.target_ssim_ > 0) {
+                avif_params.set_quantizer(this->pick_quantizer(
+                    *frame,
+                    output.metadata_.model_,
+                    avif_params,
+                    avif_opts.target_ssim_
+                ));
+            }
 
-                if (count > 32)
-                    break;
+            sung::MonotonicRealtimeTimer encode_timer;
+            auto encoded = ::encode_avif(frame->image_.get(), avif_params);
+            stats_.encode_.record(encode_timer.elapsed());
+            if (!encoded)
+                return std::unexpected(encoded.error());
+            output.avif_ = std::move(*encoded);
+            output.xmp_ = avif_params.take_xmp();
+            return output;
+        }
+
+        // Returns nullopt to fall back to the plain quality mapping
+        std::optional<int> pick_quantizer(
+            const YuvFrame& frame,
+            const std::string& model,
+            const sung::AvifEncodeParams& params,
+            const double target_ssim
+        ) {
+            const sung::AvifQuantizerCache::Key key{
+                model,
+                sung::AvifQuantizerCache::resolution_bucket(
+                    frame.image_->width, frame.image_->height
+                ),
+                target_ssim,
+            };
+            if (const auto cached = quantizer_cache_.find(key))
+                return cached;
+
+            sung::MonotonicRealtimeTimer search_timer;
+            const auto found = sung::search_avif_quantizer(
+                *frame.image_, params, target_ssim
+            );
+            stats_.quality_search_.record(search_timer.elapsed());
+            if (!found) {
+                std::println(
+                    "ImgWalker: Quantizer search failed: {}", found.error()
+                );
+                return std::nullopt;
             }
 
-            tg_.wait();
+            quantizer_cache_.store(key, *found);
+            std::println(
+                "ImgWalker: Quantizer {} chosen for model '{}' at SSIM {}",
+                *found,
+                key.model_,
+                target_ssim
+            );
+            return *found;
         }
 
-    private:
         const sung::ServerConfigManager& cfg_;
         sung::GatedPowerRequest& power_req_;
         sung::ImageIndex& image_index_;
+        const sung::AccessRecency& access_recency_;
+        sung::MetadataCache& metadata_cache_;
+        sung::AvifGenStats& stats_;
+        sung::AvifQuantizerCache quantizer_cache_;
+        sung::ProxyDedupCache dedup_;
         tbb::task_group tg_;
     };
 
@@ -468,12 +824,46 @@ namespace {
 
 namespace sung {
 
+    nlohmann::json AvifGenStats::make_json() const {
+        const auto bytes_in = bytes_in_.load();
+        const auto bytes_out = bytes_out_.load();
+        const auto ratio = bytes_in > 0 ? static_cast<double>(bytes_out) /
+                                              static_cast<double>(bytes_in)
+                                        : 0.0;
+
+        return {
+            { "filesEncoded", files_encoded_.load() },
+            { "filesCopied", files_copied_.load() },
+            { "filesFailed", files_failed_.load() },
+            { "bytesIn", bytes_in },
+            { "bytesOut", bytes_out },
+            { "compressionRatio", ratio },
+            { "inFlight", in_flight_.load() },
+            { "peakInFlight", peak_in_flight_.load() },
+            { "stages",
+              {
+                  { "decode", decode_.summarize().make_json() },
+                  { "yuv", yuv_.summarize().make_json() },
+                  { "qualitySearch", quality_search_.summarize().make_json() },
+                  { "encode", encode_.summarize().make_json() },
+                  { "fingerprint", fingerprint_.summarize().make_json() },
+                  { "write", write_.summarize().make_json() },
+                  { "total", total_.summarize().make_json() },
+              } },
+        };
+    }
+
     std::shared_ptr<ITask> create_img_walker_task(
         const ServerConfigManager& cfg,
         sung::GatedPowerRequest& power_req,
-        ImageIndex& image_index
+        ImageIndex& image_index,
+        const AccessRecency& access_recency,
+        MetadataCache& metadata_cache,
+        AvifGenStats& stats
     ) {
-        return std::make_shared<::Task>(cfg, power_req, image_index);
+        return std::make_shared<::Task>(
+            cfg, power_req, image_index, access_recency, metadata_cache, stats
+        );
     }
 
 }  // namespace sung
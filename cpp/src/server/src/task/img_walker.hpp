@@ -1,20 +1,54 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
 #include "sung/auxiliary/server_configs.hpp"
+#include "util/metrics.hpp"
 #include "util/task.hpp"
 #include "util/wake.hpp"
 
 
 namespace sung {
 
+    class AccessRecency;
     class ImageIndex;
+    class MetadataCache;
 
     constexpr double AVIF_ENCODE_TIME_INTERVAL = 3;
 
+    // Per-stage timings and volume counters of AVIF proxy generation, served
+    // by `/api/stats/avif`.
+    struct AvifGenStats {
+        nlohmann::json make_json() const;
+
+        LatencyHistogram decode_;          // PNG read and inflate
+        LatencyHistogram yuv_;             // RGB to YUV conversion
+        LatencyHistogram quality_search_;  // Trial encodes on cache misses
+        LatencyHistogram encode_;          // AV1 encode and muxing
+        LatencyHistogram fingerprint_;     // Source hashing and change checks
+        LatencyHistogram write_;           // Atomic write or copy, timestamps
+        LatencyHistogram total_;           // Whole file, successful ones only
+
+        std::atomic<uint64_t> files_encoded_ = 0;
+        std::atomic<uint64_t> files_copied_ = 0;
+        std::atomic<uint64_t> files_failed_ = 0;
+        // Source PNG and output AVIF sizes of encoded files
+        std::atomic<uint64_t> bytes_in_ = 0;
+        std::atomic<uint64_t> bytes_out_ = 0;
+        std::atomic<int> in_flight_ = 0;
+        std::atomic<int> peak_in_flight_ = 0;
+    };
+
     std::shared_ptr<ITask> create_img_walker_task(
         const ServerConfigManager& cfg,
         sung::GatedPowerRequest& power_req,
-        ImageIndex& image_index
+        ImageIndex& image_index,
+        const AccessRecency& access_recency,
+        MetadataCache& metadata_cache,
+        AvifGenStats& stats
     );
 
 }  // namespace sung
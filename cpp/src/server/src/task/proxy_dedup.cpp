@@ -0,0 +1,134 @@
+#include "task/proxy_dedup.hpp"
+
+#include <algorithm>
+#include <format>
+#include <iterator>
+#include <utility>
+
+
+// ProxyDedupClaim
+namespace sung {
+
+    ProxyDedupClaim::ProxyDedupClaim(ProxyDedupCache& cache, std::string key)
+        : cache_(&cache), key_(std::move(key)) {}
+
+    ProxyDedupClaim::~ProxyDedupClaim() {
+        if (cache_)
+            cache_->release(key_);
+    }
+
+    ProxyDedupClaim::ProxyDedupClaim(ProxyDedupClaim&& other) noexcept
+        : cache_(std::exchange(other.cache_, nullptr))
+        , key_(std::move(other.key_)) {}
+
+    ProxyDedupClaim& ProxyDedupClaim::operator=(
+        ProxyDedupClaim&& other
+    ) noexcept {
+        if (this != &other) {
+            if (cache_)
+                cache_->release(key_);
+            cache_ = std::exchange(other.cache_, nullptr);
+            key_ = std::move(other.key_);
+        }
+        return *this;
+    }
+
+    void ProxyDedupClaim::publish(const Path& proxy) {
+        if (!cache_)
+            return;
+        cache_->publish(key_, proxy);
+        cache_->release(key_);
+        cache_ = nullptr;
+    }
+
+}  // namespace sung
+
+
+// ProxyDedupCache
+namespace sung {
+
+    ProxyDedupCache::ProxyDedupCache(size_t capacity)
+        : capacity_(std::max<size_t>(capacity, 1)) {}
+
+    ProxyDedupCache::Lookup ProxyDedupCache::find_or_claim(
+        const std::string& key
+    ) {
+        std::optional<Published> published;
+        {
+            std::lock_guard lock(mut_);
+            if (const auto found = entries_.find(key); found != entries_.end())
+                published = found->second.published_;
+        }
+
+        // Stat without the lock, so a slow disk does not hold up the other
+        // workers
+        if (published) {
+            const auto current = sung::fingerprint_file(published->proxy_);
+            if (current && *current == published->fingerprint_)
+                return Lookup{ published->proxy_, std::nullopt };
+        }
+
+        std::lock_guard lock(mut_);
+        if (published) {
+            // Leaves an entry published again while the lock was released
+            const auto found = entries_.find(key);
+            if (found != entries_.end() &&
+                found->second.published_.proxy_ == published->proxy_ &&
+                found->second.published_.fingerprint_ ==
+                    published->fingerprint_) {
+                order_.erase(found->second.order_it_);
+                entries_.erase(found);
+            }
+        }
+
+        if (!in_flight_.insert(key).second)
+            return Lookup{};
+
+        return Lookup{ std::nullopt, ProxyDedupClaim{ *this, key } };
+    }
+
+    std::string ProxyDedupCache::make_key(
+        const std::string_view source_sha256,
+        const std::string_view pixel_format,
+        const double quality,
+        const int speed,
+        const double target_ssim
+    ) {
+        return std::format(
+            "{}\n{}\n{:.17g}\n{}\n{:.17g}",
+            source_sha256,
+            pixel_format,
+            quality,
+            speed,
+            target_ssim
+        );
+    }
+
+    void ProxyDedupCache::publish(const std::string& key, const Path& proxy) {
+        const auto fingerprint = sung::fingerprint_file(proxy);
+        if (!fingerprint)
+            return;
+
+        std::lock_guard lock(mut_);
+        Published published{ proxy, *fingerprint };
+        if (const auto found = entries_.find(key); found != entries_.end()) {
+            found->second.published_ = std::move(published);
+            return;
+        }
+
+        order_.push_back(key);
+        entries_.emplace(
+            key, Entry{ std::move(published), std::prev(order_.end()) }
+        );
+        while (entries_.size() > capacity_ && !order_.empty()) {
+            entries_.erase(order_.front());
+            order_.pop_front();
+        }
+    }
+
+    void ProxyDedupCache::release(const std::string& key) {
+        std::lock_guard lock(mut_);
+        in_flight_.erase(key);
+    }
+
+}  // namespace sung
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "sung/auxiliary/path.hpp"
+#include "tag_sidecar.hpp"
+
+
+namespace sung {
+
+    class ProxyDedupCache;
+
+
+    // Exclusive right to encode the proxy for one dedup key. Dropping the
+    // claim without `publish` lets the next scan try again.
+    class ProxyDedupClaim {
+
+    public:
+        ProxyDedupClaim() = default;
+        ProxyDedupClaim(ProxyDedupCache& cache, std::string key);
+        ~ProxyDedupClaim();
+
+        ProxyDedupClaim(const ProxyDedupClaim&) = delete;
+        ProxyDedupClaim& operator=(const ProxyDedupClaim&) = delete;
+        ProxyDedupClaim(ProxyDedupClaim&& other) noexcept;
+        ProxyDedupClaim& operator=(ProxyDedupClaim&& other) noexcept;
+
+        // Records `proxy` as the encoded result once it is on disk with its
+        // final timestamps.
+        void publish(const Path& proxy);
+
+    private:
+        ProxyDedupCache* cache_ = nullptr;
+        std::string key_;
+    };
+
+
+    // Maps source content plus encode settings to a proxy already encoded
+    // for it, so identical PNGs in different folders are encoded once and
+    // copied for the rest.
+    class ProxyDedupCache {
+
+    public:
+        struct Lookup {
+            // Set when an up-to-date proxy with the same content exists
+            std::optional<Path> proxy_;
+            // Owned when the caller should encode; empty if another worker
+            // is already encoding the same content
+            std::optional<ProxyDedupClaim> claim_;
+        };
+
+        explicit ProxyDedupCache(size_t capacity = 4096);
+
+        Lookup find_or_claim(const std::string& key);
+
+        // Key for sources without a materialization id
+        static std::string make_key(
+            std::string_view source_sha256,
+            std::string_view pixel_format,
+            double quality,
+            int speed,
+            double target_ssim
+        );
+
+    private:
+        friend class ProxyDedupClaim;
+
+        struct Published {
+            Path proxy_;
+            // Detects a proxy replaced or edited since it was published
+            FileFingerprint fingerprint_;
+        };
+
+        struct Entry {
+            Published published_;
+            // Position in `order_`, so removal does not scan it
+            std::list<std::string>::iterator order_it_;
+        };
+
+        void publish(const std::string& key, const Path& proxy);
+        void release(const std::string& key);
+
+        std::mutex mut_;
+        std::unordered_map<std::string, Entry> entries_;
+        // Insertion order, oldest first, for eviction
+        std::list<std::string> order_;
+        std::unordered_set<std::string> in_flight_;
+        size_t capacity_;
+    };
+
+}  // namespace sung
@@ -0,0 +1,102 @@
+#include "util/access_recency.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include <absl/strings/ascii.h>
+#include <sung/basic/os_detect.hpp>
+
+
+namespace {
+
+    sung::Path normalize(const sung::Path& dir) {
+        std::error_code ec;
+        auto output = sung::fs::absolute(dir, ec);
+        if (ec)
+            output = dir;
+        output = output.lexically_normal();
+        // "a/b/" and "a/b" must compare equal
+        if (!output.has_filename() && output.has_parent_path())
+            output = output.parent_path();
+        return output;
+    }
+
+    // Component-wise, so "a/bc" is not inside "a/b"
+    bool is_within(const sung::Path& child, const sung::Path& parent) {
+        auto child_it = child.begin();
+        for (const auto& part : parent) {
+            if (child_it == child.end() || *child_it != part)
+                return false;
+            ++child_it;
+        }
+        return true;
+    }
+
+}  // namespace
+
+
+namespace sung {
+
+    AccessRecency::AccessRecency(size_t capacity)
+        : capacity_(std::max<size_t>(capacity, 1)) {}
+
+    void AccessRecency::touch(const Path& dir, const bool recursive) {
+        const auto now = std::chrono::system_clock::now().time_since_epoch();
+        this->touch(
+            dir,
+            recursive,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()
+        );
+    }
+
+    void AccessRecency::touch(
+        const Path& dir, const bool recursive, const int64_t time_ns
+    ) {
+        auto path = ::normalize(dir);
+        auto key = make_key(path);
+
+        std::lock_guard lock(mut_);
+        auto& entry = entries_[std::move(key)];
+        entry.path_ = std::move(path);
+        entry.time_ns_ = std::max(entry.time_ns_, time_ns);
+        entry.recursive_ = recursive;
+
+        if (entries_.size() > capacity_) {
+            const auto oldest = std::min_element(
+                entries_.begin(),
+                entries_.end(),
+                [](const auto& a, const auto& b) {
+                    return a.second.time_ns_ < b.second.time_ns_;
+                }
+            );
+            entries_.erase(oldest);
+        }
+    }
+
+    int64_t AccessRecency::last_access_ns(const Path& dir) const {
+        const auto path = ::normalize(dir);
+
+        std::lock_guard lock(mut_);
+        int64_t output = 0;
+        for (const auto& [key, entry] : entries_) {
+            if (entry.time_ns_ <= output)
+                continue;
+
+            const auto related = ::is_within(entry.path_, path) ||
+                                 (entry.recursive_ &&
+                                  ::is_within(path, entry.path_));
+            if (related)
+                output = entry.time_ns_;
+        }
+        return output;
+    }
+
+    std::string AccessRecency::make_key(const Path& dir) {
+        auto output = sung::tostr(dir);
+#if defined(SUNG_OS_WINDOWS)
+        absl::AsciiStrToLower(&output);
+#endif
+        return output;
+    }
+
+}  // namespace sung
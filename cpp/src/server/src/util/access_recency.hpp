@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "sung/auxiliary/path.hpp"
+
+
+namespace sung {
+
+    // Remembers which local directories were browsed recently, so background
+    // work can start where the user is looking.
+    class AccessRecency {
+
+    public:
+        explicit AccessRecency(size_t capacity = 256);
+
+        // `recursive` marks a listing that also showed every subfolder
+        void touch(const Path& dir, bool recursive = false);
+        void touch(const Path& dir, bool recursive, int64_t time_ns);
+
+        // Latest access of `dir` itself, of a folder inside it (the walk
+        // must pass through `dir` to reach it), or of a recursive listing
+        // containing it. 0 if none is remembered.
+        int64_t last_access_ns(const Path& dir) const;
+
+    private:
+        struct Entry {
+            Path path_;
+            int64_t time_ns_ = 0;
+            bool recursive_ = false;
+        };
+
+        static std::string make_key(const Path& dir);
+
+        mutable std::mutex mut_;
+        std::unordered_map<std::string, Entry> entries_;
+        size_t capacity_;
+    };
+
+}  // namespace sung
@@ -0,0 +1,164 @@
+#include "util/metadata_cache.hpp"
+
+#include <absl/strings/ascii.h>
+#include <sung/basic/os_detect.hpp>
+
+#include "sung/auxiliary/comfyui_workflow.hpp"
+
+
+namespace {
+
+    // Rough heap cost of the bookkeeping around each entry: list node, map
+    // node, key and the shared block
+    constexpr size_t ENTRY_OVERHEAD_BYTES = 256;
+
+}  // namespace
+
+
+// ImageMetadata
+namespace sung {
+
+    size_t ImageMetadata::byte_size() const {
+        size_t output = sizeof(ImageMetadata);
+        if (png_text_) {
+            for (const auto& kv : *png_text_)
+                output += sizeof(kv) + kv.key.size() + kv.value.size();
+        }
+        if (avif_xmp_)
+            output += avif_xmp_->size();
+        if (workflow_)
+            output += workflow_->size();
+        output += model_.size();
+        for (const auto& prompt : prompts_)
+            output += sizeof(prompt) + prompt.size();
+        return output;
+    }
+
+    const std::string* ImageMetadata::workflow() const {
+        if (png_text_) {
+            for (const auto& kv : *png_text_) {
+                if (kv.key == "workflow")
+                    return &kv.value;
+            }
+        }
+        return workflow_ ? &*workflow_ : nullptr;
+    }
+
+    ImageMetadata make_image_metadata(const PngMeta& meta) {
+        ImageMetadata output;
+        output.width_ = meta.width;
+        output.height_ = meta.height;
+        output.png_text_ = meta.text;
+
+        if (const auto workflow = meta.find_text_chunk("workflow")) {
+            const auto summary = sung::summarize_comfyui_workflow(
+                workflow->data(), workflow->size()
+            );
+            if (summary) {
+                output.model_ = summary->model_;
+                output.prompts_ = summary->prompts_;
+            }
+        }
+        return output;
+    }
+
+}  // namespace sung
+
+
+// MetadataCache
+namespace sung {
+
+    MetadataCache::MetadataCache(size_t capacity_bytes)
+        : capacity_bytes_(capacity_bytes) {}
+
+    std::shared_ptr<const ImageMetadata> MetadataCache::find(
+        const Path& path, const FileFingerprint& stamp
+    ) {
+        const auto key = make_key(path);
+
+        std::lock_guard lock(mut_);
+        const auto found = entries_.find(key);
+        if (found == entries_.end()) {
+            ++misses_;
+            return nullptr;
+        }
+
+        const auto it = found->second;
+        if (it->size_ != stamp.size_ ||
+            it->modified_time_ != stamp.modified_time_) {
+            ++misses_;
+            this->erase(it);
+            return nullptr;
+        }
+
+        ++hits_;
+        lru_.splice(lru_.begin(), lru_, it);
+        return it->data_;
+    }
+
+    std::shared_ptr<const ImageMetadata> MetadataCache::insert(
+        const Path& path, const FileFingerprint& stamp, ImageMetadata entry
+    ) {
+        const auto bytes = entry.byte_size() + ENTRY_OVERHEAD_BYTES;
+        auto data = std::make_shared<const ImageMetadata>(std::move(entry));
+        auto key = make_key(path);
+
+        std::lock_guard lock(mut_);
+        if (const auto found = entries_.find(key); found != entries_.end())
+            this->erase(found->second);
+        // One huge workflow should not flush everything else
+        if (bytes > capacity_bytes_)
+            return data;
+
+        lru_.push_front(Entry{
+            key,
+            stamp.size_,
+            stamp.modified_time_,
+            bytes,
+            data,
+        });
+        entries_.emplace(std::move(key), lru_.begin());
+        bytes_ += bytes;
+        ++insertions_;
+
+        while (bytes_ > capacity_bytes_) {
+            this->erase(std::prev(lru_.end()));
+            ++evictions_;
+        }
+        return data;
+    }
+
+    nlohmann::json MetadataCache::make_json() const {
+        std::lock_guard lock(mut_);
+        const auto lookups = hits_ + misses_;
+        const auto hit_rate = lookups > 0 ? static_cast<double>(hits_) /
+                                                static_cast<double>(lookups)
+                                          : 0.0;
+
+        return {
+            { "hits", hits_ },
+            { "misses", misses_ },
+            { "hitRate", hit_rate },
+            { "insertions", insertions_ },
+            { "evictions", evictions_ },
+            { "entries", entries_.size() },
+            { "bytes", bytes_ },
+            { "capacityBytes", capacity_bytes_ },
+        };
+    }
+
+    std::string MetadataCache::make_key(const Path& path) {
+        auto output = sung::tostr(path);
+#if defined(SUNG_OS_WINDOWS)
+        absl::AsciiStrToLower(&output);
+#endif
+        return output;
+    }
+
+    void MetadataCache::erase(const EntryList::iterator it) {
+        bytes_ -= it->bytes_;
+        entries_.erase(it->key_);
+        lru_.erase(it);
+    }
+
+}  // namespace sung
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "sung/auxiliary/path.hpp"
+#include "sung/image/png.hpp"
+#include "tag_sidecar.hpp"
+
+
+namespace sung {
+
+    // What the index, the details endpoint and the AVIF walker each used to
+    // parse out of an image on their own
+    struct ImageMetadata {
+        size_t byte_size() const;
+        // The ComfyUI workflow, or null if the image carries none. Points
+        // into `png_text_` for PNG files.
+        const std::string* workflow() const;
+
+        int width_ = 0;
+        int height_ = 0;
+        // Set for PNG files, even when they have no text chunks
+        std::optional<std::vector<PngMeta::TextKV>> png_text_;
+        // Set for AVIF files, empty if they have no XMP
+        std::optional<std::vector<uint8_t>> avif_xmp_;
+        // Workflow of formats that do not keep it as a text chunk
+        std::optional<std::string> workflow_;
+        std::string model_;
+        std::vector<std::string> prompts_;
+    };
+
+    // Text chunks, workflow, model and prompts of a decoded PNG
+    ImageMetadata make_image_metadata(const PngMeta& meta);
+
+
+    // Parsed image metadata keyed by path, size and modification time, so a
+    // file is parsed once until it changes. Least recently used entries are
+    // dropped once their total size passes the byte budget.
+    class MetadataCache {
+
+    public:
+        explicit MetadataCache(size_t capacity_bytes);
+
+        // Null if missing or if the file changed since it was stored
+        std::shared_ptr<const ImageMetadata> find(
+            const Path& path, const FileFingerprint& stamp
+        );
+        // `stamp` must be taken before the metadata was read. Returns the
+        // stored entry, which is kept out of the cache if it alone exceeds
+        // the budget.
+        std::shared_ptr<const ImageMetadata> insert(
+            const Path& path, const FileFingerprint& stamp, ImageMetadata entry
+        );
+
+        nlohmann::json make_json() const;
+
+    private:
+        struct Entry {
+            std::string key_;
+            int64_t size_ = 0;
+            int64_t modified_time_ = 0;
+            size_t bytes_ = 0;
+            std::shared_ptr<const ImageMetadata> data_;
+        };
+
+        using EntryList = std::list<Entry>;
+
+        static std::string make_key(const Path& path);
+        void erase(EntryList::iterator it);
+
+        mutable std::mutex mut_;
+        EntryList lru_;  // Most recently used first
+        std::unordered_map<std::string, EntryList::iterator> entries_;
+        size_t capacity_bytes_;
+        size_t bytes_ = 0;
+        uint64_t hits_ = 0;
+        uint64_t misses_ = 0;
+        uint64_t insertions_ = 0;
+        uint64_t evictions_ = 0;
+    };
+
+}  // namespace sung
@@ -0,0 +1,87 @@
+#include "util/metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+    constexpr double MIN_SECONDS = 1e-4;
+    constexpr double BUCKETS_PER_DOUBLING = 4;
+
+}  // namespace
+
+
+// LatencyHistogram
+namespace sung {
+
+    nlohmann::json LatencyHistogram::Summary::make_json() const {
+        return {
+            { "count", count_ },
+            { "sumSeconds", sum_ },
+            { "p50Seconds", p50_ },
+            { "p95Seconds", p95_ },
+            { "p99Seconds", p99_ },
+            { "maxSeconds", max_ },
+        };
+    }
+
+    void LatencyHistogram::record(double seconds) {
+        // NaN and infinity would poison the sum and the maximum
+        if (!std::isfinite(seconds) || seconds < 0)
+            seconds = 0;
+
+        const auto index = bucket_index(seconds);
+        std::lock_guard lock(mut_);
+        ++buckets_[index];
+        ++count_;
+        sum_ += seconds;
+        max_ = std::max(max_, seconds);
+    }
+
+    LatencyHistogram::Summary LatencyHistogram::summarize() const {
+        std::lock_guard lock(mut_);
+
+        Summary output;
+        output.count_ = count_;
+        output.sum_ = sum_;
+        output.max_ = max_;
+        output.p50_ = this->percentile(0.50);
+        output.p95_ = this->percentile(0.95);
+        output.p99_ = this->percentile(0.99);
+        return output;
+    }
+
+    // Bucket 0 holds everything under MIN_SECONDS; the last one is open-ended
+    size_t LatencyHistogram::bucket_index(const double seconds) {
+        if (seconds < MIN_SECONDS)
+            return 0;
+
+        const auto octaves = std::log2(seconds / MIN_SECONDS);
+        const auto index = std::floor(octaves * BUCKETS_PER_DOUBLING) + 1;
+        // Clamped before the cast, which is undefined out of range
+        const auto last = static_cast<double>(BUCKET_COUNT - 1);
+        return static_cast<size_t>(std::min(index, last));
+    }
+
+    double LatencyHistogram::bucket_upper_bound(const size_t index) {
+        return MIN_SECONDS *
+               std::exp2(static_cast<double>(index) / BUCKETS_PER_DOUBLING);
+    }
+
+    double LatencyHistogram::percentile(const double fraction) const {
+        if (count_ == 0)
+            return 0;
+
+        const auto wanted = std::ceil(fraction * static_cast<double>(count_));
+        const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(wanted));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            seen += buckets_[i];
+            if (seen >= rank)
+                return std::min(bucket_upper_bound(i), max_);
+        }
+        return max_;
+    }
+
+}  // namespace sung
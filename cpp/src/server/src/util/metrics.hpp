@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+#include <nlohmann/json.hpp>
+
+
+namespace sung {
+
+    // Latency distribution over log-spaced buckets, four per doubling, from
+    // 100 us up to about 7 hours. Percentiles are reported as the upper
+    // edge of the bucket they fall in, so they overstate by at most ~19%.
+    class LatencyHistogram {
+
+    public:
+        struct Summary {
+            nlohmann::json make_json() const;
+
+            uint64_t count_ = 0;
+            double sum_ = 0;
+            double p50_ = 0;
+            double p95_ = 0;
+            double p99_ = 0;
+            double max_ = 0;
+        };
+
+        void record(double seconds);
+        Summary summarize() const;
+
+    private:
+        static constexpr size_t BUCKET_COUNT = 112;
+
+        static size_t bucket_index(double seconds);
+        static double bucket_upper_bound(size_t index);
+        double percentile(double fraction) const;
+
+        mutable std::mutex mut_;
+        std::array<uint64_t, BUCKET_COUNT> buckets_{};
+        uint64_t count_ = 0;
+        double sum_ = 0;
+        double max_ = 0;
+    };
+
+}  // namespace sung
@@ -0,0 +1,102 @@
+#include "util/sidecar_writer.hpp"
+
+#include <print>
+
+
+// SidecarWriter
+namespace sung {
+
+    SidecarWriter::SidecarWriter() {
+        thread_ = std::thread([this]() { this->run(); });
+    }
+
+    SidecarWriter::~SidecarWriter() {
+        {
+            std::lock_guard lock{ mut_ };
+            stop_ = true;
+        }
+        cv_work_.notify_all();
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    void SidecarWriter::enqueue(
+        const Path& sidecar_path, TagAnalysisRecord record
+    ) {
+        auto key = sung::tostr(sidecar_path);
+        {
+            std::lock_guard lock{ mut_ };
+            const auto [it, inserted] = pending_.insert_or_assign(
+                key, Job{ sidecar_path, std::move(record) }
+            );
+            if (inserted)
+                order_.push_back(std::move(key));
+        }
+        cv_work_.notify_one();
+    }
+
+    void SidecarWriter::remove(
+        const Path& sidecar_path, std::error_code& ec
+    ) {
+        {
+            std::lock_guard lock{ mut_ };
+            pending_.erase(sung::tostr(sidecar_path));
+        }
+        std::lock_guard io_lock{ io_mut_ };
+        fs::remove(sidecar_path, ec);
+    }
+
+    void SidecarWriter::flush() {
+        std::unique_lock lock{ mut_ };
+        cv_idle_.wait(lock, [this] { return order_.empty() && !busy_; });
+    }
+
+    bool SidecarWriter::pending(const Path& sidecar_path) const {
+        const auto key = sung::tostr(sidecar_path);
+        std::lock_guard lock{ mut_ };
+        return pending_.contains(key) || (busy_ && busy_path_ == key);
+    }
+
+    void SidecarWriter::run() {
+        std::unique_lock lock{ mut_ };
+        while (true) {
+            cv_work_.wait(lock, [this] { return stop_ || !order_.empty(); });
+            if (order_.empty())
+                break;
+
+            const auto key = std::move(order_.front());
+            order_.pop_front();
+            const auto found = pending_.find(key);
+            if (found == pending_.end()) {
+                // Removed after it was queued
+                if (order_.empty())
+                    cv_idle_.notify_all();
+                continue;
+            }
+            const auto job = std::move(found->second);
+            pending_.erase(found);
+
+            busy_ = true;
+            busy_path_ = key;
+            std::unique_lock io_lock{ io_mut_ };
+            lock.unlock();
+            const auto result = sung::write_tag_sidecar(job.path_, job.record_);
+            io_lock.unlock();
+            if (!result) {
+                std::println(
+                    "SidecarWriter: Failed to write {}: {}",
+                    sung::tostr(job.path_),
+                    result.error()
+                );
+            }
+
+            lock.lock();
+            busy_ = false;
+            busy_path_.clear();
+            if (order_.empty())
+                cv_idle_.notify_all();
+        }
+        cv_idle_.notify_all();
+    }
+
+}  // namespace sung
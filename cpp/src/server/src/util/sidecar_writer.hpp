@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+
+#include "tag_sidecar.hpp"
+
+
+namespace sung {
+
+    // Writes tag sidecars on a background thread, so the index does not wait
+    // on the disk while holding its locks. Only the newest record queued for
+    // a path gets written.
+    class SidecarWriter {
+
+    public:
+        SidecarWriter();
+        // Writes whatever is still queued before returning
+        ~SidecarWriter();
+
+        SidecarWriter(const SidecarWriter&) = delete;
+        SidecarWriter& operator=(const SidecarWriter&) = delete;
+        SidecarWriter(SidecarWriter&&) = delete;
+        SidecarWriter& operator=(SidecarWriter&&) = delete;
+
+        void enqueue(const Path& sidecar_path, TagAnalysisRecord record);
+
+        // Drops a queued write for the path and deletes the file, after any
+        // write to it already in progress
+        void remove(const Path& sidecar_path, std::error_code& ec);
+
+        // Blocks until everything queued so far is on disk
+        void flush();
+
+        // True while a write to the path is queued or in progress, when the
+        // file on disk is older than the record the writer holds
+        bool pending(const Path& sidecar_path) const;
+
+    private:
+        struct Job {
+            Path path_;
+            TagAnalysisRecord record_;
+        };
+
+        void run();
+
+        mutable std::mutex mut_;
+        // Held for each file operation, taken after `mut_` when both are
+        std::mutex io_mut_;
+        std::condition_variable cv_work_;
+        std::condition_variable cv_idle_;
+        std::deque<std::string> order_;
+        std::unordered_map<std::string, Job> pending_;
+        // Path being written while `busy_`
+        std::string busy_path_;
+        bool busy_ = false;
+        bool stop_ = false;
+        std::thread thread_;
+    };
+
+}  // namespace sung
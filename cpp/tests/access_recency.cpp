@@ -0,0 +1,55 @@
+#include <print>
+#include <string_view>
+
+#include "util/access_recency.hpp"
+
+
+namespace {
+
+    bool check(const bool condition, const std::string_view message) {
+        if (!condition)
+            std::println(stderr, "FAILED: {}", message);
+        return condition;
+    }
+
+}  // namespace
+
+
+int main() {
+    const sung::Path root = sung::fs::absolute("recency_root");
+    const auto album = root / "album";
+    const auto nested = album / "day1";
+
+    sung::AccessRecency recency;
+    if (!check(recency.last_access_ns(album) == 0, "starts empty"))
+        return 1;
+
+    recency.touch(nested, false, 100);
+    if (!check(recency.last_access_ns(nested) == 100, "remembers the dir") ||
+        !check(recency.last_access_ns(root) == 100, "lifts its ancestors") ||
+        !check(recency.last_access_ns(nested / "x") == 0, "skips children") ||
+        !check(recency.last_access_ns(root / "alb") == 0, "whole components")) {
+        return 1;
+    }
+
+    recency.touch(album / "", true, 200);
+    if (!check(recency.last_access_ns(nested / "x") == 200, "recursive") ||
+        !check(recency.last_access_ns(album) == 200, "ignores trailing /")) {
+        return 1;
+    }
+
+    recency.touch(album, true, 50);
+    if (!check(recency.last_access_ns(album) == 200, "keeps the latest"))
+        return 1;
+
+    sung::AccessRecency small{ 2 };
+    small.touch(root / "a", false, 1);
+    small.touch(root / "b", false, 2);
+    small.touch(root / "c", false, 3);
+    if (!check(small.last_access_ns(root / "a") == 0, "evicts the oldest") ||
+        !check(small.last_access_ns(root / "c") == 3, "keeps the newest")) {
+        return 1;
+    }
+
+    return 0;
+}
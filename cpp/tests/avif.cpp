@@ -33,6 +33,23 @@ int main() {
             file_content.data(), file_content.size()
         );
 
+        // The box reader behind the file overload must agree with libavif
+        sung::RandomAccessFile file;
+        if (file.open(avif_path)) {
+            std::println("Failed to open file: {}", sung::tostr(avif_path));
+            return 1;
+        }
+        const auto ranged_meta = sung::read_avif_metadata_only(file);
+        if (!ranged_meta || ranged_meta->xmp_data_ != avif_meta.xmp_data_ ||
+            ranged_meta->width_ != avif_meta.width_ ||
+            ranged_meta->height_ != avif_meta.height_) {
+            std::println(
+                "Ranged AVIF metadata differs from libavif: {}",
+                sung::tostr(avif_path)
+            );
+            return 1;
+        }
+
         {
             const auto xml_path = sung::path_concat(
                 sung::remove_ext(avif_path), ".xml"
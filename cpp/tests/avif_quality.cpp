@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <print>
+#include <string_view>
+#include <vector>
+
+#include "sung/image/avif_quality.hpp"
+
+
+namespace {
+
+    bool check(const bool condition, const std::string_view message) {
+        if (!condition)
+            std::println(stderr, "FAILED: {}", message);
+        return condition;
+    }
+
+    struct AvifImageDeleter {
+        void operator()(avifImage* image) const { avifImageDestroy(image); }
+    };
+
+    struct AvifEncoderDeleter {
+        void operator()(avifEncoder* encoder) const {
+            avifEncoderDestroy(encoder);
+        }
+    };
+
+    struct AvifDecoderDeleter {
+        void operator()(avifDecoder* decoder) const {
+            avifDecoderDestroy(decoder);
+        }
+    };
+
+    using AvifImagePtr = std::unique_ptr<avifImage, AvifImageDeleter>;
+
+    constexpr uint32_t SIZE = 256;
+
+    // Gradient with fine stripes, so the quantizer visibly changes SSIM
+    AvifImagePtr make_image() {
+        AvifImagePtr output{
+            avifImageCreate(SIZE, SIZE, 8, AVIF_PIXEL_FORMAT_YUV420)
+        };
+        avifImageAllocatePlanes(output.get(), AVIF_PLANES_YUV);
+        for (uint32_t y = 0; y < SIZE; ++y) {
+            const auto row_bytes = output->yuvRowBytes[AVIF_CHAN_Y];
+            auto row = output->yuvPlanes[AVIF_CHAN_Y] +
+                       static_cast<size_t>(y) * row_bytes;
+            for (uint32_t x = 0; x < SIZE; ++x) {
+                const auto stripe = ((x / 2 + y / 3) % 2) ? 40 : 0;
+                row[x] = static_cast<uint8_t>((x + y) / 4 + stripe + 48);
+            }
+        }
+        for (const auto channel : { AVIF_CHAN_U, AVIF_CHAN_V }) {
+            for (uint32_t y = 0; y < SIZE / 2; ++y) {
+                std::fill_n(
+                    output->yuvPlanes[channel] +
+                        static_cast<size_t>(y) * output->yuvRowBytes[channel],
+                    SIZE / 2,
+                    uint8_t{ 128 }
+                );
+            }
+        }
+        return output;
+    }
+
+    // Same round trip as a search trial. The image is small enough that the
+    // trial does not downscale it.
+    double trial_ssim(const avifImage& image, const int quantizer) {
+        AvifImagePtr luma{
+            avifImageCreate(SIZE, SIZE, 8, AVIF_PIXEL_FORMAT_YUV400)
+        };
+        avifImageAllocatePlanes(luma.get(), AVIF_PLANES_YUV);
+        for (uint32_t y = 0; y < SIZE; ++y) {
+            std::copy_n(
+                image.yuvPlanes[AVIF_CHAN_Y] +
+                    static_cast<size_t>(y) * image.yuvRowBytes[AVIF_CHAN_Y],
+                SIZE,
+                luma->yuvPlanes[AVIF_CHAN_Y] +
+                    static_cast<size_t>(y) * luma->yuvRowBytes[AVIF_CHAN_Y]
+            );
+        }
+
+        const std::unique_ptr<avifEncoder, AvifEncoderDeleter> enc{
+            avifEncoderCreate()
+        };
+        enc->minQuantizer = quantizer;
+        enc->maxQuantizer = quantizer;
+        enc->speed = 8;
+        avifRWData encoded = AVIF_DATA_EMPTY;
+        if (avifEncoderWrite(enc.get(), luma.get(), &encoded) !=
+            AVIF_RESULT_OK) {
+            avifRWDataFree(&encoded);
+            return -1;
+        }
+
+        AvifImagePtr decoded{ avifImageCreateEmpty() };
+        const std::unique_ptr<avifDecoder, AvifDecoderDeleter> dec{
+            avifDecoderCreate()
+        };
+        const auto res = avifDecoderReadMemory(
+            dec.get(), decoded.get(), encoded.data, encoded.size
+        );
+        avifRWDataFree(&encoded);
+        if (res != AVIF_RESULT_OK)
+            return -1;
+
+        return sung::calc_plane_ssim(
+            luma->yuvPlanes[AVIF_CHAN_Y],
+            luma->yuvRowBytes[AVIF_CHAN_Y],
+            decoded->yuvPlanes[AVIF_CHAN_Y],
+            decoded->yuvRowBytes[AVIF_CHAN_Y],
+            SIZE,
+            SIZE
+        );
+    }
+
+    bool test_plane_ssim() {
+        const auto image = ::make_image();
+        const auto plane = image->yuvPlanes[AVIF_CHAN_Y];
+        const auto row_bytes = image->yuvRowBytes[AVIF_CHAN_Y];
+        const auto identical = sung::calc_plane_ssim(
+            plane, row_bytes, plane, row_bytes, SIZE, SIZE
+        );
+        auto success = check(
+            std::abs(identical - 1) < 1e-12, "scores identical planes as 1"
+        );
+
+        // Deterministic noise of growing amplitude
+        double previous = identical;
+        for (const int amplitude : { 4, 16, 48 }) {
+            std::vector<uint8_t> noisy(static_cast<size_t>(SIZE) * SIZE);
+            for (uint32_t y = 0; y < SIZE; ++y) {
+                for (uint32_t x = 0; x < SIZE; ++x) {
+                    const auto phase = static_cast<int>((x * 7 + y * 13) % 3);
+                    const auto value = plane[y * row_bytes + x] +
+                                       (phase - 1) * amplitude;
+                    noisy[y * SIZE + x] = static_cast<uint8_t>(
+                        std::clamp(value, 0, 255)
+                    );
+                }
+            }
+            const auto score = sung::calc_plane_ssim(
+                plane, row_bytes, noisy.data(), SIZE, SIZE, SIZE
+            );
+            success = check(score < previous, "drops as distortion grows") &&
+                      success;
+            previous = score;
+        }
+
+        const uint8_t tiny[] = { 10, 20, 30, 40 };
+        success = check(
+                      std::abs(
+                          sung::calc_plane_ssim(tiny, 2, tiny, 2, 2, 2) - 1
+                      ) < 1e-12,
+                      "scores a plane smaller than one window"
+                  ) &&
+                  success;
+        return success;
+    }
+
+    bool test_quantizer_search() {
+        const auto image = ::make_image();
+        sung::AvifEncodeParams params;
+        params.set_speed(8);
+
+        const auto strict = sung::search_avif_quantizer(*image, params, 0.99);
+        const auto loose = sung::search_avif_quantizer(*image, params, 0.9);
+        const auto unreachable = sung::search_avif_quantizer(
+            *image, params, 2
+        );
+        const auto anything = sung::search_avif_quantizer(*image, params, -1);
+        if (!check(strict && loose && anything, "searches an 8-bit image") ||
+            !check(!unreachable, "fails when no quantizer is fine enough")) {
+            return false;
+        }
+
+        return check(
+                   ::trial_ssim(*image, *strict) >= 0.99 &&
+                       ::trial_ssim(*image, *loose) >= 0.9,
+                   "finds a quantizer that meets the target"
+               ) &&
+               check(*strict <= *loose, "needs finer steps to score higher") &&
+               check(*anything == 63, "stops at the coarsest quantizer");
+    }
+
+    bool test_quantizer_cache() {
+        using Cache = sung::AvifQuantizerCache;
+        Cache cache;
+        const Cache::Key key{ "model", Cache::resolution_bucket(1024, 1024),
+                              0.95 };
+        cache.store(key, 30);
+
+        auto other_model = key;
+        other_model.model_ = "other";
+        auto other_size = key;
+        other_size.resolution_bucket_ = Cache::resolution_bucket(2048, 2048);
+        auto other_target = key;
+        other_target.target_ssim_ = 0.9;
+
+        const auto hit = cache.find(key);
+        auto success =
+            check(hit && *hit == 30, "finds a stored quantizer") &&
+            check(
+                Cache::resolution_bucket(1216, 832) == key.resolution_bucket_,
+                "buckets similar pixel counts together"
+            ) &&
+            check(
+                !cache.find(other_model) && !cache.find(other_size) &&
+                    !cache.find(other_target),
+                "keys on model, size and target SSIM"
+            );
+
+        cache.store(key, 25);
+        const auto replaced = cache.find(key);
+        success = check(replaced && *replaced == 25, "replaces an entry") &&
+                  success;
+        return success;
+    }
+
+}  // namespace
+
+
+int main() {
+    auto success = ::test_plane_ssim();
+    success = ::test_quantizer_search() && success;
+    success = ::test_quantizer_cache() && success;
+    return success ? 0 : 1;
+}
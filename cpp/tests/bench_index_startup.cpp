@@ -0,0 +1,267 @@
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <print>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+#include <sung/basic/time.hpp>
+
+#include "index/image_index.hpp"
+
+
+namespace {
+
+    struct Variant {
+        const char* name_;
+        int page_size_;
+        int64_t mmap_size_mb_;
+        int64_t cache_size_mb_;
+        bool temp_store_memory_;
+    };
+
+    struct SyntheticImage {
+        sung::Path path_;
+        int64_t size_ = 0;
+        int64_t modified_time_ = 0;
+    };
+
+    std::shared_ptr<sung::ServerConfigs> make_configs(
+        const sung::Path& root, const Variant& variant
+    ) {
+        auto configs = std::make_shared<sung::ServerConfigs>();
+        configs->fill_default();
+        configs->dir_bindings_.clear();
+        configs->dir_bindings_["bench"].local_dirs_.push_back(root);
+        configs->index_page_size_ = variant.page_size_;
+        configs->index_mmap_size_mb_ = variant.mmap_size_mb_;
+        configs->index_cache_size_mb_ = variant.cache_size_mb_;
+        configs->index_temp_store_memory_ = variant.temp_store_memory_;
+        return configs;
+    }
+
+    std::vector<SyntheticImage> create_images(
+        const sung::Path& root, const size_t count
+    ) {
+        std::vector<SyntheticImage> output;
+        output.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            const auto folder = root /
+                                sung::fromstr(std::format("d{:04}", i / 1000));
+            if (i % 1000 == 0)
+                sung::fs::create_directories(folder);
+
+            auto& image = output.emplace_back();
+            image.path_ = folder / sung::fromstr(std::format("{:07}.png", i));
+            std::ofstream{ image.path_ } << "not a png";
+            image.size_ = static_cast<int64_t>(
+                sung::fs::file_size(image.path_)
+            );
+            image.modified_time_ = static_cast<int64_t>(
+                sung::fs::last_write_time(image.path_)
+                    .time_since_epoch()
+                    .count()
+            );
+        }
+        return output;
+    }
+
+    // Same layout as the index's `prompts_blob` column
+    std::string encode_prompts(const std::vector<std::string>& prompts) {
+        std::string output;
+        for (const auto& prompt : prompts) {
+            const auto size = static_cast<uint32_t>(prompt.size());
+            for (int shift = 0; shift < 32; shift += 8)
+                output.push_back(static_cast<char>((size >> shift) & 0xFF));
+            output += prompt;
+        }
+        return output;
+    }
+
+    std::string make_analysis_json(const size_t seed) {
+        auto general = nlohmann::json::array();
+        for (size_t i = 0; i < 24; ++i) {
+            general.push_back(
+                { { "name", std::format("tag_{}", (seed * 7 + i) % 5000) },
+                  { "confidence", 0.5 } }
+            );
+        }
+        return nlohmann::json{
+            { "ratings", nlohmann::json::array() },
+            { "generalTags", general },
+            { "characterTags", nlohmann::json::array() },
+        }
+            .dump();
+    }
+
+    // Lets the index create its schema, then fills both tables directly
+    bool build_database(
+        const sung::Path& database_path,
+        const sung::Path& root,
+        const Variant& variant,
+        const std::vector<SyntheticImage>& images
+    ) {
+        {
+            const auto empty = ::make_configs(root, variant);
+            empty->dir_bindings_.clear();
+            sung::ImageIndex index{ database_path };
+            index.initialize(empty);
+        }
+
+        sqlite3* database = nullptr;
+        const auto path = sung::tostr(database_path);
+        if (sqlite3_open(path.c_str(), &database) != SQLITE_OK) {
+            sqlite3_close(database);
+            return false;
+        }
+
+        sqlite3_stmt* metadata = nullptr;
+        sqlite3_stmt* tags = nullptr;
+        sqlite3_exec(database, "BEGIN;", nullptr, nullptr, nullptr);
+        sqlite3_prepare_v2(
+            database,
+            "INSERT INTO image_metadata (physical_path, file_size, "
+            "modified_time, sort_time_ns, eligible, width, height, model, "
+            "prompts_blob) VALUES (?, ?, ?, ?, 1, 832, 1216, ?, ?);",
+            -1,
+            &metadata,
+            nullptr
+        );
+        sqlite3_prepare_v2(
+            database,
+            "INSERT INTO image_tag_analysis (logical_path, input_kind, "
+            "input_path, input_size, input_modified_time, input_sha256, "
+            "analyzer_fingerprint, model_id, analysis_json, analyzed_at) "
+            "VALUES (?, 'source', ?, ?, ?, ?, 'bench', 'bench', ?, 1);",
+            -1,
+            &tags,
+            nullptr
+        );
+
+        bool success = metadata && tags;
+        const std::string sha256(64, 'a');
+        for (size_t i = 0; success && i < images.size(); ++i) {
+            const auto& image = images[i];
+            const auto physical = sung::tostr(image.path_);
+            const auto prompts = ::encode_prompts({
+                std::format("masterpiece, best quality, scene {}", i % 977),
+                "lowres, bad anatomy, watermark",
+            });
+            const auto model = std::format("model_{}", i % 13);
+            sqlite3_bind_text(metadata, 1, physical.c_str(), -1, nullptr);
+            sqlite3_bind_int64(metadata, 2, image.size_);
+            sqlite3_bind_int64(metadata, 3, image.modified_time_);
+            sqlite3_bind_int64(metadata, 4, image.modified_time_);
+            sqlite3_bind_text(metadata, 5, model.c_str(), -1, nullptr);
+            sqlite3_bind_blob(
+                metadata,
+                6,
+                prompts.data(),
+                static_cast<int>(prompts.size()),
+                nullptr
+            );
+            success = sqlite3_step(metadata) == SQLITE_DONE;
+            sqlite3_reset(metadata);
+
+            const auto logical = sung::detail::logical_image_key(image.path_);
+            const auto analysis = ::make_analysis_json(i);
+            sqlite3_bind_text(tags, 1, logical.c_str(), -1, nullptr);
+            sqlite3_bind_text(tags, 2, physical.c_str(), -1, nullptr);
+            sqlite3_bind_int64(tags, 3, image.size_);
+            sqlite3_bind_int64(tags, 4, image.modified_time_);
+            sqlite3_bind_text(tags, 5, sha256.c_str(), -1, nullptr);
+            sqlite3_bind_text(tags, 6, analysis.c_str(), -1, nullptr);
+            success = success && sqlite3_step(tags) == SQLITE_DONE;
+            sqlite3_reset(tags);
+        }
+
+        sqlite3_finalize(metadata);
+        sqlite3_finalize(tags);
+        const auto* end = success ? "COMMIT;" : "ROLLBACK;";
+        sqlite3_exec(database, end, nullptr, nullptr, nullptr);
+        sqlite3_close(database);
+        return success;
+    }
+
+    void remove_database(const sung::Path& database_path) {
+        std::error_code ec;
+        sung::fs::remove(database_path, ec);
+        for (const auto* suffix : { "-wal", "-shm" }) {
+            const auto path = sung::tostr(database_path) + suffix;
+            sung::fs::remove(sung::fromstr(path), ec);
+        }
+    }
+
+}  // namespace
+
+
+// Measures time to the first published snapshot on a synthetic library with
+// one metadata row and one tag analysis per image, for a few SQLite settings.
+// Pass the image count as the first argument, such as 500000.
+int main(int argc, char** argv) {
+    constexpr int ROUNDS = 3;
+    const size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10)
+                                  : 100'000;
+
+    constexpr Variant variants[] = {
+        { "SQLite defaults", 4096, 0, 0, false },
+        { "no mmap", 4096, 0, 64, true },
+        { "server defaults", 4096, 256, 64, true },
+        { "16 KiB pages", 16384, 256, 64, true },
+    };
+
+    const auto unique =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    const auto temp = sung::fs::temp_directory_path() /
+                      sung::fromstr(
+                          std::format("sprintboard-bench-index-{}", unique)
+                      );
+    const auto root = temp / "images";
+    const auto work_database = temp / "work.sqlite3";
+
+    std::println("Creating {} files...", count);
+    const auto images = ::create_images(root, count);
+
+    for (const auto& variant : variants) {
+        const auto template_name = std::format(
+            "template-{}.sqlite3", variant.page_size_
+        );
+        const auto template_database = temp / sung::fromstr(template_name);
+        if (!sung::fs::exists(template_database) &&
+            !::build_database(template_database, root, variant, images)) {
+            std::println("Cannot build the {} database", variant.name_);
+            break;
+        }
+
+        double best_total = 0;
+        double best_refresh = 0;
+        size_t reused = 0;
+        for (int round = 0; round < ROUNDS; ++round) {
+            ::remove_database(work_database);
+            sung::fs::copy_file(template_database, work_database);
+
+            const auto configs = ::make_configs(root, variant);
+            sung::MonotonicRealtimeTimer timer;
+            sung::ImageIndex index{ work_database };
+            const auto stats = index.initialize(configs);
+            const auto total = timer.elapsed();
+            if (round == 0 || total < best_total) {
+                best_total = total;
+                best_refresh = stats.elapsed_seconds_;
+                reused = stats.metadata_reused_;
+            }
+        }
+
+        std::println("{}:", variant.name_);
+        std::println("  first snapshot: {:.3f} s", best_total);
+        std::println("  cache load:     {:.3f} s", best_total - best_refresh);
+        std::println("  refresh:        {:.3f} s", best_refresh);
+        std::println("  reused:         {} / {}", reused, count);
+    }
+
+    std::error_code ec;
+    sung::fs::remove_all(temp, ec);
+    return 0;
+}
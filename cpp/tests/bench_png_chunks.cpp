@@ -0,0 +1,76 @@
+#include <array>
+#include <print>
+#include <source_location>
+#include <string_view>
+#include <vector>
+
+#include <sung/basic/time.hpp>
+
+#include "sung/auxiliary/path.hpp"
+#include "sung/image/png.hpp"
+#include "sung/image/png_chunks.hpp"
+
+
+// Compares metadata reads through libpng against the chunk scanner. Pass
+// directories of PNGs to measure; defaults to the fixtures.
+int main(int argc, char** argv) {
+    constexpr int ROUNDS = 200;
+
+    std::vector<sung::Path> dirs;
+    for (int i = 1; i < argc; ++i)
+        dirs.push_back(sung::fromstr(argv[i]));
+    if (dirs.empty()) {
+        const auto current_loc = std::source_location::current();
+        const auto source_path = sung::fromstr(current_loc.file_name());
+        dirs.push_back(
+            source_path.parent_path().parent_path().parent_path() /
+            "fixtures" / "images"
+        );
+    }
+
+    std::vector<sung::Path> pngs;
+    for (const auto& dir : dirs) {
+        for (auto& entry : sung::fs::recursive_directory_iterator(dir)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".png")
+                pngs.push_back(entry.path());
+        }
+    }
+    if (pngs.empty()) {
+        std::println("No PNG files found");
+        return 1;
+    }
+
+    constexpr std::array<std::string_view, 2> keys{ "workflow", "prompt" };
+    size_t checksum = 0;
+
+    sung::MonotonicRealtimeTimer libpng_timer;
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (const auto& path : pngs) {
+            const auto meta = sung::read_png_metadata_only(path);
+            if (meta)
+                checksum += meta->text.size();
+        }
+    }
+    const auto libpng_seconds = libpng_timer.elapsed();
+
+    sung::MonotonicRealtimeTimer chunks_timer;
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (const auto& path : pngs) {
+            const auto meta = sung::read_png_chunks(path, keys);
+            if (meta)
+                checksum += meta->text_.size();
+        }
+    }
+    const auto chunks_seconds = chunks_timer.elapsed();
+
+    const auto reads = static_cast<double>(ROUNDS * pngs.size());
+    std::println("Files: {}, rounds: {}", pngs.size(), ROUNDS);
+    std::println(
+        "libpng:        {:.1f} us/file", libpng_seconds / reads * 1e6
+    );
+    std::println(
+        "chunk scanner: {:.1f} us/file", chunks_seconds / reads * 1e6
+    );
+    std::println("Checksum: {}", checksum);
+    return 0;
+}
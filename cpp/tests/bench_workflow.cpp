@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <format>
+#include <print>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <sung/basic/time.hpp>
+
+#include "sung/auxiliary/comfyui_workflow.hpp"
+#include "sung/auxiliary/path.hpp"
+#include "sung/image/avif.hpp"
+#include "sung/image/png_chunks.hpp"
+
+
+namespace {
+
+    constexpr int ROUNDS = 50;
+
+    std::vector<std::string> load_workflows(const sung::Path& dir) {
+        constexpr std::array<std::string_view, 1> keys{ "workflow" };
+
+        std::vector<std::string> output;
+        for (auto& entry : sung::fs::recursive_directory_iterator(dir)) {
+            if (!entry.is_regular_file())
+                continue;
+
+            const auto ext = entry.path().extension();
+            if (ext == ".png") {
+                const auto chunks = sung::read_png_chunks(entry.path(), keys);
+                if (!chunks)
+                    continue;
+                if (const auto wf = chunks->find_text("workflow"))
+                    output.emplace_back(*wf);
+            } else if (ext == ".avif") {
+                sung::RandomAccessFile file;
+                if (file.open(entry.path()))
+                    continue;
+                const auto meta = sung::read_avif_metadata_only(file);
+                if (!meta)
+                    continue;
+                const auto wf = meta->find_workflow_data();
+                if (!wf.empty())
+                    output.emplace_back(wf.begin(), wf.end());
+            }
+        }
+        return output;
+    }
+
+    // Lays `copies` renumbered copies of the graph side by side, standing in
+    // for the huge workflows that made the linear lookups hurt
+    std::string tile_workflow(const std::string& src, const int copies) {
+        const auto workflow = nlohmann::json::parse(src);
+
+        int id_span = 1;
+        for (const auto& node : workflow["nodes"])
+            id_span = std::max(id_span, node["id"].get<int>() + 1);
+        for (const auto& link : workflow["links"])
+            id_span = std::max(id_span, link[0].get<int>() + 1);
+
+        auto output = workflow;
+        output["nodes"] = nlohmann::json::array();
+        output["links"] = nlohmann::json::array();
+        for (int copy = 0; copy < copies; ++copy) {
+            const auto offset = copy * id_span;
+            for (auto node : workflow["nodes"]) {
+                node["id"] = node["id"].get<int>() + offset;
+                output["nodes"].push_back(std::move(node));
+            }
+            for (auto link : workflow["links"]) {
+                for (const int i : { 0, 1, 3 })
+                    link[i] = link[i].get<int>() + offset;
+                output["links"].push_back(std::move(link));
+            }
+        }
+        return output.dump();
+    }
+
+    void run(const std::string_view name, const std::string& workflow) {
+        const auto data = reinterpret_cast<const uint8_t*>(workflow.data());
+        size_t checksum = 0;
+
+        sung::MonotonicRealtimeTimer parse_timer;
+        for (int round = 0; round < ROUNDS; ++round) {
+            const auto wf = sung::parse_comfyui_workflow(data, workflow.size());
+            checksum += wf.nodes().size();
+        }
+        const auto parse_seconds = parse_timer.elapsed();
+
+        // Graph work only. Each cached round gets its own parse, made before
+        // the timer starts, so it pays for its one traversal. Copies would
+        // share a single cache.
+        const auto parsed = sung::parse_comfyui_workflow(
+            data, workflow.size()
+        );
+        std::vector<sung::WorkflowData> copies;
+        copies.reserve(ROUNDS);
+        for (int round = 0; round < ROUNDS; ++round) {
+            copies.push_back(
+                sung::parse_comfyui_workflow(data, workflow.size())
+            );
+        }
+
+        sung::MonotonicRealtimeTimer views_timer;
+        for (int round = 0; round < ROUNDS; ++round) {
+            const auto nodes = parsed.get_nodes();
+            const auto links = parsed.get_links();
+            checksum += sung::find_model(nodes, links).size();
+            checksum += sung::find_prompt(nodes, links).size();
+        }
+        const auto views_seconds = views_timer.elapsed();
+
+        sung::MonotonicRealtimeTimer cached_timer;
+        for (const auto& wf : copies) {
+            checksum += sung::find_model(wf).size();
+            checksum += sung::find_prompt(wf).size();
+        }
+        const auto cached_seconds = cached_timer.elapsed();
+
+        sung::MonotonicRealtimeTimer summary_timer;
+        for (int round = 0; round < ROUNDS; ++round) {
+            const auto summary = sung::summarize_comfyui_workflow(
+                data, workflow.size()
+            );
+            if (summary)
+                checksum += summary->model_.size() + summary->prompts_.size();
+        }
+        const auto summary_seconds = summary_timer.elapsed();
+
+        const auto ms = 1e3 / ROUNDS;
+        std::println(
+            "{} ({} nodes, {} KB)",
+            name,
+            parsed.nodes().size(),
+            workflow.size() / 1024
+        );
+        std::println("  DOM parse:            {:.3f} ms", parse_seconds * ms);
+        std::println("  Graph, two walks:     {:.3f} ms", views_seconds * ms);
+        std::println("  Graph, cached walk:   {:.3f} ms", cached_seconds * ms);
+        std::println("  SAX summary, total:   {:.3f} ms", summary_seconds * ms);
+        std::println("  Checksum: {}", checksum);
+    }
+
+}  // namespace
+
+
+// Times model and prompt extraction on the workflows found in a directory
+// of PNG and AVIF files, as is and tiled into a large graph. Pass the
+// directory and the tile count; defaults to the fixtures and 20.
+int main(int argc, char** argv) {
+    sung::Path dir;
+    if (argc > 1) {
+        dir = sung::fromstr(argv[1]);
+    } else {
+        const auto current_loc = std::source_location::current();
+        const auto source_path = sung::fromstr(current_loc.file_name());
+        dir = source_path.parent_path().parent_path().parent_path() /
+              "fixtures" / "images";
+    }
+    const int copies = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    const auto workflows = ::load_workflows(dir);
+    if (workflows.empty()) {
+        std::println("No workflows found");
+        return 1;
+    }
+
+    for (size_t i = 0; i < workflows.size(); ++i) {
+        ::run(std::format("Workflow {}", i), workflows[i]);
+        ::run(
+            std::format("Workflow {} x{}", i, copies),
+            ::tile_workflow(workflows[i], copies)
+        );
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <print>
+#include <random>
+#include <vector>
+
+#include <sung/basic/time.hpp>
+
+#include "sung/image/yuv.hpp"
+
+
+// Compares RGBA to YUV throughput of libavif against the converters in
+// `sung/image/yuv.hpp`, on a 4 megapixel frame in each pixel format
+int main() {
+    constexpr uint32_t WIDTH = 2048;
+    constexpr uint32_t HEIGHT = 2048;
+    constexpr int ROUNDS = 20;
+
+    std::mt19937 rng{ 7 };
+    std::vector<uint8_t> rgba(WIDTH * HEIGHT * 4);
+    for (auto& x : rgba)
+        x = static_cast<uint8_t>(rng());
+
+    const auto megapixels = static_cast<double>(WIDTH * HEIGHT) * ROUNDS /
+                            1e6;
+    constexpr avifPixelFormat formats[] = {
+        AVIF_PIXEL_FORMAT_YUV444,
+        AVIF_PIXEL_FORMAT_YUV422,
+        AVIF_PIXEL_FORMAT_YUV420,
+        AVIF_PIXEL_FORMAT_YUV400,
+    };
+
+    std::println("AVX2 converter: {}", sung::has_avx2_yuv_converter());
+    for (const auto format : formats) {
+        auto image = avifImageCreate(WIDTH, HEIGHT, 8, format);
+        avifImageAllocatePlanes(image, AVIF_PLANES_ALL);
+
+        avifRGBImage rgb;
+        avifRGBImageSetDefaults(&rgb, image);
+        rgb.pixels = rgba.data();
+        rgb.rowBytes = WIDTH * 4;
+        rgb.format = AVIF_RGB_FORMAT_RGBA;
+
+        sung::MonotonicRealtimeTimer libavif_timer;
+        for (int round = 0; round < ROUNDS; ++round)
+            avifImageRGBToYUV(image, &rgb);
+        const auto libavif_seconds = libavif_timer.elapsed();
+
+        const auto time_converter = [&](const sung::YuvConverter converter) {
+            sung::MonotonicRealtimeTimer timer;
+            for (int round = 0; round < ROUNDS; ++round) {
+                const auto res = sung::rgba_to_yuv(
+                    *image, rgba.data(), WIDTH * 4, 0, HEIGHT, converter
+                );
+                if (!res)
+                    return 0.0;
+            }
+            return megapixels / timer.elapsed();
+        };
+        const auto scalar = time_converter(sung::YuvConverter::scalar);
+        const auto avx2 = time_converter(sung::YuvConverter::avx2);
+
+        std::println("{}:", avifPixelFormatToString(format));
+        std::println("  libavif: {:.1f} MP/s", megapixels / libavif_seconds);
+        std::println("  scalar:  {:.1f} MP/s", scalar);
+        std::println("  AVX2:    {:.1f} MP/s", avx2);
+        avifImageDestroy(image);
+    }
+    return 0;
+}
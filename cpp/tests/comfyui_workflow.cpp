@@ -0,0 +1,168 @@
+#include <array>
+#include <print>
+#include <source_location>
+#include <string_view>
+
+#include "sung/auxiliary/comfyui_workflow.hpp"
+#include "sung/auxiliary/path.hpp"
+#include "sung/image/avif.hpp"
+#include "sung/image/png_chunks.hpp"
+
+
+namespace {
+
+    // Two outputs sharing a sampler, a muted prompt, widgets before the
+    // type, non-string widgets and a subgraph whose nodes must be ignored
+    constexpr std::string_view HANDMADE_WORKFLOW = R"({
+        "nodes": [
+            { "widgets_values": ["model.safetensors"], "id": 1,
+              "type": "CheckpointLoaderSimple", "mode": 0 },
+            { "id": 2, "type": "CLIPTextEncode", "mode": 0,
+              "widgets_values": ["a cat"] },
+            { "id": 3, "type": "CLIPTextEncode", "mode": 4,
+              "widgets_values": ["muted"] },
+            { "id": 4, "type": "KSampler", "mode": 0,
+              "widgets_values": [{ "seed": [1, 2.5] }, 20] },
+            { "id": 5, "type": "SaveImage", "mode": 0, "widgets_values": [] },
+            { "id": 6, "type": "PreviewImage", "mode": 0 },
+            { "id": 7, "type": "ShowText", "mode": 0,
+              "widgets_values": [[1, { "a": null, "b": "c" }]] },
+            { "id": 8, "type": "PrimitiveText", "mode": 0,
+              "widgets_values": [42] }
+        ],
+        "links": [
+            [1, 1, 0, 4, 0, "MODEL"],
+            [2, 2, 0, 4, 1, "CONDITIONING"],
+            [3, 3, 0, 4, 2, "CONDITIONING"],
+            [4, 4, 0, 5, 0, "IMAGE"],
+            [5, 4, 0, 6, 0, "IMAGE"],
+            [6, 7, 0, 4, 3, "STRING"],
+            [7, 8, 0, 7, 0, "STRING"]
+        ],
+        "definitions": { "subgraphs": [{
+            "nodes": [{ "id": 9, "type": "CLIPTextEncode", "mode": 0,
+                        "widgets_values": ["inner"] }],
+            "links": [[8, 9, 0, 5, 1, "CONDITIONING"]]
+        }] }
+    })";
+
+    bool check(const bool condition, const std::string_view message) {
+        if (!condition)
+            std::println(stderr, "FAILED: {}", message);
+        return condition;
+    }
+
+    // The streaming summary must agree with the DOM and node graph path
+    bool check_matches_dom(const std::string_view workflow) {
+        const auto data = reinterpret_cast<const uint8_t*>(workflow.data());
+        const auto workflow_data = sung::parse_comfyui_workflow(
+            data, workflow.size()
+        );
+        const auto nodes = workflow_data.get_nodes();
+        const auto links = workflow_data.get_links();
+
+        const auto summary = sung::summarize_comfyui_workflow(
+            data, workflow.size()
+        );
+        return check(summary.has_value(), "parses the workflow") &&
+               check(
+                   summary->model_ == sung::find_model(nodes, links),
+                   "finds the same model"
+               ) &&
+               check(
+                   summary->prompts_ == sung::find_prompt(nodes, links),
+                   "finds the same prompts"
+               ) &&
+               check(
+                   summary->model_ == sung::find_model(workflow_data) &&
+                       summary->prompts_ == sung::find_prompt(workflow_data),
+                   "reuses the cached active nodes"
+               );
+    }
+
+}  // namespace
+
+
+int main() {
+    const auto current_loc = std::source_location::current();
+    const auto source_path = sung::fromstr(current_loc.file_name());
+    const auto img_dir = source_path.parent_path().parent_path().parent_path() /
+                         "fixtures" / "images";
+
+    bool success = ::check_matches_dom(HANDMADE_WORKFLOW);
+
+    const auto handmade = sung::summarize_comfyui_workflow(
+        reinterpret_cast<const uint8_t*>(HANDMADE_WORKFLOW.data()),
+        HANDMADE_WORKFLOW.size()
+    );
+    if (handmade) {
+        const std::vector<std::string> expected_prompts{
+            "a cat", R"([1,{"a":null,"b":"c"}])", "42",
+            "a cat", R"([1,{"a":null,"b":"c"}])", "42",
+        };
+        success = check(
+                      handmade->prompts_ == expected_prompts,
+                      "skips muted and subgraph nodes"
+                  ) &&
+                  success;
+    }
+
+    // Links feeding back into an earlier node must not loop forever
+    constexpr std::string_view cyclic = R"({
+        "nodes": [
+            { "id": 1, "type": "CLIPTextEncode", "mode": 0,
+              "widgets_values": ["loop"] },
+            { "id": 2, "type": "KSampler", "mode": 0 },
+            { "id": 3, "type": "SaveImage", "mode": 0 }
+        ],
+        "links": [[1, 1, 0, 2, 0, "A"], [2, 2, 0, 1, 0, "B"],
+                  [3, 2, 0, 3, 0, "IMAGE"]]
+    })";
+    success = ::check_matches_dom(cyclic) && success;
+
+    constexpr std::string_view broken = R"({ "nodes": [{ "id": 1, )";
+    success = check(
+                  !sung::summarize_comfyui_workflow(
+                      reinterpret_cast<const uint8_t*>(broken.data()),
+                      broken.size()
+                  ),
+                  "rejects malformed JSON"
+              ) &&
+              success;
+
+    constexpr std::array<std::string_view, 1> keys{ "workflow" };
+    for (auto& entry : sung::fs::directory_iterator(img_dir)) {
+        if (!entry.is_regular_file())
+            continue;
+
+        bool matches = true;
+        const auto ext = entry.path().extension();
+        if (ext == ".png") {
+            const auto chunks = sung::read_png_chunks(entry.path(), keys);
+            const auto workflow = chunks ? chunks->find_text("workflow")
+                                         : std::nullopt;
+            if (workflow)
+                matches = ::check_matches_dom(*workflow);
+        } else if (ext == ".avif") {
+            sung::RandomAccessFile file;
+            if (file.open(entry.path()))
+                continue;
+            const auto meta = sung::read_avif_metadata_only(file);
+            const auto workflow = meta ? meta->find_workflow_data()
+                                       : std::vector<uint8_t>{};
+            if (!workflow.empty()) {
+                matches = ::check_matches_dom(std::string_view(
+                    reinterpret_cast<const char*>(workflow.data()),
+                    workflow.size()
+                ));
+            }
+        }
+
+        if (!matches) {
+            std::println(stderr, "  in {}", sung::tostr(entry.path()));
+            success = false;
+        }
+    }
+
+    return success ? 0 : 1;
+}
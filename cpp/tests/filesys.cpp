@@ -1,3 +1,4 @@
+#include <array>
 #include <chrono>
 #include <format>
 #include <print>
@@ -216,6 +217,44 @@ int main() {
         success;
 #endif
 
+    sung::RandomAccessFile random_access;
+    std::array<uint8_t, 4> tail{};
+    const auto open_error = random_access.open(destination);
+    const auto tail_read = random_access.read_at(2, tail.data(), tail.size());
+    success = check(!open_error, "opens a file for positioned reads") &&
+              check(random_access.size() == 4, "reports the file size") &&
+              check(
+                  tail_read && *tail_read == 2 && tail[0] == 6 && tail[1] == 7,
+                  "reads a range and stops at the end of the file"
+              ) &&
+              success;
+    random_access.close();
+
+    // Temporary filesystems cannot reflink, so this usually takes the
+    // byte-copy fallback
+    const auto copied = sung::copy_file_atomically(source, destination, error);
+    size_t entry_count = 0;
+    for (const auto& entry : sung::fs::directory_iterator(temp)) {
+        static_cast<void>(entry);
+        ++entry_count;
+    }
+    success = check(
+                  copied && !error && sung::read_file(destination) == contents,
+                  "copies a file over an existing one"
+              ) &&
+              check(entry_count == 2, "leaves no temporary copy behind") &&
+              success;
+
+    const auto missing_copied = sung::copy_file_atomically(
+        temp / "missing.png", destination, error
+    );
+    success = check(
+                  !missing_copied && error &&
+                      sung::read_file(destination) == contents,
+                  "keeps the destination when the source is missing"
+              ) &&
+              success;
+
     sung::fs::remove_all(temp, error);
     return success ? 0 : 1;
 }
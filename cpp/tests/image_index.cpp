@@ -1,8 +1,12 @@
+#include <atomic>
 #include <chrono>
+#include <fstream>
 #include <print>
 #include <source_location>
 #include <string_view>
+#include <thread>
 
+#include <httplib.h>
 #include <sqlite3.h>
 
 #include "image_query.hpp"
@@ -41,14 +45,25 @@ namespace {
             return false;
         }
 
+        // Version four kept prompts as JSON text. The fixture prompt only
+        // survives if the migration converts the column.
         const auto result = sqlite3_exec(
-            database, "PRAGMA user_version=4;", nullptr, nullptr, nullptr
+            database,
+            "ALTER TABLE image_metadata ADD COLUMN prompts_json TEXT NOT NULL "
+            "DEFAULT '[]';"
+            "UPDATE image_metadata SET prompts_json='[\"fixture prompt\"]' "
+            "WHERE physical_path LIKE '%one.avif';"
+            "ALTER TABLE image_metadata DROP COLUMN prompts_blob;"
+            "PRAGMA user_version=4;",
+            nullptr,
+            nullptr,
+            nullptr
         );
         sqlite3_close(database);
         return result == SQLITE_OK;
     }
 
-    bool has_version_five_tag_table(
+    bool has_version_six_tables(
         const sung::Path& database_path, const size_t expected_count
     ) {
         sqlite3* database = nullptr;
@@ -110,9 +125,23 @@ namespace {
             tag_count = static_cast<size_t>(sqlite3_column_int64(statement, 0));
         }
         sqlite3_finalize(statement);
+        bool prompts_blob_exists = false;
+        statement = nullptr;
+        if (sqlite3_prepare_v2(
+                database,
+                "SELECT COUNT(*) FROM pragma_table_info('image_metadata') "
+                "WHERE name='prompts_blob';",
+                -1,
+                &statement,
+                nullptr
+            ) == SQLITE_OK &&
+            sqlite3_step(statement) == SQLITE_ROW) {
+            prompts_blob_exists = sqlite3_column_int(statement, 0) == 1;
+        }
+        sqlite3_finalize(statement);
         sqlite3_close(database);
-        return schema_version == 5 && tag_table_exists && tag_count == 0 &&
-               timestamp_count == expected_count;
+        return schema_version == 6 && tag_table_exists && tag_count == 0 &&
+               prompts_blob_exists && timestamp_count == expected_count;
     }
 
     bool set_sort_time(
@@ -241,6 +270,141 @@ namespace {
         return success;
     }
 
+    // Answers like the tagging service, giving every image one tag
+    class StandInTagger {
+
+    public:
+        StandInTagger() {
+            server_.Get(
+                "/v1/info",
+                [](const httplib::Request&, httplib::Response& res) {
+                    res.set_content(
+                        nlohmann::json{
+                            { "protocolVersion", 1 },
+                            { "fingerprint", "stand-in" },
+                            { "modelId", "stand-in-model" },
+                            { "generalThreshold", 0.35 },
+                            { "characterThreshold", 0.75 },
+                        }
+                            .dump(),
+                        "application/json"
+                    );
+                }
+            );
+            server_.Post(
+                "/v1/analyze",
+                [this](const httplib::Request& req, httplib::Response& res) {
+                    ++analyze_count_;
+                    const auto request = nlohmann::json::parse(req.body);
+                    auto results = nlohmann::json::array();
+                    for (const auto& path : request.at("paths")) {
+                        results.push_back(
+                            {
+                                { "path", path },
+                                { "ratings", nlohmann::json::array() },
+                                { "generalTags",
+                                  nlohmann::json::array(
+                                      { { { "name", "stand_in_tag" },
+                                          { "confidence", 0.5 } } }
+                                  ) },
+                                { "characterTags", nlohmann::json::array() },
+                            }
+                        );
+                    }
+                    res.set_content(
+                        nlohmann::json{
+                            { "protocolVersion", 1 },
+                            { "fingerprint", "stand-in" },
+                            { "results", results },
+                        }
+                            .dump(),
+                        "application/json"
+                    );
+                }
+            );
+            port_ = server_.bind_to_any_port("127.0.0.1");
+            thread_ = std::thread([this]() { server_.listen_after_bind(); });
+            server_.wait_until_ready();
+        }
+
+        ~StandInTagger() {
+            server_.stop();
+            if (thread_.joinable())
+                thread_.join();
+        }
+
+        int port() const { return port_; }
+        size_t analyze_count() const { return analyze_count_; }
+
+    private:
+        httplib::Server server_;
+        std::thread thread_;
+        std::atomic<size_t> analyze_count_ = 0;
+        int port_ = 0;
+    };
+
+    bool wait_for_tagged(const sung::ImageIndex& index, const size_t count) {
+        for (int i = 0; i < 200; ++i) {
+            if (image_count(index, "stand_in_tag") == count)
+                return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        return false;
+    }
+
+    bool test_auto_tagging(const sung::Path& temp, const sung::Path& source) {
+        const auto root = temp / "images";
+        const auto moved_root = temp / "images-moved";
+        sung::fs::create_directories(root);
+        sung::fs::copy_file(source, root / "a.png");
+        sung::fs::copy_file(source, root / "b.png");
+
+        StandInTagger tagger;
+        auto configs = make_configs(root);
+        configs->tagger_enabled_ = true;
+        configs->tagger_port_ = tagger.port();
+        configs->tagger_batch_size_ = 1;
+
+        sung::ImageIndex index{ temp / "cache.sqlite3" };
+        index.initialize(configs);
+        index.start_auto_tagging([configs]() { return configs; });
+        if (!check(wait_for_tagged(index, 2), "tags images in the background"))
+            return false;
+
+        // An unavailable root keeps its previous files and their tags
+        sung::fs::rename(root, moved_root);
+        index.refresh(configs);
+        const auto preserved = image_count(index, "stand_in_tag");
+        sung::fs::rename(moved_root, root);
+        index.refresh(configs);
+        if (!check(preserved == 2, "keeps tags of an unavailable root") ||
+            !check(
+                image_count(index, "stand_in_tag") == 2,
+                "keeps tags once the root is back"
+            )) {
+            return false;
+        }
+
+        std::error_code error;
+        sung::fs::remove(root / "b.png", error);
+        index.remove_api_path("/img/test/b.png");
+        if (!check(
+                image_count(index, "stand_in_tag") == 1,
+                "keeps the other tags after a removal"
+            )) {
+            return false;
+        }
+
+        // The poll runs at most once a second
+        const auto sent = tagger.analyze_count();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+        return check(sent == 2, "sends one batch per image") &&
+               check(
+                   tagger.analyze_count() == sent,
+                   "sends nothing while every tag is current"
+               );
+    }
+
 }  // namespace
 
 
@@ -406,6 +570,54 @@ int main() {
             sung::fs::remove_all(temp);
             return 1;
         }
+
+        const auto details_path = image_root / "one.avif";
+        const auto details_stamp = sung::fingerprint_file(details_path);
+        if (!check(details_stamp.has_value(), "stamps the details fixture") ||
+            !check(
+                !index.find_details(details_path, *details_stamp),
+                "starts without stored details"
+            ) ||
+            !check(
+                index.store_details(
+                    details_path, *details_stamp, R"({"width":1})"
+                ),
+                "stores a details payload"
+            )) {
+            sung::fs::remove_all(temp);
+            return 1;
+        }
+
+        // Rewritten in place with the old time put back, the file looks
+        // unchanged, so the stored hash is expected
+        const auto hashed_path = temp / "hashed.bin";
+        std::ofstream{ hashed_path, std::ios::binary } << "first";
+        const auto hashed_time = sung::fs::last_write_time(hashed_path);
+        const auto first_hash = index.hash_file(hashed_path);
+        std::ofstream{ hashed_path, std::ios::binary } << "other";
+        sung::fs::last_write_time(hashed_path, hashed_time);
+        const auto cached_hash = index.hash_file(hashed_path);
+        sung::fs::last_write_time(
+            hashed_path, hashed_time + std::chrono::seconds{ 2 }
+        );
+        const auto touched_hash = index.hash_file(hashed_path);
+        const auto expected_hash = sung::fingerprint_file_with_sha256(
+            hashed_path
+        );
+        if (!check(
+                first_hash && cached_hash &&
+                    cached_hash->sha256_ == first_hash->sha256_,
+                "reuses the hash of an unchanged file"
+            ) ||
+            !check(
+                touched_hash && expected_hash &&
+                    touched_hash->sha256_ == expected_hash->sha256_ &&
+                    touched_hash->sha256_ != first_hash->sha256_,
+                "hashes a file again after it changes"
+            )) {
+            sung::fs::remove_all(temp);
+            return 1;
+        }
     }
 
     if (!check(
@@ -442,8 +654,25 @@ int main() {
                 "removes legacy tag details"
             ) ||
             !check(
-                has_version_five_tag_table(database_path, 2),
-                "migrates the tag cache to schema five without reindexing"
+                has_version_six_tables(database_path, 2),
+                "migrates the cache to schema six without reindexing"
+            ) ||
+            !check(
+                image_count(index, "fixture prompt") == 1,
+                "converts legacy prompts without reindexing"
+            )) {
+            sung::fs::remove_all(temp);
+            return 1;
+        }
+
+        const auto stored_path = image_root / "one.avif";
+        const auto stored_stamp = sung::fingerprint_file(stored_path);
+        const auto stored_details =
+            stored_stamp ? index.find_details(stored_path, *stored_stamp)
+                         : std::nullopt;
+        if (!check(
+                stored_details == R"({"width":1})",
+                "keeps stored details across restarts"
             )) {
             sung::fs::remove_all(temp);
             return 1;
@@ -457,6 +686,12 @@ int main() {
         const auto changed = index.refresh(configs);
         if (!check(!timestamp_error, "changes an image fingerprint") ||
             !check(changed.metadata_indexed_ == 1, "reindexes changed files") ||
+            !check(
+                !index.find_details(
+                    changed_path, sung::fingerprint_file(changed_path).value()
+                ),
+                "ignores details stored for an older fingerprint"
+            ) ||
             !check(image_count(index) == 2, "publishes changed files")) {
             sung::fs::remove_all(temp);
             return 1;
@@ -509,6 +744,7 @@ int main() {
 
         sung::fs::copy_file(source_avif, image_root / "write-failure.avif");
         const auto failed_write = index.refresh(configs);
+        index.flush_metadata_writes();
         if (!check(
                 failed_write.metadata_indexed_ == 1,
                 "indexes metadata despite a database write failure"
@@ -526,6 +762,7 @@ int main() {
         sqlite3_close(blocker);
 
         const auto recovered_write = index.refresh(configs);
+        index.flush_metadata_writes();
         if (!check(
                 recovered_write.metadata_reused_ == 3,
                 "retries the complete cache after a write failure"
@@ -1183,6 +1420,11 @@ int main() {
         }
     }
 
+    if (!test_auto_tagging(temp / "tagging", source_png)) {
+        sung::fs::remove_all(temp);
+        return 1;
+    }
+
     sung::fs::remove_all(temp);
     return 0;
 }
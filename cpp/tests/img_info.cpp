@@ -0,0 +1,71 @@
+#include <print>
+#include <source_location>
+#include <string_view>
+
+#include "sung/auxiliary/path.hpp"
+#include "sung/image/img_info.hpp"
+
+
+namespace {
+
+    bool check(const bool condition, const std::string_view message) {
+        if (!condition)
+            std::println(stderr, "FAILED: {}", message);
+        return condition;
+    }
+
+    // The single-open path must agree with refimg plus the full metadata
+    // readers it replaces for indexing
+    bool check_matches_full_path(const sung::Path& path) {
+        sung::ImageInfo full{ path };
+        if (!check(full.load_simple_info(), "refimg reads the fixture"))
+            return false;
+        const auto has_workflow = full.load_img_metadata() &&
+                                  full.parse_comfyui_workflow();
+
+        sung::ImageInfo single{ path };
+        return check(single.load_info_and_metadata(), "reads in one pass") &&
+               check(single.format() == full.format(), "detects the format") &&
+               check(
+                   single.width() == full.width() &&
+                       single.height() == full.height(),
+                   "reads the dimensions"
+               ) &&
+               check(
+                   single.comfyui().has_value() == has_workflow,
+                   "finds the workflow"
+               ) &&
+               check(
+                   !has_workflow || single.comfyui()->workflow_src() ==
+                                        full.comfyui()->workflow_src(),
+                   "reads the same workflow bytes"
+               );
+    }
+
+}  // namespace
+
+
+int main() {
+    const auto current_loc = std::source_location::current();
+    const auto source_path = sung::fromstr(current_loc.file_name());
+    const auto img_dir = source_path.parent_path().parent_path().parent_path() /
+                         "fixtures" / "images";
+
+    bool success = true;
+    for (auto& entry : sung::fs::directory_iterator(img_dir)) {
+        const auto ext = entry.path().extension();
+        if (!entry.is_regular_file() || (ext != ".png" && ext != ".avif"))
+            continue;
+
+        if (!::check_matches_full_path(entry.path())) {
+            std::println(stderr, "  in {}", sung::tostr(entry.path()));
+            success = false;
+        }
+    }
+
+    sung::ImageInfo missing{ img_dir / "does-not-exist.png" };
+    success = check(!missing.load_info_and_metadata(), "fails on no file") &&
+              success;
+
+    return success ? 0 : 1;
+}
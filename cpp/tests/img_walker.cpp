@@ -9,6 +9,8 @@
 #include "sung/image/avif.hpp"
 #include "tag_sidecar.hpp"
 #include "task/img_walker.hpp"
+#include "util/access_recency.hpp"
+#include "util/metadata_cache.hpp"
 #include "util/wake.hpp"
 
 
@@ -92,7 +94,8 @@ int main() {
     binding.avif_.gen_ = true;
     configs->tagger_enabled_ = true;
 
-    sung::ImageIndex index{ database };
+    sung::MetadataCache metadata_cache{ 1 << 20 };
+    sung::ImageIndex index{ database, &metadata_cache };
     index.initialize(configs);
     sung::GatedPowerRequest power_request;
 
@@ -105,7 +108,11 @@ int main() {
         return 1;
     }
     sung::ServerConfigManager manager{ config_path };
-    auto task = sung::create_img_walker_task(manager, power_request, index);
+    sung::AccessRecency access_recency;
+    sung::AvifGenStats stats;
+    auto task = sung::create_img_walker_task(
+        manager, power_request, index, access_recency, metadata_cache, stats
+    );
 
     task->run();
     if (!check(!sung::fs::exists(proxy), "blocks a proxy without analysis")) {
@@ -129,6 +136,7 @@ int main() {
     );
     const std::string xmp{ metadata.xmp_data_.begin(),
                            metadata.xmp_data_.end() };
+    index.flush_tag_sidecars();
     const auto updated_sidecar = sung::read_tag_sidecar(sidecar);
     auto success = check(
                        xmp.contains("sprintboard:tagAnalysis") &&
@@ -146,9 +154,47 @@ int main() {
                        "records proxy materialization in the sidecar"
                    );
 
+    const auto proxy_stamp = sung::fingerprint_file(proxy);
+    const auto cached_proxy = proxy_stamp
+                                  ? metadata_cache.find(proxy, *proxy_stamp)
+                                  : nullptr;
+    const auto source_stamp = sung::fingerprint_file(source);
+    const auto cached_source = source_stamp
+                                   ? metadata_cache.find(source, *source_stamp)
+                                   : nullptr;
+    success = check(
+                  cached_proxy && cached_proxy->avif_xmp_ &&
+                      *cached_proxy->avif_xmp_ == metadata.xmp_data_,
+                  "caches the XMP written into the proxy"
+              ) &&
+              check(
+                  cached_source && cached_source->png_text_ &&
+                      cached_source->width_ > 0,
+                  "caches the metadata of the source PNG"
+              ) &&
+              success;
+
+    const auto stats_json = stats.make_json();
+    success = check(
+                  stats.files_encoded_ == 1 && stats.bytes_in_ > 0 &&
+                      stats.bytes_out_ > 0,
+                  "counts the encoded proxy and its sizes"
+              ) &&
+              check(
+                  stats_json.at("stages").at("encode").at("count") == 1 &&
+                      stats_json.at("stages").at("total").at("count") == 1 &&
+                      stats_json.at("inFlight") == 0,
+                  "reports per-stage timings"
+              ) &&
+              success;
+
     const auto plain_source = root / "plain.png";
     const auto plain_proxy = sung::make_sprintboard_proxy_path(plain_source);
     const auto plain_written = sung::write_file(plain_source, fixture);
+    const auto copy_source = root / "copies" / "plain.png";
+    const auto copy_proxy = sung::make_sprintboard_proxy_path(copy_source);
+    sung::fs::create_directories(copy_source.parent_path(), error);
+    const auto copy_written = sung::write_file(copy_source, fixture);
     auto plain_configs = std::make_shared<sung::ServerConfigs>();
     plain_configs->fill_default();
     plain_configs->dir_bindings_.clear();
@@ -159,7 +205,7 @@ int main() {
     const auto plain_config_path = temp / "plain-server-configs.json";
     const auto plain_config_json = plain_configs->export_json().dump(2) + '\n';
     if (!check(
-            plain_written &&
+            plain_written && copy_written &&
                 sung::write_file(plain_config_path, plain_config_json),
             "creates the tagging-disabled fixture"
         )) {
@@ -169,13 +215,30 @@ int main() {
     sung::ServerConfigManager plain_manager{ plain_config_path };
     index.refresh(plain_configs);
     auto plain_task = sung::create_img_walker_task(
-        plain_manager, power_request, index
+        plain_manager,
+        power_request,
+        index,
+        access_recency,
+        metadata_cache,
+        stats
     );
+    // A copy deferred while its twin was encoding is made on the next walk
     plain_task->run();
+    plain_task->run();
+    const auto plain_bytes = sung::read_file(plain_proxy);
     success = check(
                   sung::fs::is_regular_file(plain_proxy),
                   "preserves proxy generation when tagging is disabled"
               ) &&
+              check(
+                  !plain_bytes.empty() &&
+                      sung::read_file(copy_proxy) == plain_bytes,
+                  "copies the proxy of identical content"
+              ) &&
+              check(
+                  stats.files_encoded_ == 2 && stats.files_copied_ == 1,
+                  "encodes identical content once"
+              ) &&
               success;
 
     sung::fs::remove_all(temp, error);
@@ -0,0 +1,94 @@
+#include <print>
+#include <string_view>
+
+#include "util/metadata_cache.hpp"
+
+
+namespace {
+
+    bool check(const bool condition, const std::string_view message) {
+        if (!condition)
+            std::println(stderr, "FAILED: {}", message);
+        return condition;
+    }
+
+    sung::ImageMetadata make_entry(const size_t workflow_bytes) {
+        sung::PngMeta meta;
+        meta.width = 640;
+        meta.height = 480;
+        meta.text.push_back({ "workflow", std::string(workflow_bytes, ' ') });
+        meta.text.push_back({ "parameters", "steps: 20" });
+        return sung::make_image_metadata(meta);
+    }
+
+}  // namespace
+
+
+int main() {
+    const sung::Path root = sung::fs::absolute("metadata_cache_root");
+    const sung::FileFingerprint stamp{ 100, 1000, {} };
+
+    const auto entry = ::make_entry(10);
+    if (!check(entry.width_ == 640 && entry.height_ == 480, "copies size") ||
+        !check(entry.png_text_ && entry.png_text_->size() == 2, "keeps text") ||
+        !check(
+            entry.workflow() == &entry.png_text_->front().value &&
+                !entry.workflow_,
+            "points the workflow into the text chunks"
+        ) ||
+        !check(!entry.avif_xmp_, "no XMP for a PNG") ||
+        !check(entry.model_.empty(), "no model from invalid JSON")) {
+        return 1;
+    }
+
+    sung::MetadataCache cache{ 16 << 10 };
+    if (!check(!cache.find(root / "a.png", stamp), "starts empty"))
+        return 1;
+
+    const auto stored = cache.insert(root / "a.png", stamp, ::make_entry(10));
+    const auto found = cache.find(root / "a.png", stamp);
+    if (!check(found == stored, "returns the stored entry") ||
+        !check(!cache.find(root / "b.png", stamp), "misses other paths")) {
+        return 1;
+    }
+
+    const sung::FileFingerprint edited{ 100, 2000, {} };
+    if (!check(!cache.find(root / "a.png", edited), "misses on a new mtime") ||
+        !check(!cache.find(root / "a.png", stamp), "drops the stale entry")) {
+        return 1;
+    }
+
+    // Each entry takes a bit over 4 KB, so the fourth one pushes out the
+    // least recently used
+    cache.insert(root / "1.png", stamp, ::make_entry(4 << 10));
+    cache.insert(root / "2.png", stamp, ::make_entry(4 << 10));
+    cache.insert(root / "3.png", stamp, ::make_entry(4 << 10));
+    cache.find(root / "1.png", stamp);
+    cache.insert(root / "4.png", stamp, ::make_entry(4 << 10));
+    if (!check(!cache.find(root / "2.png", stamp), "evicts the oldest") ||
+        !check(cache.find(root / "1.png", stamp) != nullptr, "keeps used") ||
+        !check(cache.find(root / "4.png", stamp) != nullptr, "keeps newest")) {
+        return 1;
+    }
+
+    const auto huge = cache.insert(
+        root / "huge.png", stamp, ::make_entry(32 << 10)
+    );
+    if (!check(huge && huge->workflow(), "returns an oversized entry") ||
+        !check(!cache.find(root / "huge.png", stamp), "does not store it") ||
+        !check(cache.find(root / "4.png", stamp) != nullptr, "keeps others")) {
+        return 1;
+    }
+
+    const auto json = cache.make_json();
+    if (!check(json.at("hits") == 5, "counts hits") ||
+        !check(json.at("misses") == 6, "counts misses") ||
+        !check(json.at("evictions") == 1, "counts evictions") ||
+        !check(json.at("entries") == 3, "counts entries") ||
+        !check(json.at("bytes") <= 16 << 10, "stays within the budget") ||
+        !check(json.at("hitRate") == 5.0 / 11.0, "reports the hit rate")) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <cmath>
+#include <limits>
+#include <print>
+#include <string_view>
+
+#include "util/metrics.hpp"
+
+
+namespace {
+
+    bool check(const bool condition, const std::string_view message) {
+        if (!condition)
+            std::println(stderr, "FAILED: {}", message);
+        return condition;
+    }
+
+}  // namespace
+
+
+int main() {
+    const auto empty = sung::LatencyHistogram{}.summarize();
+    if (!check(empty.count_ == 0 && empty.p99_ == 0, "summarizes nothing"))
+        return 1;
+
+    sung::LatencyHistogram histogram;
+    for (int i = 1; i <= 100; ++i)
+        histogram.record(i * 0.01);
+
+    const auto summary = histogram.summarize();
+    const auto within = [](double value, double expected) {
+        // Bucket edges are 2^(1/4) apart
+        return value >= expected && value <= expected * 1.19;
+    };
+    if (!check(summary.count_ == 100, "counts every sample") ||
+        !check(summary.sum_ > 50.49 && summary.sum_ < 50.51, "sums samples") ||
+        !check(within(summary.p50_, 0.50), "reports the median") ||
+        !check(within(summary.p95_, 0.95), "reports the 95th percentile") ||
+        !check(summary.p99_ <= summary.max_, "caps percentiles at the max") ||
+        !check(summary.max_ == 1.0, "tracks the maximum")) {
+        return 1;
+    }
+
+    sung::LatencyHistogram extremes;
+    extremes.record(-1);
+    extremes.record(0);
+    extremes.record(1e9);
+    extremes.record(1e300);
+    extremes.record(std::numeric_limits<double>::infinity());
+    extremes.record(std::numeric_limits<double>::quiet_NaN());
+    const auto extreme_summary = extremes.summarize();
+    if (!check(extreme_summary.count_ == 6, "accepts out-of-range samples") ||
+        !check(
+            std::isfinite(extreme_summary.sum_),
+            "treats non-finite samples as zero"
+        ) ||
+        !check(
+            extreme_summary.p50_ < 1e-3,
+            "keeps tiny samples in the first bucket"
+        ) ||
+        !check(extreme_summary.max_ == 1e300, "keeps the true maximum")) {
+        return 1;
+    }
+
+    const auto json = summary.make_json();
+    if (!check(
+            json.at("count") == 100 && json.contains("p95Seconds"),
+            "serializes the summary"
+        )) {
+        return 1;
+    }
+
+    return 0;
+}
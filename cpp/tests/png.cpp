@@ -1,3 +1,4 @@
+#include <cstring>
 #include <fstream>
 #include <print>
 #include <source_location>
@@ -8,6 +9,59 @@
 #include "sung/image/png.hpp"
 
 
+namespace {
+
+    // Decodes `png_path` in odd-sized strips and compares them against the
+    // full-frame decode of `expected`.
+    bool check_strips_match(
+        const sung::Path& png_path, const sung::PngData& expected
+    ) {
+        constexpr int strip_rows = 7;
+        const auto row_bytes = static_cast<size_t>(expected.width) * 4;
+
+        int header_calls = 0;
+        int next_row = 0;
+        bool pixels_match = true;
+        const auto exp_meta = sung::read_png_strips(
+            png_path,
+            strip_rows,
+            [&](const sung::PngMeta& meta) -> sung::ErrStr {
+                ++header_calls;
+                if (meta.width != expected.width ||
+                    meta.height != expected.height)
+                    return std::unexpected("header size mismatch");
+                return {};
+            },
+            [&](const uint8_t* rows, int first_row, int row_count)
+                -> sung::ErrStr {
+                if (first_row != next_row || row_count > strip_rows)
+                    return std::unexpected("unexpected strip layout");
+                next_row += row_count;
+
+                const auto offset = static_cast<size_t>(first_row) * row_bytes;
+                const auto size = static_cast<size_t>(row_count) * row_bytes;
+                if (std::memcmp(rows, expected.pixels.data() + offset, size))
+                    pixels_match = false;
+                return {};
+            }
+        );
+
+        if (!exp_meta) {
+            std::println(
+                "Strip decode failed for {}: {}",
+                sung::tostr(png_path),
+                exp_meta.error()
+            );
+            return false;
+        }
+
+        return header_calls == 1 && next_row == expected.height &&
+               pixels_match && exp_meta->text.size() == expected.text.size();
+    }
+
+}  // namespace
+
+
 int main() {
     const auto current_loc = std::source_location::current();
     const auto source_path = sung::fromstr(current_loc.file_name());
@@ -32,6 +86,14 @@ int main() {
         }
         const auto& png = *exp_png;
 
+        if (!::check_strips_match(png_path, png)) {
+            std::println(
+                "Strip decode does not match full decode: {}",
+                sung::tostr(png_path)
+            );
+            return 1;
+        }
+
         for (auto& text_kv : png.text) {
             const auto json_path = sung::path_concat(
                 sung::remove_ext(png_path), std::format("_{}.json", text_kv.key)
@@ -0,0 +1,162 @@
+#include <array>
+#include <print>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <zlib.h>
+
+#include "sung/auxiliary/filesys.hpp"
+#include "sung/auxiliary/path.hpp"
+#include "sung/image/png.hpp"
+#include "sung/image/png_chunks.hpp"
+
+
+namespace {
+
+    bool check(const bool condition, const std::string_view message) {
+        if (!condition)
+            std::println(stderr, "FAILED: {}", message);
+        return condition;
+    }
+
+    // The chunk walk must agree with libpng on everything indexing uses
+    bool matches_libpng(
+        const sung::PngChunkMeta& chunks, const sung::PngMeta& libpng
+    ) {
+        if (chunks.width_ != libpng.width || chunks.height_ != libpng.height ||
+            chunks.bit_depth_ != libpng.bit_depth ||
+            chunks.color_type_ != libpng.color_type ||
+            chunks.text_.size() != libpng.text.size())
+            return false;
+
+        for (size_t i = 0; i < chunks.text_.size(); ++i) {
+            if (chunks.text_[i].key_ != libpng.text[i].key ||
+                chunks.text_[i].value_ != libpng.text[i].value)
+                return false;
+        }
+        return true;
+    }
+
+    void append_chunk(
+        std::vector<uint8_t>& png,
+        const std::string_view type,
+        const std::string_view data
+    ) {
+        const auto append_be32 = [&png](const uint32_t value) {
+            for (int shift = 24; shift >= 0; shift -= 8)
+                png.push_back(static_cast<uint8_t>(value >> shift));
+        };
+
+        append_be32(static_cast<uint32_t>(data.size()));
+        const auto type_offset = png.size();
+        png.insert(png.end(), type.begin(), type.end());
+        png.insert(png.end(), data.begin(), data.end());
+        append_be32(crc32(0, png.data() + type_offset, 4 + data.size()));
+    }
+
+    std::string compress_text(const std::string_view text) {
+        auto size = compressBound(static_cast<uLong>(text.size()));
+        std::string output(size, '\0');
+        compress(
+            reinterpret_cast<Bytef*>(output.data()),
+            &size,
+            reinterpret_cast<const Bytef*>(text.data()),
+            static_cast<uLong>(text.size())
+        );
+        output.resize(size);
+        return output;
+    }
+
+    // zTXt and iTXt are rare in ComfyUI outputs, so build one by hand
+    bool check_compressed_text() {
+        using namespace std::string_literals;
+
+        std::vector<uint8_t> png{ 137, 80, 78, 71, 13, 10, 26, 10 };
+        ::append_chunk(png, "IHDR", "\0\0\0\x02\0\0\0\x03\x08\x06\0\0\0"s);
+        ::append_chunk(png, "zTXt", "prompt\0\0"s + ::compress_text("cat"));
+        ::append_chunk(
+            png, "iTXt", "workflow\0\x01\0en\0\0"s + ::compress_text("{}")
+        );
+        ::append_chunk(png, "iTXt", "Title\0\0\0\0\0plain"s);
+        ::append_chunk(png, "IDAT", "");
+        ::append_chunk(png, "tEXt", "late\0after IDAT"s);
+
+        const auto meta = sung::parse_png_chunks(png.data(), png.size());
+        return check(meta.has_value(), "parses a hand-built PNG") &&
+               check(
+                   meta->width_ == 2 && meta->height_ == 3 &&
+                       meta->color_type_ == 6,
+                   "reads IHDR"
+               ) &&
+               check(meta->find_text("prompt") == "cat", "inflates zTXt") &&
+               check(meta->find_text("workflow") == "{}", "inflates iTXt") &&
+               check(meta->find_text("Title") == "plain", "reads plain iTXt") &&
+               check(!meta->find_text("late"), "stops at IDAT");
+    }
+
+}  // namespace
+
+
+int main() {
+    const auto current_loc = std::source_location::current();
+    const auto source_path = sung::fromstr(current_loc.file_name());
+    const auto img_dir = source_path.parent_path().parent_path().parent_path() /
+                         "fixtures" / "images";
+
+    bool success = ::check_compressed_text();
+    for (auto& entry : sung::fs::directory_iterator(img_dir)) {
+        const auto& png_path = entry.path();
+        if (!entry.is_regular_file() || png_path.extension() != ".png")
+            continue;
+
+        const auto libpng = sung::read_png_metadata_only(png_path);
+        const auto from_file = sung::read_png_chunks(png_path);
+        const auto bytes = sung::read_file(png_path);
+        const auto from_memory = sung::parse_png_chunks(
+            bytes.data(), bytes.size()
+        );
+        if (!check(libpng.has_value(), "libpng reads the fixture") ||
+            !check(from_file.has_value(), "reads chunks from the file") ||
+            !check(from_memory.has_value(), "reads chunks from memory")) {
+            return 1;
+        }
+
+        constexpr std::array<std::string_view, 1> keys{ "workflow" };
+        const auto filtered = sung::read_png_chunks(png_path, keys);
+        const auto workflow = libpng->find_text_chunk("workflow");
+
+        success = check(
+                      ::matches_libpng(*from_file, *libpng),
+                      "file scan matches libpng"
+                  ) &&
+                  check(
+                      ::matches_libpng(*from_memory, *libpng),
+                      "memory scan matches libpng"
+                  ) &&
+                  check(
+                      filtered && filtered->text_.size() == (workflow ? 1 : 0),
+                      "keeps only the requested keys"
+                  ) &&
+                  check(
+                      !workflow ||
+                          filtered->find_text("workflow") == workflow->value,
+                      "finds the requested chunk"
+                  ) &&
+                  success;
+
+        // Anything cut short before IDAT is an error, not a silent success
+        const auto truncated = sung::parse_png_chunks(bytes.data(), 20);
+        success = check(!truncated, "rejects a truncated header") && success;
+    }
+
+    const std::array<uint8_t, 8> not_png{ 'G', 'I', 'F', '8', '9', 'a', 0, 0 };
+    success = check(
+                  !sung::parse_png_chunks(not_png.data(), not_png.size()),
+                  "rejects other formats"
+              ) &&
+              success;
+
+    return success ? 0 : 1;
+}
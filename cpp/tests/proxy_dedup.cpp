@@ -0,0 +1,111 @@
+#include <chrono>
+#include <format>
+#include <print>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "sung/auxiliary/filesys.hpp"
+#include "task/proxy_dedup.hpp"
+
+
+namespace {
+
+    bool check(const bool condition, const std::string_view message) {
+        if (!condition)
+            std::println(stderr, "FAILED: {}", message);
+        return condition;
+    }
+
+    bool claimed(const sung::ProxyDedupCache::Lookup& lookup) {
+        return !lookup.proxy_ && lookup.claim_.has_value();
+    }
+
+    bool deferred(const sung::ProxyDedupCache::Lookup& lookup) {
+        return !lookup.proxy_ && !lookup.claim_;
+    }
+
+}  // namespace
+
+
+int main() {
+    const auto unique =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    const auto temp = sung::fs::temp_directory_path() /
+                      std::format("sprintboard-proxy-dedup-test-{}", unique);
+    std::error_code error;
+    sung::fs::create_directories(temp, error);
+
+    const auto proxy = temp / "a.png.sprintboard.avif";
+    const auto other_proxy = temp / "b.png.sprintboard.avif";
+    const std::vector<uint8_t> contents{ 1, 2, 3 };
+    if (!check(
+            sung::write_file(proxy, contents) &&
+                sung::write_file(other_proxy, contents),
+            "creates the proxy fixtures"
+        )) {
+        sung::fs::remove_all(temp, error);
+        return 1;
+    }
+
+    const auto key = sung::ProxyDedupCache::make_key(
+        "sha", "yuv420", 80, 6, 0
+    );
+    auto success =
+        check(
+            key != sung::ProxyDedupCache::make_key("sha", "yuv444", 80, 6, 0) &&
+                key != sung::ProxyDedupCache::make_key(
+                           "sha", "yuv420", 80.5, 6, 0
+                       ),
+            "keys on the encode settings"
+        );
+
+    sung::ProxyDedupCache cache;
+    {
+        auto first = cache.find_or_claim(key);
+        const auto second = cache.find_or_claim(key);
+        success = check(claimed(first), "claims new content") &&
+                  check(deferred(second), "defers content being encoded") &&
+                  success;
+    }
+
+    // The first claim was dropped without publishing
+    auto retry = cache.find_or_claim(key);
+    success = check(claimed(retry), "reclaims after an abandoned encode") &&
+              success;
+    if (retry.claim_)
+        retry.claim_->publish(proxy);
+
+    const auto hit = cache.find_or_claim(key);
+    success = check(
+                  hit.proxy_ && *hit.proxy_ == proxy && !hit.claim_,
+                  "finds the published proxy to copy"
+              ) &&
+              success;
+
+    const std::vector<uint8_t> edited{ 4, 5, 6, 7 };
+    sung::write_file(proxy, edited);
+    auto stale = cache.find_or_claim(key);
+    success = check(claimed(stale), "drops a proxy edited since publish") &&
+              success;
+    stale.claim_.reset();
+
+    sung::ProxyDedupCache small{ 1 };
+    const auto other_key = sung::ProxyDedupCache::make_key(
+        "other", "yuv420", 80, 6, 0
+    );
+    for (const auto& [k, path] : { std::pair{ key, proxy },
+                                   std::pair{ other_key, other_proxy } }) {
+        auto lookup = small.find_or_claim(k);
+        if (lookup.claim_)
+            lookup.claim_->publish(path);
+    }
+    const auto evicted = small.find_or_claim(key);
+    const auto kept = small.find_or_claim(other_key);
+    success = check(claimed(evicted), "evicts the oldest entry") &&
+              check(kept.proxy_.has_value(), "keeps the newest entry") &&
+              success;
+
+    sung::fs::remove_all(temp, error);
+    return success ? 0 : 1;
+}
@@ -27,6 +27,7 @@ int main() {
                 "local_dirs": ["./b"],
                 "avif_pix_format": "yuv420",
                 "avif_quality": 90.0,
+                "avif_target_ssim": 0.95,
                 "avif_gen": true
             }
         },
@@ -38,7 +39,12 @@ int main() {
         "tagger_host": "localhost",
         "tagger_port": 9001,
         "tagger_batch_size": 8,
-        "tagger_poll_interval_seconds": 12.5
+        "tagger_max_in_flight": 0,
+        "tagger_poll_interval_seconds": 12.5,
+        "index_mmap_size_mb": 0,
+        "index_cache_size_mb": 16,
+        "index_temp_store_memory": false,
+        "index_page_size": 3000
     })");
 
     sung::ServerConfigs configs;
@@ -54,12 +60,27 @@ int main() {
         !check(configs.tagger_host_ == "localhost", "parses tagger host") ||
         !check(configs.tagger_port_ == 9001, "parses tagger port") ||
         !check(configs.tagger_batch_size_ == 8, "parses tagger batch size") ||
+        !check(
+            configs.tagger_max_in_flight_ == 1,
+            "clamps tagger requests in flight"
+        ) ||
         !check(
             configs.tagger_poll_interval_seconds_ == 12.5,
             "parses tagger poll interval"
         )) {
         return 1;
     }
+    if (!check(configs.index_mmap_size_mb_ == 0, "parses index mmap size") ||
+        !check(configs.index_cache_size_mb_ == 16, "parses index cache size") ||
+        !check(
+            !configs.index_temp_store_memory_, "parses index temp store"
+        ) ||
+        !check(
+            configs.index_page_size_ == 4096,
+            "replaces an invalid page size with the default"
+        )) {
+        return 1;
+    }
 
     const auto inherited = configs.effective_avif_options(*inheriting);
     if (!check(
@@ -67,6 +88,9 @@ int main() {
             "inherits the root pixel format"
         ) ||
         !check(inherited.quality_ == 55.0, "inherits the root quality") ||
+        !check(
+            inherited.target_ssim_ == 0, "defaults to no quality target"
+        ) ||
         !check(inherited.speed_ == 6, "inherits the root speed") ||
         !check(!inherited.gen_, "inherits the root generation flag")) {
         return 1;
@@ -78,6 +102,9 @@ int main() {
             "overrides the pixel format"
         ) ||
         !check(overridden.quality_ == 90.0, "overrides the quality") ||
+        !check(
+            overridden.target_ssim_ == 0.95, "overrides the quality target"
+        ) ||
         !check(overridden.speed_ == 6, "inherits the unset speed") ||
         !check(overridden.gen_, "overrides the generation flag") ||
         !check(
@@ -87,12 +114,26 @@ int main() {
         return 1;
     }
 
+    {
+        sung::ServerConfigs busy_configs;
+        busy_configs.import_json(
+            nlohmann::json::parse(R"({ "tagger_max_in_flight": 200 })")
+        );
+        if (!check(
+                busy_configs.tagger_max_in_flight_ == 8,
+                "caps tagger requests in flight"
+            )) {
+            return 1;
+        }
+    }
+
     const auto exported = configs.export_json();
     if (!check(
             exported.at("tagger_enabled") == true &&
                 exported.at("tagger_host") == "localhost" &&
                 exported.at("tagger_port") == 9001 &&
                 exported.at("tagger_batch_size") == 8 &&
+                exported.at("tagger_max_in_flight") == 1 &&
                 exported.at("tagger_poll_interval_seconds") == 12.5,
             "exports tagger settings"
         )) {
@@ -106,6 +147,7 @@ int main() {
             !exported_inheriting.contains("avif_quality") &&
                 !exported_inheriting.contains("avif_pix_format") &&
                 !exported_inheriting.contains("avif_speed") &&
+                !exported_inheriting.contains("avif_target_ssim") &&
                 !exported_inheriting.contains("avif_gen") &&
                 !exported_inheriting.contains("avif_gen_remove_src"),
             "does not materialize inherited values into bindings"
@@ -113,6 +155,7 @@ int main() {
         !check(
             exported_overriding.at("avif_pix_format") == "yuv420" &&
                 exported_overriding.at("avif_quality") == 90.0 &&
+                exported_overriding.at("avif_target_ssim") == 0.95 &&
                 exported_overriding.at("avif_gen") == true,
             "exports explicitly set overrides"
         ) ||
@@ -0,0 +1,125 @@
+#include <chrono>
+#include <format>
+#include <print>
+#include <string_view>
+
+#include "index/image_index.hpp"
+#include "util/sidecar_writer.hpp"
+
+
+namespace {
+
+    bool check(const bool condition, const std::string_view message) {
+        if (!condition)
+            std::println(stderr, "FAILED: {}", message);
+        return condition;
+    }
+
+    sung::TagAnalysisRecord make_record(
+        const sung::Path& source, const int64_t analyzed_at
+    ) {
+        sung::TagAnalysisRecord output;
+        output.logical_path_ = sung::detail::logical_image_key(source);
+        output.input_kind_ = "source";
+        output.input_path_ = sung::tostr(source);
+        output.input_size_ = 10;
+        output.input_modified_time_ = 20;
+        output.input_sha256_ = std::string(64, 'a');
+        output.analyzer_fingerprint_ = "writer-analyzer";
+        output.model_id_ = "writer-model";
+        output.general_threshold_ = 0.35;
+        output.character_threshold_ = 0.75;
+        output.analyzed_at_ = analyzed_at;
+        output.analysis_ = {
+            { "ratings", nlohmann::json::array() },
+            { "generalTags",
+              nlohmann::json::array(
+                  { { { "name", "writer_tag" }, { "confidence", 0.88 } } }
+              ) },
+            { "characterTags", nlohmann::json::array() },
+        };
+        output.searchable_tags_ = { "writer_tag" };
+        output.analysis_id_ = sung::make_analysis_id(output);
+        return output;
+    }
+
+}  // namespace
+
+
+int main() {
+    std::error_code error;
+    const auto unique =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    const auto temp = sung::fs::temp_directory_path() /
+                      std::format("sprintboard-sidecar-writer-test-{}", unique);
+    sung::fs::create_directories(temp);
+
+    const auto source = temp / "a.png";
+    const auto sidecar = sung::make_sprintboard_tag_sidecar_path(source);
+
+    {
+        sung::SidecarWriter writer;
+        for (int i = 1; i <= 20; ++i)
+            writer.enqueue(sidecar, ::make_record(source, i));
+        writer.flush();
+
+        const auto written = sung::read_tag_sidecar(sidecar);
+        if (!check(written.has_value(), "writes the sidecar") ||
+            !check(written->analyzed_at_ == 20, "writes the newest record")) {
+            sung::fs::remove_all(temp, error);
+            return 1;
+        }
+
+        if (!check(!writer.pending(sidecar), "is idle after a flush")) {
+            sung::fs::remove_all(temp, error);
+            return 1;
+        }
+
+        // Queue behind other files so the last one is likely still waiting.
+        // Either way it must not read as idle before its file is written.
+        const auto last_source = temp / "last.png";
+        const auto last_sidecar = sung::make_sprintboard_tag_sidecar_path(
+            last_source
+        );
+        for (int i = 0; i < 50; ++i) {
+            const auto other = temp / std::format("{}.png", i);
+            writer.enqueue(
+                sung::make_sprintboard_tag_sidecar_path(other),
+                ::make_record(other, 1)
+            );
+        }
+        writer.enqueue(last_sidecar, ::make_record(last_source, 5));
+        const bool queued = writer.pending(last_sidecar);
+        const auto last_written = sung::read_tag_sidecar(last_sidecar);
+        if (!check(
+                queued || (last_written && last_written->analyzed_at_ == 5),
+                "reports a queued write as pending"
+            )) {
+            sung::fs::remove_all(temp, error);
+            return 1;
+        }
+        writer.flush();
+        if (!check(!writer.pending(last_sidecar), "clears pending writes")) {
+            sung::fs::remove_all(temp, error);
+            return 1;
+        }
+
+        writer.enqueue(sidecar, ::make_record(source, 21));
+        writer.remove(sidecar, error);
+        writer.flush();
+        if (!check(!error, "removes without error") ||
+            !check(!sung::fs::exists(sidecar), "drops a queued write")) {
+            sung::fs::remove_all(temp, error);
+            return 1;
+        }
+
+        writer.enqueue(sidecar, ::make_record(source, 22));
+    }
+
+    const auto drained = sung::read_tag_sidecar(sidecar);
+    const auto success = check(
+        drained && drained->analyzed_at_ == 22, "writes the queue on exit"
+    );
+    sung::fs::remove_all(temp, error);
+    return success ? 0 : 1;
+}
@@ -1,6 +1,11 @@
+#include <chrono>
+#include <mutex>
 #include <print>
+#include <set>
 #include <string_view>
+#include <thread>
 
+#include <httplib.h>
 #include <nlohmann/json.hpp>
 
 #include "tagger_client.hpp"
@@ -14,6 +19,173 @@ namespace {
         return condition;
     }
 
+    // Answers like the tagging service and records who connected
+    class StandInTagger {
+
+    public:
+        StandInTagger() {
+            server_.Get(
+                "/v1/info",
+                [this](const httplib::Request& req, httplib::Response& res) {
+                    this->record(req);
+                    res.set_content(
+                        nlohmann::json{
+                            { "protocolVersion", 1 },
+                            { "fingerprint", "stand-in" },
+                            { "modelId", "stand-in-model" },
+                            { "generalThreshold", 0.35 },
+                            { "characterThreshold", 0.75 },
+                        }
+                            .dump(),
+                        "application/json"
+                    );
+                }
+            );
+            server_.Post(
+                "/v1/analyze",
+                [this](const httplib::Request& req, httplib::Response& res) {
+                    this->record(req);
+                    const auto request = nlohmann::json::parse(req.body);
+                    auto results = nlohmann::json::array();
+                    for (const auto& path : request.at("paths")) {
+                        results.push_back(
+                            {
+                                { "path", path },
+                                { "ratings", nlohmann::json::array() },
+                                { "generalTags",
+                                  nlohmann::json::array(
+                                      { { { "name", "stand_in_tag" },
+                                          { "confidence", 0.5 } } }
+                                  ) },
+                                { "characterTags", nlohmann::json::array() },
+                            }
+                        );
+                    }
+                    res.set_content(
+                        nlohmann::json{
+                            { "protocolVersion", 1 },
+                            { "fingerprint", "stand-in" },
+                            { "results", results },
+                        }
+                            .dump(),
+                        "application/json"
+                    );
+                }
+            );
+        }
+
+        ~StandInTagger() { this->stop(); }
+
+        bool start(const int port) {
+            if (port == 0)
+                port_ = server_.bind_to_any_port("127.0.0.1");
+            else if (server_.bind_to_port("127.0.0.1", port))
+                port_ = port;
+            if (port_ <= 0)
+                return false;
+
+            thread_ = std::thread([this]() { server_.listen_after_bind(); });
+            server_.wait_until_ready();
+            return true;
+        }
+
+        void stop() {
+            server_.stop();
+            if (thread_.joinable())
+                thread_.join();
+        }
+
+        int port() const { return port_; }
+
+        size_t request_count() {
+            std::lock_guard lock{ mut_ };
+            return request_count_;
+        }
+
+        size_t connection_count() {
+            std::lock_guard lock{ mut_ };
+            return client_ports_.size();
+        }
+
+        bool accepts_gzip() {
+            std::lock_guard lock{ mut_ };
+            return accepts_gzip_;
+        }
+
+    private:
+        void record(const httplib::Request& req) {
+            std::lock_guard lock{ mut_ };
+            ++request_count_;
+            client_ports_.insert(req.remote_port);
+            accepts_gzip_ = req.get_header_value("Accept-Encoding").find(
+                                "gzip"
+                            ) != std::string::npos;
+        }
+
+        httplib::Server server_;
+        std::thread thread_;
+        std::mutex mut_;
+        std::set<int> client_ports_;
+        size_t request_count_ = 0;
+        int port_ = 0;
+        bool accepts_gzip_ = false;
+    };
+
+    bool test_connection() {
+        const std::vector paths{
+            sung::fromstr("/tmp/first.png"),
+            sung::fromstr("/tmp/second.png"),
+        };
+
+        StandInTagger first;
+        if (!check(first.start(0), "starts the stand-in tagger"))
+            return false;
+
+        sung::TaggerClient client{ "127.0.0.1", first.port() };
+        const auto info = client.get_info();
+        const auto results = client.analyze(paths, "stand-in");
+        const auto again = client.analyze(paths, "stand-in");
+        if (!check(info.has_value(), "reads tagger info") ||
+            !check(
+                results && results->size() == 2 &&
+                    results->at(1).searchable_tags_ ==
+                        std::vector<std::string>{ "stand_in_tag" },
+                "reads analysis results"
+            ) ||
+            !check(again.has_value(), "sends a second analysis") ||
+            !check(first.request_count() == 3, "sends every request") ||
+            !check(
+                first.connection_count() == 1, "keeps the connection open"
+            ) ||
+            !check(first.accepts_gzip(), "asks for compressed responses")) {
+            return false;
+        }
+
+        const auto port = first.port();
+        first.stop();
+        if (!check(!client.get_info(), "fails while the tagger is down"))
+            return false;
+
+        StandInTagger second;
+        if (!check(second.start(port), "restarts the stand-in tagger"))
+            return false;
+        const auto waiting = client.get_info();
+        if (!check(!waiting, "waits before reconnecting") ||
+            !check(
+                second.request_count() == 0,
+                "does not connect while waiting"
+            )) {
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds{ 1100 });
+        const auto reconnected = client.analyze(paths, "stand-in");
+        return check(reconnected.has_value(), "reconnects after the delay") &&
+               check(
+                   second.request_count() == 1, "reaches the new tagger once"
+               );
+    }
+
 }  // namespace
 
 
@@ -98,5 +270,5 @@ int main() {
         !check(!malformed_info, "rejects malformed tagger info")) {
         return 1;
     }
-    return 0;
+    return ::test_connection() ? 0 : 1;
 }
@@ -1,8 +1,10 @@
 #include <format>
 #include <print>
 #include <source_location>
+#include <sstream>
 #include <string>
 #include <string_view>
+#include <utility>
 
 #include <nlohmann/json.hpp>
 #include <pugixml.hpp>
@@ -35,6 +37,97 @@ namespace {
         return {};
     }
 
+    void append_cdata_safely(pugi::xml_node parent, std::string_view s) {
+        size_t pos = 0;
+        while (true) {
+            const size_t p = s.find("]]>", pos);
+            if (p == std::string_view::npos) {
+                parent.append_child(pugi::node_cdata)
+                    .set_value(std::string(s.substr(pos)).c_str());
+                break;
+            }
+
+            parent.append_child(pugi::node_cdata)
+                .set_value(std::string(s.substr(pos, p - pos)).c_str());
+            parent.append_child(pugi::node_cdata).set_value("]]");
+            parent.append_child(pugi::node_pcdata).set_value(">");
+            pos = p + 3;
+        }
+    }
+
+    // The pugixml DOM builder the direct writer replaced. Packets in the
+    // wild were written by it, so the two must agree byte for byte.
+    std::string make_reference_packet(
+        const sung::PngMeta& src, const nlohmann::json* tag_analysis
+    ) {
+        pugi::xml_document doc;
+
+        std::string xpacket_begin = "begin=\"";
+        xpacket_begin += std::string("\xEF\xBB\xBF", 3);
+        xpacket_begin += "\" id=\"W5M0MpCehiHzreSzNTczkc9d\"";
+
+        auto pi_begin = doc.append_child(pugi::node_pi);
+        pi_begin.set_name("xpacket");
+        pi_begin.set_value(xpacket_begin);
+
+        pugi::xml_node xmpmeta = doc.append_child("x:xmpmeta");
+        xmpmeta.append_attribute("xmlns:x") = "adobe:ns:meta/";
+        xmpmeta.append_attribute("x:xmptk") = "sprintboard";
+
+        pugi::xml_node rdf = xmpmeta.append_child("rdf:RDF");
+        rdf.append_attribute(
+            "xmlns:rdf"
+        ) = "http://www.w3.org/1999/02/22-rdf-syntax-ns#";
+
+        pugi::xml_node desc = rdf.append_child("rdf:Description");
+        desc.append_attribute("rdf:about") = "";
+        desc.append_attribute(
+            "xmlns:sprintboard"
+        ) = "https://github.com/SausageTaste/sprintboard/";
+
+        for (const auto& kv : src.text) {
+            const auto key = std::format("sprintboard:pngText_{}", kv.key);
+            append_cdata_safely(desc.append_child(key.c_str()), kv.value);
+        }
+        if (tag_analysis) {
+            auto node = desc.append_child("sprintboard:tagAnalysis");
+            append_cdata_safely(node, tag_analysis->dump());
+        }
+
+        auto pi_end = doc.append_child(pugi::node_pi);
+        pi_end.set_name("xpacket");
+        pi_end.set_value(R"(end="w")");
+
+        std::ostringstream oss;
+        doc.save(
+            oss,
+            "  ",
+            pugi::format_default | pugi::format_no_declaration,
+            pugi::encoding_utf8
+        );
+        return oss.str();
+    }
+
+    bool check_matches_reference(
+        const sung::PngMeta& src,
+        const nlohmann::json* tag_analysis,
+        const std::string_view name
+    ) {
+        const auto packet = tag_analysis
+                                ? sung::make_xmp_packet(src, *tag_analysis)
+                                : sung::make_xmp_packet(src);
+        const auto blob = tag_analysis ? sung::make_xmp_blob(src, *tag_analysis)
+                                       : sung::make_xmp_blob(src);
+        return check(
+                   packet == ::make_reference_packet(src, tag_analysis),
+                   std::format("{} packet differs from pugixml", name)
+               ) &&
+               check(
+                   std::string(blob.begin(), blob.end()) == packet,
+                   std::format("{} blob differs from the packet", name)
+               );
+    }
+
     std::string collect_text(const pugi::xml_node& node) {
         std::string result;
         for (const auto& child : node.children()) {
@@ -60,6 +153,9 @@ int main() {
     if (!check(png.has_value(), "failed to read ComfyUI PNG fixture"))
         return 1;
 
+    if (!::check_matches_reference(*png, nullptr, "fixture"))
+        return 1;
+
     const auto packet = sung::make_xmp_packet(*png);
     if (!check(
             packet.starts_with("<?xpacket begin=\""),
@@ -110,6 +206,37 @@ int main() {
         return 1;
     }
 
+    // Hand-written packets covering the scanner and its DOM fallback
+    constexpr std::pair<std::string_view, std::string_view> lookups[] = {
+        { "<a><sprintboard:workflow x='>'>  <![CDATA[q]]>\r\n"
+          "  &amp;&lt;z </sprintboard:workflow ></a>",
+          "q\n  &<z " },
+        { "<a><sprintboard:workflow>old</sprintboard:workflow>"
+          "<b><sprintboard:pngText_workflow>new"
+          "</sprintboard:pngText_workflow></b></a>",
+          "new" },
+        { "<a><!-- <sprintboard:pngText_workflow>x"
+          "</sprintboard:pngText_workflow> --></a>",
+          "" },
+        { "<a><sprintboard:pngText_workflow>&#65;<![CDATA[B]]>"
+          "</sprintboard:pngText_workflow></a>",
+          "AB" },
+        { "<a><sprintboard:pngText_workflow>C<b>D</b>"
+          "</sprintboard:pngText_workflow></a>",
+          "C" },
+    };
+    for (const auto& [xmp, expected] : lookups) {
+        sung::AvifMeta meta;
+        meta.xmp_data_.assign(xmp.begin(), xmp.end());
+        const auto found = meta.find_workflow_data();
+        if (!check(
+                std::string(found.begin(), found.end()) == expected,
+                std::format("wrong workflow found in {}", xmp)
+            )) {
+            return 1;
+        }
+    }
+
     const auto tag_analysis = nlohmann::json{
         { "schemaVersion", 1 },
         { "analysisId", "fixture-analysis" },
@@ -120,6 +247,16 @@ int main() {
         { "generalTags", nlohmann::json::array() },
         { "characterTags", nlohmann::json::array() },
     };
+    sung::PngMeta edge_cases;
+    edge_cases.text.push_back({ "empty", "" });
+    edge_cases.text.push_back({ "split", "]]>]]]>x]]" });
+    edge_cases.text.push_back({ "nul", std::string("a\0b]]>c", 7) });
+    if (!::check_matches_reference(sung::PngMeta{}, nullptr, "empty") ||
+        !::check_matches_reference(edge_cases, nullptr, "edge case") ||
+        !::check_matches_reference(synthetic, &tag_analysis, "tagged")) {
+        return 1;
+    }
+
     const auto tagged_packet = sung::make_xmp_packet(synthetic, tag_analysis);
     pugi::xml_document tagged_doc;
     const auto tagged_parse = tagged_doc.load_buffer(
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cstdlib>
+#include <format>
+#include <memory>
+#include <print>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "sung/image/yuv.hpp"
+
+
+namespace {
+
+    bool check(const bool condition, const std::string_view message) {
+        if (!condition)
+            std::println(stderr, "FAILED: {}", message);
+        return condition;
+    }
+
+    struct AvifImageDeleter {
+        void operator()(avifImage* image) const { avifImageDestroy(image); }
+    };
+
+    using AvifImagePtr = std::unique_ptr<avifImage, AvifImageDeleter>;
+
+    AvifImagePtr make_image(
+        const uint32_t width,
+        const uint32_t height,
+        const avifPixelFormat format,
+        const avifRange range
+    ) {
+        AvifImagePtr output{ avifImageCreate(width, height, 8, format) };
+        output->yuvRange = range;
+        avifImageAllocatePlanes(output.get(), AVIF_PLANES_ALL);
+        return output;
+    }
+
+    // Largest difference over every plane
+    int max_difference(const avifImage& a, const avifImage& b) {
+        avifPixelFormatInfo info;
+        avifGetPixelFormatInfo(a.yuvFormat, &info);
+
+        int output = 0;
+        const auto compare = [&](const uint8_t* pa,
+                                 const uint32_t stride_a,
+                                 const uint8_t* pb,
+                                 const uint32_t stride_b,
+                                 const uint32_t w,
+                                 const uint32_t h) {
+            for (uint32_t y = 0; y < h; ++y) {
+                for (uint32_t x = 0; x < w; ++x) {
+                    const int diff = pa[y * stride_a + x] -
+                                     pb[y * stride_b + x];
+                    output = std::max(output, std::abs(diff));
+                }
+            }
+        };
+
+        compare(
+            a.yuvPlanes[AVIF_CHAN_Y],
+            a.yuvRowBytes[AVIF_CHAN_Y],
+            b.yuvPlanes[AVIF_CHAN_Y],
+            b.yuvRowBytes[AVIF_CHAN_Y],
+            a.width,
+            a.height
+        );
+        compare(
+            a.alphaPlane,
+            a.alphaRowBytes,
+            b.alphaPlane,
+            b.alphaRowBytes,
+            a.width,
+            a.height
+        );
+        if (info.monochrome)
+            return output;
+
+        const auto chroma_w = (a.width + info.chromaShiftX) >>
+                              info.chromaShiftX;
+        const auto chroma_h = (a.height + info.chromaShiftY) >>
+                              info.chromaShiftY;
+        for (const auto chan : { AVIF_CHAN_U, AVIF_CHAN_V }) {
+            compare(
+                a.yuvPlanes[chan],
+                a.yuvRowBytes[chan],
+                b.yuvPlanes[chan],
+                b.yuvRowBytes[chan],
+                chroma_w,
+                chroma_h
+            );
+        }
+        return output;
+    }
+
+    bool test_case(
+        const uint32_t width,
+        const uint32_t height,
+        const avifPixelFormat format,
+        const avifRange range
+    ) {
+        const auto name = std::format(
+            "{}x{} {} {}",
+            width,
+            height,
+            avifPixelFormatToString(format),
+            range == AVIF_RANGE_FULL ? "full" : "limited"
+        );
+
+        std::mt19937 rng{ width * 31 + height };
+        std::vector<uint8_t> rgba(width * height * 4);
+        for (auto& x : rgba)
+            x = static_cast<uint8_t>(rng());
+        const auto row_bytes = width * 4;
+
+        const auto expected = ::make_image(width, height, format, range);
+        avifRGBImage rgb;
+        avifRGBImageSetDefaults(&rgb, expected.get());
+        rgb.pixels = rgba.data();
+        rgb.rowBytes = row_bytes;
+        rgb.format = AVIF_RGB_FORMAT_RGBA;
+        // libyuv rounds differently, compare against libavif's own math
+        rgb.avoidLibYUV = AVIF_TRUE;
+        if (avifImageRGBToYUV(expected.get(), &rgb) != AVIF_RESULT_OK)
+            return check(false, name + ": libavif conversion");
+
+        const auto scalar = ::make_image(width, height, format, range);
+        const auto res = sung::rgba_to_yuv(
+            *scalar,
+            rgba.data(),
+            row_bytes,
+            0,
+            height,
+            sung::YuvConverter::scalar
+        );
+        if (!check(res.has_value(), name + ": scalar conversion"))
+            return false;
+        // Float details may shift between libavif versions
+        const auto scalar_diff = ::max_difference(*expected, *scalar);
+        if (!check(scalar_diff <= 1, name + ": scalar"))
+            return false;
+
+        // Strips as the walker hands them over, the last one short
+        const auto strips = ::make_image(width, height, format, range);
+        for (uint32_t row = 0; row < height; row += 4) {
+            const auto count = std::min(4u, height - row);
+            const auto res = sung::rgba_to_yuv(
+                *strips, rgba.data() + row * row_bytes, row_bytes, row, count
+            );
+            if (!check(res.has_value(), name + ": strip conversion"))
+                return false;
+        }
+
+        if (sung::has_avx2_yuv_converter()) {
+            const auto avx2 = ::make_image(width, height, format, range);
+            const auto res = sung::rgba_to_yuv(
+                *avx2,
+                rgba.data(),
+                row_bytes,
+                0,
+                height,
+                sung::YuvConverter::avx2
+            );
+            if (!check(res.has_value(), name + ": AVX2 conversion") ||
+                !check(::max_difference(*scalar, *avx2) == 0, name + ": AVX2"))
+                return false;
+        }
+
+        // `best` picks the same math either way
+        const auto strips_diff = ::max_difference(*scalar, *strips);
+        return check(strips_diff == 0, name + ": strips");
+    }
+
+}  // namespace
+
+
+int main() {
+    std::println("AVX2 converter: {}", sung::has_avx2_yuv_converter());
+
+    constexpr avifPixelFormat formats[] = {
+        AVIF_PIXEL_FORMAT_YUV444,
+        AVIF_PIXEL_FORMAT_YUV422,
+        AVIF_PIXEL_FORMAT_YUV420,
+        AVIF_PIXEL_FORMAT_YUV400,
+    };
+    // Odd sizes leave tails for the scalar path and half chroma blocks
+    constexpr uint32_t sizes[][2] = {
+        { 1, 1 }, { 2, 3 }, { 37, 23 }, { 64, 64 }, { 129, 7 },
+    };
+
+    for (const auto format : formats) {
+        for (const auto& size : sizes) {
+            for (const auto range : { AVIF_RANGE_FULL, AVIF_RANGE_LIMITED }) {
+                if (!::test_case(size[0], size[1], format, range))
+                    return 1;
+            }
+        }
+    }
+
+    // Strips that split a 4:2:0 chroma row are refused
+    const auto image = ::make_image(
+        8, 8, AVIF_PIXEL_FORMAT_YUV420, AVIF_RANGE_FULL
+    );
+    const std::vector<uint8_t> rgba(8 * 8 * 4);
+    const auto* px = rgba.data();
+    if (!check(!sung::rgba_to_yuv(*image, px, 32, 1, 2), "odd first row") ||
+        !check(!sung::rgba_to_yuv(*image, px, 32, 0, 3), "odd row count") ||
+        !check(!sung::rgba_to_yuv(*image, px, 32, 6, 4), "rows overrun") ||
+        !check(!sung::rgba_to_yuv(*image, px, 16, 0, 2), "short rows") ||
+        !check(sung::rgba_to_yuv(*image, px, 32, 6, 2).has_value(), "last")) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -9,6 +9,7 @@ from pathlib import Path
 from typing import Protocol
 
 from fastapi import FastAPI, HTTPException
+from fastapi.middleware.gzip import GZipMiddleware
 from pydantic import BaseModel, Field
 
 from .tagging import (
@@ -156,6 +157,9 @@ def create_app(
 
     service = AnalysisService(resolved, tagger_factory)
     app = FastAPI(title="Sprintboard Tagger", version="1")
+    # Analysis responses list every tag with its confidence, and the C++
+    # client asks for gzip.
+    app.add_middleware(GZipMiddleware, minimum_size=1024)
 
     @app.get("/v1/info")
     def info() -> dict[str, object]: